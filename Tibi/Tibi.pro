@@ -4,6 +4,7 @@
 
 QT       += core gui
 QT += network
+QT += concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 CONFIG += c++11
@@ -25,21 +26,54 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += \
     download/DownloadHandler.cpp \
     download/DownloadsDispatcher.cpp \
+    download/CollisionPolicy.cpp \
+    download/AcceptPolicy.cpp \
+    download/DiskQuota.cpp \
+    download/StagingArea.cpp \
+    download/TrashService.cpp \
+    download/DiskWriter.cpp \
+    download/MulticastReceiver.cpp \
+    download/SwarmReceiver.cpp \
     network/TibiDiscovery.cpp \
     TibiMediator.cpp \
     network/TibiPing.cpp \
+    network/TibiBeacon.cpp \
+    network/TibiBeaconReader.cpp \
+    network/TibiProfileServer.cpp \
+    network/TibiProfileFetcher.cpp \
     network/TibiReceiver.cpp \
+    network/TibiInterfaces.cpp \
+    network/TibiLinkProber.cpp \
+    network/PathSelector.cpp \
+    network/TibiConnector.cpp \
+    network/NetworkIOPool.cpp \
+    network/MulticastPacket.cpp \
+    network/MemoryGovernor.cpp \
+    network/SwarmManifest.cpp \
+    network/SwarmServer.cpp \
+    network/TibiDirectory.cpp \
+    upload/FanoutSource.cpp \
+    upload/ItemStream.cpp \
+    upload/MulticastSender.cpp \
     upload/TibiSelector.cpp \
     user/tibier.cpp \
-    view/UDRow.cpp \
     upload/UploadHandler.cpp \
     upload/UploadsDispatcher.cpp \
+    upload/UploadsQueue.cpp \
     user/UserHandler.cpp \
+    user/TibiersRegistry.cpp \
+    user/TimerWheel.cpp \
+    user/PeerCache.cpp \
     view/ViewConfirmation.cpp \
     view/ViewConnectedTibiers.cpp \
     view/ViewPreferences.cpp \
     view/ViewTray.cpp \
     view/ViewUD.cpp \
+    view/TransfersModel.cpp \
+    view/TransferDelegate.cpp \
+    view/TibiersModel.cpp \
+    view/TibierDelegate.cpp \
+    view/AvatarCache.cpp \
     view/clickablelabel.cpp \
     main.cpp
 
@@ -47,23 +81,59 @@ HEADERS += \
     download/Download.h \
     download/DownloadHandler.h \
     download/DownloadsDispatcher.h \
+    download/CollisionPolicy.h \
+    download/AcceptPolicy.h \
+    download/DiskQuota.h \
+    download/StagingArea.h \
+    download/TrashService.h \
+    download/DiskWriter.h \
+    download/SpscQueue.h \
+    download/GroupReceiver.h \
+    download/MulticastReceiver.h \
+    download/SwarmReceiver.h \
     network/TibiDiscovery.h \
     TibiMediator.h \
     network/TibiPing.h \
+    network/TibiBeacon.h \
+    network/TibiBeaconReader.h \
+    network/TibiProfileServer.h \
+    network/TibiProfileFetcher.h \
     network/TibiReceiver.h \
+    network/TibiInterfaces.h \
+    network/TibiLinkProber.h \
+    network/PathSelector.h \
+    network/TibiConnector.h \
+    network/NetworkIOPool.h \
+    network/MulticastPacket.h \
+    network/MemoryGovernor.h \
+    network/SwarmManifest.h \
+    network/SwarmServer.h \
+    network/TibiDirectory.h \
+    upload/FanoutSource.h \
+    upload/ItemStream.h \
+    upload/MulticastSender.h \
     upload/TibiSelector.h \
     user/tibier.h \
     TypesAndStatus.h \
-    view/UDRow.h \
     upload/Upload.h \
     upload/UploadHandler.h \
     upload/UploadsDispatcher.h \
+    upload/UploadsQueue.h \
     user/UserHandler.h \
+    user/TibiersRegistry.h \
+    user/TimerWheel.h \
+    user/PeerCache.h \
+    user/LinkStats.h \
     view/ViewConfirmation.h \
     view/ViewConnectedTibiers.h \
     view/ViewPreferences.h \
     view/ViewTray.h \
     view/ViewUD.h \
+    view/TransfersModel.h \
+    view/TransferDelegate.h \
+    view/TibiersModel.h \
+    view/TibierDelegate.h \
+    view/AvatarCache.h \
     view/clickablelabel.h
 
 ICON = resources/icons/tibi2-iconset.icns
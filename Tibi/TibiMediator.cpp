@@ -20,10 +20,18 @@ TibiMediator::TibiMediator()
     userHandler = UserHandler::Instance();
     userHandler->createUser();
 
+    // accept, TLS handshake and metadata parsing of the downloads happen in the network pool
+    ioPool.start();
+    downloadsDispatcher.setIOPool(&ioPool);
+    TrashService::Instance()->start();
+    DiskWriter::Instance()->start();
+    startSwarmServer();
+
     mediateDownload();
     mediateUpload();
     mediatePreferences();
     mediateTrayActions();
+    mediateDiscovery();
     mediateCleaning();
 
     start();
@@ -42,6 +50,7 @@ void TibiMediator::registerMetatype() {
     qRegisterMetaType<QSharedPointer<Download>>("QSharedPointer<Download>");
     qRegisterMetaType<QSharedPointer<Upload>>("QSharedPointer<Upload>");
     qRegisterMetaType<qintptr>("qintptr");
+    qRegisterMetaType<QHostAddress>("QHostAddress");
     qRegisterMetaType<Status>();
 }
 
@@ -50,19 +59,21 @@ void TibiMediator::registerMetatype() {
  ***********************************************/
 
 void TibiMediator::mediateDownload() {
-    connect(receiver, &TibiReceiver::newDownloadRequest, &downloadsDispatcher, &DownloadsDispatcher::createDownloadHandler);
+    connect(receiver, &TibiReceiver::newDownloadRequest, &downloadsDispatcher, &DownloadsDispatcher::createDownloadHandler, Qt::DirectConnection);
+    connect(receiver, &TibiReceiver::receiverRunningAt, this, &TibiMediator::startReceiverShards, Qt::QueuedConnection);
     connect(&downloadsDispatcher, &DownloadsDispatcher::addDownloadToTray, &viewTray, &ViewTray::addDownload);
     connect(&downloadsDispatcher, &DownloadsDispatcher::addDownloadToView, &viewUD, &ViewUD::addUD);
     connect(&downloadsDispatcher, &DownloadsDispatcher::updateDownloadName, &viewUD, &ViewUD::updateDownloadName);
     connect(&downloadsDispatcher, &DownloadsDispatcher::updateRowDownload, &viewUD, &ViewUD::updateUD);
     connect(&downloadsDispatcher, &DownloadsDispatcher::notifyUserDownloadStatus, &viewTray, &ViewTray::notifyUserDownloadStatus);
     connect(&viewUD, &ViewUD::signalDownloadAbort, &downloadsDispatcher, &DownloadsDispatcher::abortFromView);
+    connect(&viewUD, &ViewUD::signalDownloadPause, &downloadsDispatcher, &DownloadsDispatcher::pauseFromView);
 }
 
 void TibiMediator::mediateUpload() {
     connect(selector, &TibiSelector::newFileSelection, &uploadsDispatcher, &UploadsDispatcher::newFileSelection);
     connect(&uploadsDispatcher, &UploadsDispatcher::showConnectedTibiers, &viewConnected, &ViewConnectedTibiers::showConnectedTibiers);
-    connect(userHandler, &UserHandler::updateConnectedTibiers, &viewConnected, &ViewConnectedTibiers::update, Qt::QueuedConnection);
+    connect(userHandler, &UserHandler::tibierChanged, &viewConnected, &ViewConnectedTibiers::updateTibier, Qt::QueuedConnection);
     connect(userHandler, &UserHandler::removeTibierFromSelected, &viewConnected, &ViewConnectedTibiers::removeTibierFromSelected);
     connect(&viewConnected, &ViewConnectedTibiers::selectionReady, &uploadsDispatcher, &UploadsDispatcher::tibiersSelectionReady);
     connect(&uploadsDispatcher, &UploadsDispatcher::addUploadToView, &viewUD, &ViewUD::addUD, Qt::QueuedConnection);
@@ -70,6 +81,10 @@ void TibiMediator::mediateUpload() {
     connect(&uploadsDispatcher, &UploadsDispatcher::endSelectionSession, selector, &TibiSelector::endSelectionSession);
     connect(&uploadsDispatcher, &UploadsDispatcher::updateRowUpload, &viewUD, &ViewUD::updateUD, Qt::QueuedConnection);
     connect(&viewUD, &ViewUD::signalUploadAbort, &uploadsDispatcher, &UploadsDispatcher::abortFromView);
+    connect(&viewUD, &ViewUD::signalUploadPause, &uploadsDispatcher, &UploadsDispatcher::pauseFromView);
+    connect(&viewUD, &ViewUD::signalUploadPrioritize, &uploadsDispatcher, &UploadsDispatcher::prioritizeFromView);
+    connect(&viewUD, &ViewUD::signalUploadPriority, &uploadsDispatcher, &UploadsDispatcher::setPriorityFromView);
+    connect(userHandler, &UserHandler::updateConnectedTibiers, &uploadsDispatcher, &UploadsDispatcher::startQueuedUploads, Qt::QueuedConnection);
     connect(&uploadsDispatcher, &UploadsDispatcher::removeUploadFromTray, &viewTray, &ViewTray::removeUpload);
 
 }
@@ -79,6 +94,7 @@ void TibiMediator::mediatePreferences() {
     // propagate changes:
     connect(userHandler, &UserHandler::updateAvatarPing, &ping, &TibiPing::updateAvatar, Qt::BlockingQueuedConnection); // blocking to grant mutex protection
     connect(userHandler, &UserHandler::updateStatus, &ping, &TibiPing::updateStatus);
+    connect(userHandler, &UserHandler::usernameChanged, &ping, &TibiPing::sendNow);
     connect(userHandler, &UserHandler::updateStatus, &viewTray, &ViewTray::updateStatusAction);
 }
 
@@ -87,6 +103,12 @@ void TibiMediator::mediateTrayActions() {
     connect(&viewTray, &ViewTray::closeApplication, qApp, &QCoreApplication::quit);
 }
 
+void TibiMediator::mediateDiscovery() {
+    connect(&discovery, &TibiDiscovery::queryReceived, &ping, &TibiPing::answerQuery);
+    connect(&uploadsDispatcher, &UploadsDispatcher::showConnectedTibiers, &discovery, &TibiDiscovery::sendQuery);
+    connect(&ping, &TibiPing::beaconSent, &discovery, &TibiDiscovery::registerBeacon);
+}
+
 void TibiMediator::mediateCleaning() {
     connect(this, &TibiMediator::cleanUp, selector, &TibiSelector::closeSelector, Qt::BlockingQueuedConnection);
     connect(this, &TibiMediator::cleanUp, receiver, &TibiReceiver::closeReceiver, Qt::BlockingQueuedConnection);
@@ -127,16 +149,36 @@ void TibiMediator::startSelectorThread() {
 
 
 void TibiMediator::startReceiverThread() {
-    QThread* receiverThread = new QThread;
-    receiver->moveToThread(receiverThread);
-    connect(receiver, &TibiReceiver::receiverClosed, receiverThread, &QThread::quit);
+    // the shards of the receiver live in the network pool, whose threads are stopped by the mediator destructor
+    receiver->moveToThread(ioPool.next());
     connect(receiver, &TibiReceiver::receiverClosed, receiver, &QObject::deleteLater);
-    connect(receiverThread, &QThread::finished, receiverThread, &QThread::deleteLater);
-    connect(receiverThread, &QThread::started, receiver, &TibiReceiver::startReceiver);
-    receiverThread->start();
+    QMetaObject::invokeMethod(receiver, "startReceiver", Qt::QueuedConnection);
+
+}
 
+void TibiMediator::startReceiverShards(QHostAddress address, int port) {
+    Q_UNUSED(address);
+    int shards = TibiReceiver::shardsCount(ioPool.size());
+    for( int i = 1; i < shards; i++ ) {
+        startReceiverShard(new TibiReceiver(i), static_cast<quint16>(port));
+    }
 }
 
+void TibiMediator::startReceiverShard(TibiReceiver* shard, quint16 port) {
+    shard->moveToThread(ioPool.next());
+    connect(shard, &TibiReceiver::newDownloadRequest, &downloadsDispatcher, &DownloadsDispatcher::createDownloadHandler, Qt::DirectConnection);
+    connect(this, &TibiMediator::cleanUp, shard, &TibiReceiver::closeReceiver, Qt::BlockingQueuedConnection);
+    connect(shard, &TibiReceiver::receiverClosed, shard, &QObject::deleteLater);
+    QMetaObject::invokeMethod(shard, "startShard", Qt::QueuedConnection, Q_ARG(quint16, port));
+}
+
+
+
+void TibiMediator::startSwarmServer() {
+    // the chunks of the swarms are served from the network pool as well
+    SwarmServer::Instance()->moveToThread(ioPool.next());
+    QMetaObject::invokeMethod(SwarmServer::Instance(), "listen", Qt::QueuedConnection);
+}
 
 
 void TibiMediator::startPingThread() {
@@ -161,4 +203,8 @@ void TibiMediator::startDiscoveryThread() {
 
 TibiMediator::~TibiMediator() {
     emit cleanUp();
+    QMetaObject::invokeMethod(SwarmServer::Instance(), "close", Qt::BlockingQueuedConnection);
+    ioPool.stop();
+    DiskWriter::Instance()->stop();
+    TrashService::Instance()->stop();
 }
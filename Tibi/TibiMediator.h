@@ -18,6 +18,8 @@
 #include "network/TibiDiscovery.h"
 #include "upload/TibiSelector.h"
 #include "network/TibiReceiver.h"
+#include "network/NetworkIOPool.h"
+#include "network/SwarmServer.h"
 
 /**
  * @brief The TibiMediator class encapsulates how the different Tibi components interact.
@@ -43,6 +45,11 @@ public slots:
      */
     void dispatchUserInfo();
 
+    /**
+     * @brief startReceiverShards, when shard 0 of the receiver is listening, the other shards are started on its port
+     */
+    void startReceiverShards(QHostAddress address, int port);
+
 signals:
     /**
      * @brief cleanUp, signal emitted when the distructor is called. All the network modules are attached to this signal, in order to close the socket and exit the thread.
@@ -62,6 +69,7 @@ private:
     ViewPreferences viewPreferences;
 
     /* -- network --*/
+    NetworkIOPool ioPool;
     TibiReceiver* receiver = nullptr;
     TibiSelector* selector = nullptr;
     TibiPing ping;
@@ -76,11 +84,11 @@ private:
 
     /**
      * @brief mediateDownload coordinates the download process.
-     * When TibiReceiver receives a connection request it forwards it to
+     * When TibiReceiver receives a connection request it forwards it, in its own thread, to
      * the DownloadsDisaptcher (that internally takes care of creating
-     * a new thread to handle the download and asking the user for confrimation, if needed).
+     * the download handler in the network pool and asking the user for confrimation, if needed).
      * It registers the interactions between the DownloadsDispatcher and all the view components
-     * to update the download status, and to receive abort requests from ViewUD.
+     * to update the download status, and to receive abort and pause requests from ViewUD.
      */
     void mediateDownload();
 
@@ -94,7 +102,8 @@ private:
      * When the user completes the selection, the UploadsDispatcher updates
      * the uploads status in all the intrested view and informs TibiSelector
      * that the selection is terminated.
-     * ViewUD forwards abort requests to the UploadsDispatcher.
+     * ViewUD forwards abort, pause, prioritize and priority requests to the UploadsDispatcher,
+     * that starts the queued uploads when their tibiers come online.
      */
     void mediateUpload();
 
@@ -112,6 +121,13 @@ private:
     void mediateTrayActions();
 
 
+    /**
+     * @brief mediateDiscovery, the queries received by TibiDiscovery are answered by TibiPing, and a query is sent each time the tibiers are about to be shown.
+     * The beacons of TibiPing are registered by TibiDiscovery in the directory, if any.
+     */
+    void mediateDiscovery();
+
+
 
     /**
      * @brief mediateCleaning, manages the application closure by terminating all threads related to the network and closing the sockets.
@@ -133,6 +149,8 @@ private:
      * @brief All the following methods moves the Netwrok worker objects to a dedicated thread, connecting the start of the thread with the start method of the network module and the receiverClosed signal emitted by it with the exit of the thread.
      */
     void startReceiverThread();
+    void startReceiverShard(TibiReceiver* shard, quint16 port);
+    void startSwarmServer();
     void startPingThread();
     void startDiscoveryThread();
     void startSelectorThread();
@@ -15,6 +15,13 @@ enum Types {
     Unknown = 2
 };
 
+// set in the type byte of the first metadata when the item count follows the size
+#define ITEM_COUNT_FLAG 0x80
+// set in the type byte of the first metadata when a multicast offer (group, port, session) follows
+#define MULTICAST_FLAG 0x40
+// set in the type byte of the first metadata when a swarm offer (swarm, port) follows; the manifest follows the answer
+#define SWARM_FLAG 0x20
+
 enum Status {
     Declined = 0,
     Accepted = 1,
@@ -23,7 +30,11 @@ enum Status {
     Error = 4,
     Failed = 5,
     WaitingForAnswer = 6,
-    AbortedFromUser = 7
+    AbortedFromUser = 7,
+    Queued = 8,
+    Paused = 9,
+    Skipped = 10,
+    NoSpace = 11
 };
 
 Q_DECLARE_METATYPE(Status)
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "AcceptPolicy.h"
+
+void AcceptPolicy::load() {
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    rules.clear();
+    int size = settings.beginReadArray("acceptRules");
+    for( int i = 0; i < size; i++ ) {
+        settings.setArrayIndex(i);
+        AcceptRule rule;
+        rule.sender = QUuid(settings.value("sender").toString());
+        QString type = settings.value("type").toString();
+        if( type == "file" ) rule.type = Types::File;
+        else if( type == "dir" ) rule.type = Types::Dir;
+        rule.minSize = settings.value("minSize", NO_LIMIT).toLongLong();
+        rule.maxSize = settings.value("maxSize", NO_LIMIT).toLongLong();
+        rule.minItems = settings.value("minItems", NO_LIMIT).toInt();
+        rule.maxItems = settings.value("maxItems", NO_LIMIT).toInt();
+        rule.freeSpaceBelow = settings.value("freeSpaceBelow", NO_LIMIT).toLongLong();
+        rule.decision = decisionFromString(settings.value("decision").toString());
+        rule.targetDir = settings.value("targetDir").toString();
+        rules.push_back(rule);
+    }
+    settings.endArray();
+    qDebug() << "ACCEPT POLICY:" << rules.size() << "rules";
+}
+
+AcceptVerdict AcceptPolicy::evaluate(const Download& download, bool confirmation) const {
+    AcceptVerdict verdict;
+    verdict.decision = confirmation ? AcceptRule::Ask : AcceptRule::Accept;
+
+    for( auto rule : rules ) {
+        QString targetDir = rule.targetDir.isEmpty() ? download.downloadsPath : rule.targetDir;
+        if( !matches(rule, download, targetDir) ) continue;
+        verdict.decision = rule.decision;
+        verdict.targetDir = rule.targetDir;
+        break;
+    }
+    return verdict;
+}
+
+bool AcceptPolicy::matches(const AcceptRule& rule, const Download& download, const QString& targetDir) const {
+    if( !rule.sender.isNull() && rule.sender != download.idSender ) return false;
+    if( rule.type != Types::Unknown && rule.type != download.type ) return false;
+    if( rule.minSize != NO_LIMIT && download.totalSize < rule.minSize ) return false;
+    if( rule.maxSize != NO_LIMIT && download.totalSize > rule.maxSize ) return false;
+
+    if( rule.minItems != NO_LIMIT || rule.maxItems != NO_LIMIT ) {
+        if( download.itemCount == NO_LIMIT ) return false;
+        if( rule.minItems != NO_LIMIT && download.itemCount < rule.minItems ) return false;
+        if( rule.maxItems != NO_LIMIT && download.itemCount > rule.maxItems ) return false;
+    }
+
+    // checked last: it is the only condition touching the disk
+    if( rule.freeSpaceBelow != NO_LIMIT && DiskQuota::Instance()->available(targetDir) - download.totalSize >= rule.freeSpaceBelow ) return false;
+    return true;
+}
+
+AcceptRule::Decision AcceptPolicy::decisionFromString(const QString& decision) {
+    if( decision == "accept" ) return AcceptRule::Accept;
+    if( decision == "decline" ) return AcceptRule::Decline;
+    return AcceptRule::Ask;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef ACCEPTPOLICY_H
+#define ACCEPTPOLICY_H
+
+#include <QUuid>
+#include <QVector>
+#include <QSettings>
+#include "download/Download.h"
+#include "download/DiskQuota.h"
+
+#define NO_LIMIT -1
+
+/**
+ * @brief The AcceptRule class, a rule matches a download request when all its conditions hold:
+ * the sender (any if null), the type (any if Unknown), the size and the item count bounds (NO_LIMIT if unbounded)
+ * and the space left on the target volume after the download, net of the reservations of DiskQuota (below freeSpaceBelow, NO_LIMIT to ignore it).
+ * A request whose item count is unknown only matches rules without item bounds.
+ */
+class AcceptRule {
+public:
+    enum Decision {
+        Accept = 0,
+        Decline = 1,
+        Ask = 2
+    };
+
+    QUuid sender;
+    Types type = Types::Unknown;
+    qint64 minSize = NO_LIMIT;
+    qint64 maxSize = NO_LIMIT;
+    qint32 minItems = NO_LIMIT;
+    qint32 maxItems = NO_LIMIT;
+    qint64 freeSpaceBelow = NO_LIMIT;
+    Decision decision = Decision::Ask;
+    QString targetDir;  // empty for the download directory of the preferences
+};
+
+/**
+ * @brief The AcceptVerdict class, the decision for a download request and the directory where it has to be saved
+ */
+class AcceptVerdict {
+public:
+    AcceptRule::Decision decision = AcceptRule::Ask;
+    QString targetDir;
+};
+
+/**
+ * @brief The AcceptPolicy class decides whether a download request is accepted, declined or left to the user,
+ * before any data of the item is transferred. The rules are stored in the "acceptRules" setting and the first
+ * matching one wins; when none matches the confirmation mode of the preferences applies.
+ */
+class AcceptPolicy
+{
+public:
+    AcceptPolicy() {}
+
+    /**
+     * @brief load, reads the rules from the settings
+     */
+    void load();
+
+    /**
+     * @brief evaluate
+     * @param download, the request, with the metadata of the item
+     * @param confirmation, the confirmation mode of the preferences
+     */
+    AcceptVerdict evaluate(const Download& download, bool confirmation) const;
+
+private:
+    QVector<AcceptRule> rules;
+
+    bool matches(const AcceptRule& rule, const Download& download, const QString& targetDir) const;
+    static AcceptRule::Decision decisionFromString(const QString& decision);
+
+};
+
+#endif // ACCEPTPOLICY_H
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "CollisionPolicy.h"
+
+void CollisionPolicy::load() {
+    QWriteLocker wl(&rules_m);
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    defaultAction = actionFromString(settings.value("collisionDefault", "ask").toString());
+
+    rules.clear();
+    int size = settings.beginReadArray("collisionRules");
+    for( int i = 0; i < size; i++ ) {
+        settings.setArrayIndex(i);
+        CollisionRule rule;
+        rule.sender = QUuid(settings.value("sender").toString());
+        rule.extension = settings.value("extension").toString().toLower();
+        rule.action = actionFromString(settings.value("action").toString());
+        rules.push_back(rule);
+    }
+    settings.endArray();
+}
+
+CollisionAction CollisionPolicy::resolve(const QUuid& sender, Types type, const QString& itemName) const {
+    QString extension = extensionOf(type, itemName);
+    QReadLocker rl(&rules_m);
+
+    int bestScore = -1;
+    CollisionAction action = defaultAction;
+    for( auto rule : rules ) {
+        if( !rule.sender.isNull() && rule.sender != sender ) continue;
+        if( !rule.extension.isEmpty() && rule.extension != extension ) continue;
+
+        // a rule on the sender is more specific than a rule on the extension
+        int score = (rule.sender.isNull() ? 0 : 2) + (rule.extension.isEmpty() ? 0 : 1);
+        if( score > bestScore ) {
+            bestScore = score;
+            action = rule.action;
+        }
+    }
+    return action;
+}
+
+void CollisionPolicy::remember(const QUuid& sender, const QString& extension, CollisionAction action) {
+    QWriteLocker wl(&rules_m);
+    bool replaced = false;
+    for( auto& rule : rules ) {
+        if( rule.sender == sender && rule.extension == extension ) {
+            rule.action = action;
+            replaced = true;
+        }
+    }
+    if( !replaced ) {
+        CollisionRule rule;
+        rule.sender = sender;
+        rule.extension = extension;
+        rule.action = action;
+        rules.push_back(rule);
+    }
+    save();
+}
+
+QString CollisionPolicy::extensionOf(Types type, const QString& itemName) {
+    if( type == Types::Dir ) return "/";
+    return QFileInfo(itemName).suffix().toLower();
+}
+
+void CollisionPolicy::save() {
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    settings.remove("collisionRules");
+    settings.beginWriteArray("collisionRules", rules.size());
+    for( int i = 0; i < rules.size(); i++ ) {
+        settings.setArrayIndex(i);
+        settings.setValue("sender", rules.at(i).sender.isNull() ? "" : rules.at(i).sender.toString());
+        settings.setValue("extension", rules.at(i).extension);
+        settings.setValue("action", actionToString(rules.at(i).action));
+    }
+    settings.endArray();
+}
+
+CollisionAction CollisionPolicy::actionFromString(const QString& action) {
+    if( action == "rename" ) return CollisionAction::Rename;
+    if( action == "overwrite" ) return CollisionAction::Overwrite;
+    if( action == "skip" ) return CollisionAction::Skip;
+    return CollisionAction::Ask;
+}
+
+QString CollisionPolicy::actionToString(CollisionAction action) {
+    switch( action ) {
+    case CollisionAction::Rename: return "rename";
+    case CollisionAction::Overwrite: return "overwrite";
+    case CollisionAction::Skip: return "skip";
+    default: return "ask";
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef COLLISIONPOLICY_H
+#define COLLISIONPOLICY_H
+
+#include <QUuid>
+#include <QVector>
+#include <QSettings>
+#include <QFileInfo>
+#include <QReadWriteLock>
+#include "TypesAndStatus.h"
+
+/**
+ * @brief The CollisionAction enum, what to do when a download has the name of an item already in the download directory
+ */
+enum CollisionAction {
+    Ask = 0,
+    Rename = 1,
+    Overwrite = 2,
+    Skip = 3
+};
+
+/**
+ * @brief The CollisionRule class, a rule matches the downloads from a tibier (any tibier if the id is null)
+ * whose extension is the given one (any item if empty, "/" for the directories).
+ */
+class CollisionRule {
+public:
+    QUuid sender;
+    QString extension;
+    CollisionAction action = CollisionAction::Ask;
+};
+
+/**
+ * @brief The CollisionPolicy class decides how a name collision of a download is solved without asking the user.
+ * The rules are stored in the "collisionRules" setting; the most specific matching rule wins (sender and extension,
+ * then sender, then extension) and the "collisionDefault" setting is used when none matches.
+ * It is read by the download handlers in their threads and updated by the dispatcher when the user asks to remember an answer.
+ */
+class CollisionPolicy
+{
+public:
+    CollisionPolicy() {}
+
+    /**
+     * @brief load, reads the rules from the settings
+     */
+    void load();
+
+    /**
+     * @brief resolve, thread safe
+     * @return the action of the most specific rule matching the download
+     */
+    CollisionAction resolve(const QUuid& sender, Types type, const QString& itemName) const;
+
+    /**
+     * @brief remember, adds (or replaces) the rule for the sender and the extension and saves the rules
+     */
+    void remember(const QUuid& sender, const QString& extension, CollisionAction action);
+
+    /**
+     * @brief extensionOf, the extension matched by the rules: the lowercase suffix of a file, "/" for a directory
+     */
+    static QString extensionOf(Types type, const QString& itemName);
+
+private:
+    mutable QReadWriteLock rules_m;
+    QVector<CollisionRule> rules;
+    CollisionAction defaultAction = CollisionAction::Ask;
+
+    void save();
+    static CollisionAction actionFromString(const QString& action);
+    static QString actionToString(CollisionAction action);
+
+};
+
+#endif // COLLISIONPOLICY_H
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "DiskQuota.h"
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <errno.h>
+#endif
+
+DiskQuota* DiskQuota::Instance()
+{
+    static DiskQuota instance;
+    return &instance;
+}
+
+qint64 DiskQuota::available(const QString& path) {
+    qint64 freeBytes = 0;
+    QString volume = volumeOf(path, freeBytes);
+    QMutexLocker ml(&quota_m);
+    return freeBytes - reservedOnVolume.value(volume, 0) - DISK_SAFETY_MARGIN;
+}
+
+bool DiskQuota::reserve(int code, const QString& path, qint64 size) {
+    qint64 freeBytes = 0;
+    QString volume = volumeOf(path, freeBytes);
+
+    QMutexLocker ml(&quota_m);
+    if( freeBytes - reservedOnVolume.value(volume, 0) - DISK_SAFETY_MARGIN < size ) {
+        qDebug() << "DISK QUOTA: no space for" << size << "bytes on" << volume
+                 << "(free" << freeBytes << ", reserved" << reservedOnVolume.value(volume, 0) << ")";
+        return false;
+    }
+
+    Reservation reservation;
+    reservation.volume = volume;
+    reservation.bytes = size;
+    reservations.insert(code, reservation);
+    reservedOnVolume[volume] += size;
+    return true;
+}
+
+void DiskQuota::consume(int code, qint64 bytes) {
+    QMutexLocker ml(&quota_m);
+    auto reservation = reservations.find(code);
+    if( reservation == reservations.end() ) return;
+    bytes = qMin(bytes, reservation->bytes);
+    reservation->bytes -= bytes;
+    reservedOnVolume[reservation->volume] -= bytes;
+}
+
+void DiskQuota::release(int code) {
+    QMutexLocker ml(&quota_m);
+    if( !reservations.contains(code) ) return;
+    Reservation reservation = reservations.take(code);
+    reservedOnVolume[reservation.volume] -= reservation.bytes;
+    if( reservedOnVolume.value(reservation.volume) <= 0 ) reservedOnVolume.remove(reservation.volume);
+}
+
+bool DiskQuota::preallocate(QFile* file, qint64 size, bool& preallocated) {
+    preallocated = false;
+    if( size <= 0 ) return true;
+#ifdef Q_OS_LINUX
+    int result = posix_fallocate(file->handle(), 0, size);
+    if( result == 0 ) {
+        preallocated = true;
+        return true;
+    }
+    // not supported by the file system: the space is only checked against the ledger
+    return result != ENOSPC && result != EFBIG;
+#else
+    Q_UNUSED(file);
+    return true;
+#endif
+}
+
+QString DiskQuota::volumeOf(const QString& path, qint64& freeBytes) {
+    // the directory may not exist yet: the volume is the one of its closest existing parent
+    QFileInfo info(path);
+    while( !info.exists() && !info.isRoot() ) {
+        info.setFile(info.absolutePath());
+    }
+    QStorageInfo storage(info.absoluteFilePath());
+    freeBytes = storage.isValid() ? storage.bytesAvailable() : 0;
+    return storage.rootPath();
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef DISKQUOTA_H
+#define DISKQUOTA_H
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStorageInfo>
+#include <QFileInfo>
+#include <QFile>
+#include <QDebug>
+
+#define DISK_SAFETY_MARGIN 64*1024*1024
+
+/**
+ * @brief The Reservation class, the bytes reserved by a download on a volume that are not written (or preallocated) yet
+ */
+class Reservation {
+public:
+    QString volume;
+    qint64 bytes = 0;
+};
+
+/**
+ * @brief The DiskQuota class is the ledger of the space reserved by the ongoing downloads, shared by all the handler threads.
+ * The free space reported by the volume only drops while the bytes are written: without the ledger, concurrent downloads
+ * would all be accepted against the same free space. DISK_SAFETY_MARGIN bytes are always left free on the volume.
+ */
+class DiskQuota
+{
+public:
+    static DiskQuota* Instance();
+
+    /**
+     * @brief available, the bytes that a new download can use on the volume of path
+     */
+    qint64 available(const QString& path);
+
+    /**
+     * @brief reserve, reserves size bytes on the volume of path for the download
+     * @return false if there is not enough space
+     */
+    bool reserve(int code, const QString& path, qint64 size);
+
+    /**
+     * @brief consume, the download wrote (or preallocated) bytes: they are taken from its reservation
+     */
+    void consume(int code, qint64 bytes);
+    void release(int code);
+
+    /**
+     * @brief preallocate, allocates the size of the file on the volume where supported (posix_fallocate on Linux)
+     * @return false if the volume is full, true if the file has been preallocated or preallocation is not supported
+     * @param preallocated, set to true if the space has been allocated
+     */
+    static bool preallocate(QFile* file, qint64 size, bool& preallocated);
+
+private:
+    DiskQuota() {}
+    QMutex quota_m;
+    QHash<QString, qint64> reservedOnVolume;
+    QHash<int, Reservation> reservations;
+
+    static QString volumeOf(const QString& path, qint64& freeBytes);
+
+};
+
+#endif // DISKQUOTA_H
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "DiskWriter.h"
+
+WriteStream::~WriteStream() {
+    WriteBlock* block = nullptr;
+    while( filled.pop(block) ) {
+        if( block->closeFile ) delete block->file;
+        delete block;
+    }
+    while( recycled.pop(block) ) {
+        delete block;
+    }
+    delete current;
+}
+
+WriteBlock* WriteStream::block() {
+    if( current != nullptr ) return current;
+    if( recycled.pop(current) ) return current;
+    if( allocated < WRITE_QUEUE_SLOTS ) {
+        allocated++;
+        current = new WriteBlock;
+        return current;
+    }
+    starved.fetchAndStoreOrdered(1);
+    // the writer may have freed one in the meantime
+    if( recycled.pop(current) ) return current;
+    return nullptr;
+}
+
+void WriteStream::push() {
+    if( current == nullptr ) return;
+    pending.ref();
+    queued.fetchAndAddOrdered(current->size);
+    // there are never more than WRITE_QUEUE_SLOTS blocks: the queue cannot be full
+    filled.push(current);
+    current = nullptr;
+    DiskWriter::Instance()->wake();
+}
+
+void WriteStream::flush() {
+    QMutexLocker ml(&done_m);
+    while( pending.loadAcquire() > 0 ) {
+        done_c.wait(&done_m, WRITE_FLUSH_CHECK);
+    }
+}
+
+void WriteStream::cancel() {
+    cancelled.storeRelease(1);
+    if( current != nullptr ) current->size = 0;
+}
+
+bool WriteStream::failed() const {
+    return error.loadAcquire();
+}
+
+QString WriteStream::errorString() const {
+    return failed() ? errorMessage : QString();
+}
+
+qint64 WriteStream::queuedBytes() const {
+    return queued.loadAcquire() + (current != nullptr ? current->size : 0);
+}
+
+bool WriteStream::writeNext() {
+    WriteBlock* block = nullptr;
+    if( !filled.pop(block) ) return false;
+
+    if( !cancelled.loadAcquire() && !error.loadAcquire() && block->size > 0 ) {
+        if( block->file->write(block->data.constData(), block->size) != block->size ) {
+            errorMessage = block->file->errorString();
+            error.storeRelease(1);
+        }
+    }
+    if( block->closeFile ) {
+        block->file->close();
+        delete block->file;
+    }
+
+    queued.fetchAndAddOrdered(-block->size);
+    block->file = nullptr;
+    block->size = 0;
+    block->closeFile = false;
+    recycled.push(block);
+
+    if( !pending.deref() ) {
+        QMutexLocker ml(&done_m);
+        done_c.wakeAll();
+    }
+    if( starved.testAndSetOrdered(1, 0) ) emit written();
+    return true;
+}
+
+DiskWriter* DiskWriter::Instance()
+{
+    static DiskWriter instance;
+    return &instance;
+}
+
+void DiskWriter::start() {
+    if( workerThread != nullptr ) return;
+    workerThread = new QThread;
+    workerThread->setObjectName("tibi-disk");
+    moveToThread(workerThread);
+    workerThread->start();
+}
+
+void DiskWriter::stop() {
+    if( workerThread == nullptr ) return;
+    workerThread->quit();
+    if( !workerThread->wait(WRITE_STOP_TIMEOUT) ) {
+        qDebug() << "DISK WRITER: the worker did not stop in time";
+        return;
+    }
+    delete workerThread;
+    workerThread = nullptr;
+    QMutexLocker ml(&streams_m);
+    streams.clear();
+}
+
+QSharedPointer<WriteStream> DiskWriter::open() {
+    // the last reference may be dropped by the writer thread, once the thread of the handler is gone: a deferred delete would never run.
+    // Nothing is ever posted to the stream, so it is deleted right away by whichever thread releases it.
+    QSharedPointer<WriteStream> stream(new WriteStream);
+    QMutexLocker ml(&streams_m);
+    streams.push_back(stream);
+    return stream;
+}
+
+void DiskWriter::close(QSharedPointer<WriteStream> stream) {
+    QMutexLocker ml(&streams_m);
+    streams.removeAll(stream);
+}
+
+void DiskWriter::wake() {
+    if( workerThread == nullptr ) {
+        drain();
+        return;
+    }
+    if( scheduled.testAndSetOrdered(0, 1) ) QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+}
+
+void DiskWriter::drain() {
+    // a block queued from now on schedules another run
+    scheduled.storeRelease(0);
+    QMutexLocker ml(&streams_m);
+    QList<QSharedPointer<WriteStream>> active = streams;
+    ml.unlock();
+
+    bool more = true;
+    while( more ) {
+        more = false;
+        for( const QSharedPointer<WriteStream>& stream : active ) {
+            if( stream->writeNext() ) more = true;
+        }
+    }
+}
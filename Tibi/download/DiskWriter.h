@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef DISKWRITER_H
+#define DISKWRITER_H
+
+#include <QObject>
+#include <QThread>
+#include <QFile>
+#include <QList>
+#include <QSharedPointer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QDebug>
+#include "download/SpscQueue.h"
+
+#define WRITE_BLOCK_SIZE 256*1024
+#define WRITE_QUEUE_SLOTS 16
+#define WRITE_FLUSH_CHECK 500
+#define WRITE_STOP_TIMEOUT 5000
+
+/**
+ * @brief The WriteBlock class, up to WRITE_BLOCK_SIZE bytes of a file. A block never spans two files: the last one of a file
+ * hands it over to the writer, that closes and deletes it.
+ */
+class WriteBlock {
+public:
+    WriteBlock() : data(WRITE_BLOCK_SIZE, Qt::Uninitialized) {}
+    QFile* file = nullptr;
+    QByteArray data;
+    int size = 0;
+    bool closeFile = false;
+
+    bool isFull() const { return size == data.size(); }
+};
+
+/**
+ * @brief The WriteStream class connects a DownloadHandler (the producer) to the DiskWriter (the consumer) with two SpscQueue:
+ * the filled blocks go to the writer, the written ones come back to be filled again. There are at most WRITE_QUEUE_SLOTS blocks:
+ * when all of them are queued the handler stops reading, and is woken up by written once the writer freed one.
+ */
+class WriteStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WriteStream(QObject* parent = nullptr) : QObject(parent) {}
+    ~WriteStream() override;
+
+    /* -- handler side -- */
+
+    /**
+     * @brief block, the block being filled, or a free one
+     * @return nullptr if all the blocks are queued
+     */
+    WriteBlock* block();
+
+    /**
+     * @brief push, queues the block being filled
+     */
+    void push();
+
+    /**
+     * @brief flush, waits until everything queued has been written
+     */
+    void flush();
+
+    /**
+     * @brief cancel, the blocks queued are not written anymore (their files are still closed): the download is being removed
+     */
+    void cancel();
+
+    bool failed() const;
+    QString errorString() const;
+    qint64 queuedBytes() const;
+
+signals:
+    /**
+     * @brief written, emitted by the writer thread when a block is free again after the handler found none
+     */
+    void written();
+
+private:
+    friend class DiskWriter;
+    SpscQueue<WriteBlock*, WRITE_QUEUE_SLOTS> filled;
+    SpscQueue<WriteBlock*, WRITE_QUEUE_SLOTS> recycled;
+    WriteBlock* current = nullptr;
+    int allocated = 0;
+    QAtomicInt starved = 0;
+    QAtomicInt pending = 0;
+    QAtomicInteger<qint64> queued = 0;
+    QAtomicInt cancelled = 0;
+    QAtomicInt error = 0;
+    QString errorMessage;       // set by the writer before error
+    QMutex done_m;
+    QWaitCondition done_c;
+
+    /**
+     * @brief writeNext, writer side: writes the next block queued
+     * @return false if there was none
+     */
+    bool writeNext();
+
+};
+
+/**
+ * @brief The DiskWriter class writes the files of all the downloads on its own thread, so that a handler decrypts and parses
+ * the next bytes while the previous ones reach the disk. The streams are served in turn, one block each, so that a fast download
+ * doesn't starve the others. The handlers fill whole blocks before queuing them: the writes are coalesced in WRITE_BLOCK_SIZE bytes.
+ */
+class DiskWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    static DiskWriter* Instance();
+
+    void start();
+
+    /**
+     * @brief stop, called after the handlers terminated: the streams left are dropped
+     */
+    void stop();
+
+    /**
+     * @brief open, a new stream for a download. It is thread safe, as close.
+     */
+    QSharedPointer<WriteStream> open();
+    void close(QSharedPointer<WriteStream> stream);
+
+    /**
+     * @brief wake, something has been queued
+     */
+    void wake();
+
+private slots:
+    void drain();
+
+private:
+    DiskWriter() {}
+    QThread* workerThread = nullptr;
+    QAtomicInt scheduled = 0;
+    QMutex streams_m;
+    QList<QSharedPointer<WriteStream>> streams;
+
+};
+
+#endif // DISKWRITER_H
@@ -30,7 +30,9 @@ public:
     QString itemName;
     QString downloadsPath;
     Types type;
+    qint32 itemCount = -1;  // files in the item, -1 if the sender doesn't announce it
     QTime timeStart = QTime(0,0,0);
+    qint64 pausedMsecs = 0;
     Status status = Status::WaitingForAnswer;
     bool operator ==(const Download& d) {
         if( this->code == d.code ) {
@@ -8,8 +8,9 @@
 #include "download/DownloadHandler.h"
 
 
-DownloadHandler::DownloadHandler(qintptr socketDescriptor, int code, QString downloadsPath) :
-    socketDescriptor(socketDescriptor)
+DownloadHandler::DownloadHandler(qintptr socketDescriptor, int code, QString downloadsPath, const CollisionPolicy* policy) :
+    socketDescriptor(socketDescriptor),
+    policy(policy)
 
 {
 
@@ -24,12 +25,16 @@ void DownloadHandler::initSocket() {
 
     qDebug() << QThread::currentThreadId() << " - TIBI DOWNLOAD HANDLER run";
 
-    receiverSocket = new QSslSocket;
+    // child of the handler, so that it follows it to the transfer thread
+    receiverSocket = new QSslSocket(this);
     configSocket();
     receiverSocket->setSocketDescriptor(socketDescriptor);
 
-    in.setDevice(receiverSocket);
+    source = receiverSocket;
+    in.setDevice(source);
     in.setVersion(QDataStream::Qt_5_5);
+    memoryId = MemoryGovernor::Instance()->join();
+    boundReadBuffer();
 
     qDebug() << "Tibier connected: " << receiverSocket->peerAddress().toString()
              << "@" << receiverSocket->peerPort();
@@ -79,25 +84,29 @@ void DownloadHandler::connectSocket() {
 
 
 void DownloadHandler::onReadyRead() {
-    if( receiverSocket->bytesAvailable() == 0 ) return;
+    if( paused ) return;
+    if( source->bytesAvailable() == 0 ) return;
     if( checkAbort()) return;
 
-    if( !metadataCompleted ) {
+    if( awaitingManifest ) {
+        getManifest();
+    } else if( !metadataCompleted ) {
         metadataCompleted = getFirstMetadata();
     } else {
         download->type == Types::Dir ? downloadDir() : downloadFile();
     }
+    boundReadBuffer();
 
 }
 
 bool DownloadHandler::getFirstMetadata() {
     qDebug() << "get first metadata called";
-    if( firstMetadataSize == 0 && receiverSocket->bytesAvailable() >= 2 ) {
+    if( firstMetadataSize == 0 && source->bytesAvailable() >= 2 ) {
         qDebug() << "firstMetadataSize: " << firstMetadataSize;
         in >> firstMetadataSize;
     }
 
-    if( firstMetadataSize!=0 && receiverSocket->bytesAvailable() >= firstMetadataSize) {
+    if( firstMetadataSize!=0 && source->bytesAvailable() >= firstMetadataSize) {
         getmetadata();
         qDebug() << "download handler emits wait for confirmation signal";
         emit waitForConfirmation(download);
@@ -109,12 +118,25 @@ bool DownloadHandler::getFirstMetadata() {
 }
 
 void DownloadHandler::getmetadata() {
-    qDebug() << "Received metadata of " << receiverSocket->bytesAvailable() << "bytes";
+    qDebug() << "Received metadata of " << source->bytesAvailable() << "bytes";
     in >> download->idSender;
     in >> download->usernameSender;
-    getType();
+    quint8 flags = getType();
     in >> download->itemName;
     in >> download->totalSize;
+    if( flags & ITEM_COUNT_FLAG ) in >> download->itemCount;
+    if( flags & MULTICAST_FLAG ) {
+        QString group;
+        in >> group;
+        in >> multicastOffer.port;
+        in >> multicastOffer.session;
+        in >> multicastOffer.key;
+        multicastOffer.group = QHostAddress(group);
+    }
+    if( flags & SWARM_FLAG ) {
+        in >> swarm;
+        in >> swarmPort;
+    }
     download->totalBytesLeft = download->totalSize;
 
     qDebug() << "id sender: " << download->idSender.toString()
@@ -122,28 +144,53 @@ void DownloadHandler::getmetadata() {
              << "\ntype: " << download->type
              << "\nitem name: " << download->itemName
              << "\nitem size: " << download->totalSize
-             << "\n(" << receiverSocket->bytesAvailable() << " left in the socket )";
+             << "\nitem count: " << download->itemCount
+             << "\nmulticast: " << multicastOffer.group.toString()
+             << "\nswarm: " << swarm
+             << "\n(" << source->bytesAvailable() << " left in the socket )";
 }
 
-void DownloadHandler::getType() {
+quint8 DownloadHandler::getType() {
     quint8 type_code = 3;
     in >> type_code;
+    quint8 flags = type_code & (ITEM_COUNT_FLAG | MULTICAST_FLAG | SWARM_FLAG);
+    type_code &= ~(ITEM_COUNT_FLAG | MULTICAST_FLAG | SWARM_FLAG);
     if( type_code == 0 ) download->type = Types::File;
     else if( type_code == 1 ) download->type = Types::Dir;
     else {
         signalStatusAndTerminate(Status::Error, "Received unknown type");
 
     }
+    return flags;
 }
 
 
-void DownloadHandler::userAnswer(int code, Status status) {
+void DownloadHandler::userAnswer(int code, Status status, const QString& targetDir) {
     qDebug() << "handler: user answer received";
     if( code != download->code ) return;
     download->status = status;
-    download->status == Status::Accepted ?
-                accepted() :
-                declined();
+    if( status == Status::NoSpace ) {
+        if( !targetDir.isEmpty() ) download->downloadsPath = targetDir;
+        noSpace();
+        return;
+    }
+    if( download->status != Status::Accepted ) {
+        declined();
+        return;
+    }
+
+    if( !targetDir.isEmpty() ) {
+        if( QDir().mkpath(targetDir) ) download->downloadsPath = targetDir;
+        else qDebug() << "Impossible to create the target directory" << targetDir << ", using" << download->downloadsPath;
+    }
+
+    // the transfer writes to disk and may wait for the user (overwrite, collisions): it leaves the network pool for a thread of its own
+    QThread* transferThread = new QThread;
+    connect(this, &DownloadHandler::terminationRequest, transferThread, &QThread::quit);
+    connect(transferThread, &QThread::finished, transferThread, &QThread::deleteLater);
+    transferThread->start();
+    moveToThread(transferThread);
+    QMetaObject::invokeMethod(this, "accepted", Qt::QueuedConnection);
 
 }
 
@@ -153,31 +200,112 @@ void DownloadHandler::declined() {
 }
 
 void DownloadHandler::accepted() {
-    qDebug() << "User confirmed the download. Start downloading the content of the first metadata";
+    qDebug() << "User confirmed the download. Looking for collisions with the existing items";
+    overwrite = false;
+    QString newName = nextFreeName();
+    if( newName == "" ) {
+        startDownload();
+        return;
+    }
+
+    // the common cases are solved by the policy without asking the user
+    switch( policy->resolve(download->idSender, download->type, download->itemName) ) {
+    case CollisionAction::Overwrite:
+        overwrite = true;
+        startDownload();
+        break;
+    case CollisionAction::Rename:
+        download->itemName = newName;
+        emit itemRenamed(download->code, newName);
+        startDownload();
+        break;
+    case CollisionAction::Skip:
+        skipped();
+        break;
+    default:
+        // the answer arrives later on overwriteAnswer: the sender keeps waiting for our answer meanwhile
+        emit askOverwrite(download->code, download->idSender, download->type == Types::Dir ? "directory" : "file", download->itemName, newName);
+    }
+}
+
+void DownloadHandler::overwriteAnswer(int code, bool overwrite, const QString& newName) {
+    if( code != download->code ) return;
+    if( checkAbort() ) return;
+    this->overwrite = overwrite;
+    if( !overwrite ) download->itemName = newName;
+    startDownload();
+}
+
+void DownloadHandler::startDownload() {
+    // check if other threads are downloading an item with the same name
+    if( concurrentCollision() ) return;
+
+    // the space is reserved before the answer reaches the sender, so concurrent downloads cannot overcommit the volume
+    if( !reserved ) {
+        if( !DiskQuota::Instance()->reserve(download->code, download->downloadsPath, download->totalSize) ) {
+            noSpace();
+            return;
+        }
+        reserved = true;
+    }
+
+    // the item is written in the staging directory and renamed into place by commitDownload
+    stagingDir = StagingArea::create(download->downloadsPath);
+    if( stagingDir.isEmpty() ) {
+        signalStatusAndTerminate(Status::Error, "Impossible to create the staging directory in " + download->downloadsPath);
+        return;
+    }
+    itemPath = stagingDir + "/" + download->itemName;
+    qDebug() << "final item path: " << finalPath << " - staged in " << itemPath;
+
     if( download->type == Types::Dir) {
-        computeDirDownloadPath();
         dirToDownload.setPath(itemPath);
-        QDir downloadsDir(download->downloadsPath);
-        if( !downloadsDir.mkpath(download->itemName) ) { signalStatusAndTerminate(Status::Error, "Impossible to create directory " + itemPath);
+        if( !QDir(stagingDir).mkpath(download->itemName) ) { signalStatusAndTerminate(Status::Error, "Impossible to create directory " + itemPath);
             return;
         }
         qDebug() << "dir created";
     } else {
-        computeFileDownloadPath();
         relativePath.clear();
         if( ! openFile() ) return;
         fileSize = download->totalSize;
         bytesLeft = fileSize;
+        if( !preallocateFile() ) return;
         filesCounter = 1;
         subDirCounter = 0;
         qDebug() << "Ready to wait for file";
     }
 
     sendAnswerToSender();
+    joinGroup();
     download->timeStart.start();
 
 }
 
+void DownloadHandler::noSpace() {
+    download->status = Status::Declined;
+    sendAnswerToSender();
+    signalStatusAndTerminate(Status::NoSpace, "Not enough space in " + download->downloadsPath);
+}
+
+bool DownloadHandler::preallocateFile() {
+    bool preallocated = false;
+    if( !DiskQuota::preallocate(currentDownload, fileSize, preallocated) ) {
+        removeDownloads();
+        signalStatusAndTerminate(Status::NoSpace, "Not enough space for " + itemPath + "/" + relativePath);
+        return false;
+    }
+    // the volume accounts for the preallocated bytes now
+    if( preallocated ) DiskQuota::Instance()->consume(download->code, fileSize);
+    filePreallocated = preallocated;
+    return true;
+}
+
+void DownloadHandler::skipped() {
+    download->status = Status::Declined;
+    sendAnswerToSender();
+    signalStatusAndTerminate(Status::Skipped, "An item with the same name already exists");
+}
+
 
 bool DownloadHandler::openFile() {
     qDebug() << "open file at: " << itemPath + "/" + relativePath;
@@ -185,7 +313,7 @@ bool DownloadHandler::openFile() {
     else currentDownload = new QFile(itemPath);
 
 
-    if( ! currentDownload->open(QIODevice::WriteOnly) ) {
+    if( ! currentDownload->open(QIODevice::WriteOnly | QIODevice::Unbuffered) ) {
         if( currentDownload != nullptr)  {
             delete currentDownload;
             currentDownload = nullptr;
@@ -210,85 +338,121 @@ void DownloadHandler::sendAnswerToSender() {
     qDebug() << "Answer sent";
 }
 
+void DownloadHandler::joinGroup() {
+    if( multicastOffer.session != 0 ) {
+        joinGroup(new MulticastReceiver(multicastOffer, receiverSocket->peerAddress(), this));
+    } else if( swarm != 0 ) {
+        awaitingManifest = true;
+    }
+}
 
-void DownloadHandler::computeDirDownloadPath() {
-    // since this is the first item, we need to check if other directory have the same name
-
-    dirToDownload.setPath(download->downloadsPath + "/" + download->itemName);
-
-    QString dirName = "";
-    for(int i = 1; dirToDownload.exists(); i++) {
-        dirName = download->itemName + " (" + QString::number(i) + ")";
-        dirToDownload.setPath(download->downloadsPath + "/" + dirName);
+void DownloadHandler::joinGroup(GroupReceiver* receiver) {
+    group = receiver;
+    if( !group->join() ) {
+        requestUnicast("the group cannot be joined");
+        return;
+    }
+    source = group;
+    in.setDevice(source);
+    connect(group, &GroupReceiver::readyRead, this, &DownloadHandler::onReadyRead, Qt::QueuedConnection);
+    connect(group, &GroupReceiver::fallback, this, &DownloadHandler::requestUnicast, Qt::QueuedConnection);
+}
+
+bool DownloadHandler::getManifest() {
+    // the size of the QByteArray comes first
+    QByteArray size = receiverSocket->peek(4);
+    if( size.size() < 4 ) return false;
+    quint32 manifestSize = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(size.constData()));
+    if( manifestSize != 0xFFFFFFFF && receiverSocket->bytesAvailable() < 4 + static_cast<qint64>(manifestSize) ) return false;
+
+    QByteArray encoded;
+    in >> encoded;
+    QSharedPointer<SwarmManifest> manifest(new SwarmManifest());
+    if( !manifest->decode(encoded) ) {
+        requestUnicast("the manifest of the swarm is not valid");
+        return true;
     }
+    awaitingManifest = false;
+    joinGroup(new SwarmReceiver(manifest, swarm, SwarmServer::unmapped(receiverSocket->peerAddress()), swarmPort, this));
+    return true;
+}
 
-    newItemName(dirName);
+void DownloadHandler::requestUnicast(const QString& reason) {
+    if( group == nullptr && !awaitingManifest ) return;
+    qint64 consumed = group != nullptr ? group->consumed() : 0;
+    qDebug() << "Download " << download->code << " continues on the socket after " << consumed << " bytes: " << reason;
 
-    // check if other threads are downloading dir with the same name
-    if( concurrentCollision() ) return;
-    itemPath = download->downloadsPath + "/" + download->itemName;
-    qDebug() << "final item path: " << itemPath;
+    QByteArray requestBlock;
+    QDataStream out(&requestBlock, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_5);
+    out << consumed;
+    receiverSocket->write(requestBlock);
+
+    // the bytes received from the group but not read yet are sent again by the sender
+    awaitingManifest = false;
+    if( group != nullptr ) {
+        group->disconnect(this);
+        group->close();
+        group->deleteLater();
+        group = nullptr;
+    }
+    source = receiverSocket;
+    in.setDevice(source);
+    onReadyRead();
 }
 
 
-void DownloadHandler::computeFileDownloadPath() {
+QString DownloadHandler::nextFreeName() {
     QString newName = "";
+
+    if( download->type == Types::Dir ) {
+        QDir dir(download->downloadsPath + "/" + download->itemName);
+        for( int i = 1; dir.exists(); i++ ) {
+            newName = download->itemName + " (" + QString::number(i) + ")";
+            dir.setPath(download->downloadsPath + "/" + newName);
+        }
+        return newName;
+    }
+
     QString clearFileName = getClearFileName(download->itemName);
     QString fileExtension = getFileExtension(download->itemName);
     QFileInfo infoFile(download->downloadsPath + "/" + download->itemName);
-
-    //1. check if the file already exists
     for( int i=1; infoFile.exists(); i++) {
         newName = clearFileName + " (" + QString::number(i) + ")" + fileExtension;
         infoFile.setFile(download->downloadsPath + "/" + newName);
     }
-
-    newItemName(newName);
-    if( concurrentCollision() ) return;
-    itemPath = download->downloadsPath + "/" + download->itemName;
-    qDebug() << "final item path: " << itemPath;
-
-
-}
-
-void DownloadHandler::newItemName(const QString &newName) {
-    //if it already exists, ask the user what to do
-    if( newName != "") {
-        QString typeString = "directory";
-        if( download->type != Types::Dir )  typeString = "file";
-        bool overwrite = emit askOverwrite(download->code, typeString, download->itemName, newName);
-        if( !overwrite ) {
-            download->itemName = newName;
-        }
-    }
-
+    return newName;
 }
 
 
-bool DownloadHandler::concurrentCollision(const QString& fileExtension) {
+bool DownloadHandler::concurrentCollision() {
     //check if other threads are currently downloading on the same path
-    fileLock = new QLockFile(download->downloadsPath + "/" + download->itemName + "lockfile");
-    fileLock->setStaleLockTime(0);
-    if( !fileLock->tryLock() ) {
-        delete fileLock;
+    QString path = download->downloadsPath + "/" + download->itemName;
+    if( finalPath == path ) return false;
+    if( !finalPath.isEmpty() ) StagingArea::releaseName(finalPath);
+    finalPath.clear();
+
+    if( !StagingArea::reserveName(path) ) {
         QString collision = download->itemName;
-        if( fileExtension == nullptr) {
+        if( download->type == Types::Dir ) {
             download->itemName += " copy";
         }
         else {
-            download->itemName = getClearFileName(download->itemName) + " copy" + fileExtension;
+            download->itemName = getClearFileName(download->itemName) + " copy" + getFileExtension(download->itemName);
         }
         emit informCollision(download->code, collision, download->itemName);
-        computeFileDownloadPath();
+        // the new name may collide with an existing item as well
+        accepted();
         return true;
     }
+    finalPath = path;
     return false;
 }
 
 
 
 void DownloadHandler::downloadDir() {
-    qDebug() << "\n\nByte nel receiver: " << receiverSocket->bytesAvailable();
+    qDebug() << "\n\nByte nel receiver: " << source->bytesAvailable();
     //1. Create subdirs first
     getCounter(subDirCounter);
     qDebug() << "sub dir counter: " << subDirCounter;
@@ -315,7 +479,7 @@ void DownloadHandler::downloadDir() {
 
 
 void DownloadHandler::getCounter(qint16 &counter) {
-    if( counter < 0 && receiverSocket->bytesAvailable() >= 2) {
+    if( counter < 0 && source->bytesAvailable() >= 2) {
         in >> counter;
         qDebug() << "NEW COUNTER: " << counter;
     }
@@ -339,12 +503,12 @@ void DownloadHandler::createSubDir() {
 bool DownloadHandler::getFileInfo() {
     qDebug() << "get info file: ";
     getRelativePath();
-    if( relativePath != "" && receiverSocket->bytesAvailable() >= 8 ) {
+    if( relativePath != "" && source->bytesAvailable() >= 8 ) {
         in >> fileSize;
         bytesLeft = fileSize;
         qDebug() << "file size: " << fileSize;
         if( !openFile() ) return false;
-        return true;
+        return preallocateFile();
     }
 
     return false;
@@ -353,7 +517,7 @@ bool DownloadHandler::getFileInfo() {
 
 bool DownloadHandler::getRelativePath() {
     getPathSize();
-    if( pathSize == 0 || relativePath != "" || receiverSocket->bytesAvailable() < static_cast<qint64>(pathSize*sizeof(QChar))) return false;
+    if( pathSize == 0 || relativePath != "" || source->bytesAvailable() < static_cast<qint64>(pathSize*sizeof(QChar))) return false;
 
     in >> relativePath;
     qDebug() << "relative path: " << relativePath;
@@ -362,7 +526,7 @@ bool DownloadHandler::getRelativePath() {
 }
 
 void DownloadHandler::getPathSize() {
-    if( pathSize == 0 && receiverSocket->bytesAvailable() >= 2) {
+    if( pathSize == 0 && source->bytesAvailable() >= 2) {
         in >> pathSize;
         qDebug() << "relative path size: " << pathSize;
     }
@@ -372,26 +536,62 @@ void DownloadHandler::getPathSize() {
 void DownloadHandler::downloadFile() {
 
     qDebug() << "\nDownload file " << itemPath + "/" + relativePath << "\n byte left: " << bytesLeft << "/" << fileSize;
-    qDebug() << "Byte to read in the receiver: " << receiverSocket->bytesAvailable();
+    qDebug() << "Byte to read in the receiver: " << source->bytesAvailable();
+
 
+    if( writer.isNull() ) {
+        writer = DiskWriter::Instance()->open();
+        connect(writer.data(), &WriteStream::written, this, &DownloadHandler::onReadyRead, Qt::QueuedConnection);
+    }
+    if( writer->failed() ) {
+        QString error = writer->errorString();
+        removeDownloads();
+        signalStatusAndTerminate(Status::Error, "Impossible to write " + itemPath + "/" + relativePath + ": " + error);
+        return;
+    }
 
-    qint64 written = 0;
-    if( written < fileSize ) {
-        written += currentDownload->write(receiverSocket->read(bytesLeft));
-        qDebug() << "Byte written in the file: " << written;
+    // all the blocks are waiting for the disk: the next bytes are read once one is free
+    WriteBlock* block = writer->block();
+    if( block == nullptr ) return;
+    block->file = currentDownload;
+
+    // the last block of the file hands it over to the writer
+    qint64 received = 0;
+    bool handedOver = false;
+    while( bytesLeft - received > 0 ) {
+        qint64 size = qMin<qint64>(bytesLeft - received, block->data.size() - block->size);
+        qint64 read = source->read(block->data.data() + block->size, size);
+        if( read <= 0 ) break;
+        block->size += static_cast<int>(read);
+        received += read;
+        handedOver = received == bytesLeft;
+        if( block->isFull() || handedOver ) {
+            block->closeFile = handedOver;
+            writer->push();
+            if( handedOver ) break;
+            block = writer->block();
+            if( block == nullptr ) break;
+            block->file = currentDownload;
+        }
     }
-    bytesLeft -= written;
-    download->totalBytesLeft -= written;
+    qDebug() << "Byte queued for the file: " << received;
+
+    if( !filePreallocated ) DiskQuota::Instance()->consume(download->code, received);
+    bytesLeft -= received;
+    download->totalBytesLeft -= received;
 
     emit updateDownload(QSharedPointer<Download>(new Download(*download)));
 
     if( bytesLeft > 0 ) return;
 
-    if( currentDownload != nullptr)  {
-        delete currentDownload;
-        currentDownload = nullptr;
+    if( !handedOver ) {
+        // an empty file
+        block->closeFile = true;
+        writer->push();
     }
+    currentDownload = nullptr;
 
+    filePreallocated = false;
     pathSize = 0;
     relativePath.clear();
     fileSize = 0;
@@ -407,9 +607,11 @@ void DownloadHandler::downloadFile() {
 
 void DownloadHandler::checkEnd() {
     qDebug() << "Check end: Byte restanti da leggere: " << download->totalBytesLeft;
-    qDebug() << "Byte nel receiver: " << receiverSocket->bytesAvailable();
+    qDebug() << "Byte nel receiver: " << source->bytesAvailable();
 
     if(download->totalBytesLeft != 0) return;
+    if( !flushWriter() ) return;
+    if( !commitDownload() ) return;
     signalStatusAndTerminate(Status::Completed, "All bytes received");
 
 }
@@ -432,6 +634,57 @@ void DownloadHandler::appClose() {
     signalStatusAndTerminate(Status::Aborted, "Abort requested");
 }
 
+void DownloadHandler::setPaused(bool pause) {
+    if( paused == pause ) return;
+    if( download->status != Status::Accepted && download->status != Status::Paused ) return;
+
+    paused = pause;
+    if( paused ) {
+        qDebug() << "Download " << download->code << " paused";
+        receiverSocket->setReadBufferSize(PAUSED_READ_BUFFER_SIZE);
+        if( group != nullptr ) group->setPaused(true);
+        pauseTime.start();
+        download->status = Status::Paused;
+        emit updateDownload(QSharedPointer<Download>(new Download(*download)));
+        return;
+    }
+
+    qDebug() << "Download " << download->code << " resumed";
+    boundReadBuffer();
+    if( group != nullptr ) group->setPaused(false);
+    download->pausedMsecs += pauseTime.elapsed();
+    download->status = Status::Accepted;
+    emit updateDownload(QSharedPointer<Download>(new Download(*download)));
+
+    // the sender may have already sent everything: process what is buffered without waiting for a new readyRead
+    qint64 available = -1;
+    while( !paused && source->bytesAvailable() > 0 && source->bytesAvailable() != available ) {
+        available = source->bytesAvailable();
+        onReadyRead();
+    }
+}
+
+bool DownloadHandler::flushWriter() {
+    if( writer.isNull() ) return true;
+    writer->flush();
+    if( !writer->failed() ) return true;
+    QString error = writer->errorString();
+    removeDownloads();
+    signalStatusAndTerminate(Status::Error, "Impossible to write " + itemPath + ": " + error);
+    return false;
+}
+
+void DownloadHandler::boundReadBuffer() {
+    if( memoryId < 0 || receiverSocket == nullptr ) return;
+    MemoryGovernor* governor = MemoryGovernor::Instance();
+    // the bytes received from a group wait in its buffer as well
+    qint64 held = receiverSocket->bytesAvailable() + (source != receiverSocket ? source->bytesAvailable() : 0)
+            + (writer.isNull() ? 0 : writer->queuedBytes());
+    governor->update(memoryId, held);
+    // once the buffer is full the socket stops reading, and TCP slows down the sender
+    if( !paused ) receiverSocket->setReadBufferSize(governor->share());
+}
+
 void DownloadHandler::signalAbort() {
     QMutexLocker ml(&abort_m);
     abort = true;
@@ -459,37 +712,100 @@ bool DownloadHandler::checkAbort() {
     return abort;
 }
 
+bool DownloadHandler::commitDownload() {
+    for( int attempt = 0; attempt < COMMIT_ATTEMPTS; attempt++ ) {
+        // a new item with the same name may have appeared in the meantime
+        if( !overwrite && QFileInfo::exists(finalPath) ) renameFinalPath();
+
+        if( StagingArea::commit(stagingDir, itemPath, finalPath, overwrite) ) {
+            stagingDir.clear();
+            itemPath = finalPath;
+            return true;
+        }
+        // the item may have been created between the check and the rename: the next attempt goes to a new name
+        overwrite = false;
+        renameFinalPath();
+    }
+
+    // the download is completed: its data is not dropped, it stays in the staging directory until the next start
+    QString kept = itemPath;
+    stagingDir.clear();
+    signalStatusAndTerminate(Status::Error, "Impossible to move " + kept + " to " + finalPath + ", the item is kept in " + kept);
+    return false;
+}
+
+void DownloadHandler::renameFinalPath() {
+    StagingArea::releaseName(finalPath);
+    QString newName = reserveFreeName();
+    finalPath = download->downloadsPath + "/" + newName;
+    download->itemName = newName;
+    emit itemRenamed(download->code, newName);
+}
+
+QString DownloadHandler::reserveFreeName() {
+    QString clearName = download->type == Types::Dir ? download->itemName : getClearFileName(download->itemName);
+    QString extension = download->type == Types::Dir ? "" : getFileExtension(download->itemName);
+    for( int i = 1; ; i++ ) {
+        QString newName = clearName + " (" + QString::number(i) + ")" + extension;
+        QString path = download->downloadsPath + "/" + newName;
+        // a name free on disk may still be reserved by another ongoing download
+        if( !QFileInfo::exists(path) && StagingArea::reserveName(path) ) return newName;
+    }
+}
+
 void DownloadHandler::removeDownloads() {
     qDebug() << "The sender aborted the operation or the application has to exit. Removing data. ";
-    if(itemPath == "") return; //abort request happened in the initial phase. nothing to remove
+    if(stagingDir == "") return; //abort request happened in the initial phase. nothing to remove
     qDebug() << "Removing " << itemPath;
-    if(download->type == Types::Dir ) {
-        dirToDownload.removeRecursively();
-    } else {
-        currentDownload->remove();
+    if( !writer.isNull() ) {
+        // the files must not be written while they are moved away
+        writer->cancel();
+        writer->flush();
     }
+    if( currentDownload != nullptr ) currentDownload->close();
 
-    if(fileLock != nullptr) {
-        delete fileLock;
-        fileLock = nullptr;
-    }
+    // the partial item never left the staging directory: it is dropped as a whole, in the background
+    StagingArea::drop(stagingDir);
+    stagingDir.clear();
 
 }
 
 void DownloadHandler::signalStatusAndTerminate(Status status, const QString& message) {
     qDebug() << "NEW DOWNLOAD STATUS of " << download->itemName << " : " << message;
+    if( status == Status::Completed && group != nullptr && receiverSocket->state() == QAbstractSocket::ConnectedState ) {
+        // the sender of a transfer to a group cannot know that everything arrived
+        QByteArray endBlock;
+        QDataStream out(&endBlock, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_5);
+        out << static_cast<qint64>(-1);
+        receiverSocket->write(endBlock);
+        receiverSocket->waitForBytesWritten();
+    }
+    if( group != nullptr ) group->close();
     receiverSocket->disconnect();
     download->status = status;
     if( receiverSocket->state() == QAbstractSocket::ConnectedState ) {
         receiverSocket->disconnectFromHost();
     }
 
+    if( reserved ) DiskQuota::Instance()->release(download->code);
+    reserved = false;
+    if( memoryId >= 0 ) MemoryGovernor::Instance()->leave(memoryId);
+    memoryId = -1;
+
+    if( !writer.isNull() ) {
+        writer->flush();
+        writer->disconnect(this);
+        DiskWriter::Instance()->close(writer);
+        writer.clear();
+    }
+
     emit downloadFinished(download);
     if(download->status != Status::Declined) emit updateDownload(QSharedPointer<Download>(new Download(*download)));
 
-    if(fileLock != nullptr) {
-        delete fileLock;
-        fileLock = nullptr;
+    if( !finalPath.isEmpty() ) {
+        StagingArea::releaseName(finalPath);
+        finalPath.clear();
     }
 
     if( currentDownload != nullptr)  {
@@ -497,6 +813,9 @@ void DownloadHandler::signalStatusAndTerminate(Status status, const QString& mes
         currentDownload = nullptr;
     }
 
+    // a staging directory still here belongs to a failed download that didn't remove its data
+    if( !stagingDir.isEmpty() ) removeDownloads();
+
 
     emit terminationRequest();
 
@@ -15,12 +15,23 @@
 #include <QStringRef>
 #include <QSslConfiguration>
 #include <QMessageBox>
-#include <QLockFile>
 
 #include "Download.h"
+#include "download/CollisionPolicy.h"
+#include "download/DiskQuota.h"
+#include "download/StagingArea.h"
+#include "download/MulticastReceiver.h"
+#include "download/SwarmReceiver.h"
+#include "network/MemoryGovernor.h"
+#include "download/DiskWriter.h"
+
+#define PAUSED_READ_BUFFER_SIZE 64*1024
+#define COMMIT_ATTEMPTS 3
 
 /**
  * @brief The DownloadHandler class handle a specific download.
+ * It is created in a thread of the NetworkIOPool, where the TLS handshake and the first metadata are handled;
+ * once the user accepts the download it moves, with its socket, to a dedicated transfer thread.
  */
 
 class DownloadHandler : public QObject
@@ -33,8 +44,9 @@ public:
      * @param socketDescriptor
      * @param code of the download
      * @param download->downloadsPath, chosen by the user in preferences. It is passed by value to prevent inconsistency if the user changes while downloading.
+     * @param policy, solves the name collisions without asking the user. It is owned by the dispatcher.
      */
-    DownloadHandler(qintptr socketDescriptor, int code, QString downloadPath);
+    DownloadHandler(qintptr socketDescriptor, int code, QString downloadPath, const CollisionPolicy* policy);
 
     /**
      * @brief signalAbort, the DownloadDispatcher cannot directly abort the socket, since it's not the parent. It immediatly signals the abort exploiting a flag protected by a mutex. This flag is read by the handler before performing long operations inside an event in the loop.
@@ -52,19 +64,39 @@ public slots:
      * @brief userAnswer, slot called when the user accepts or declines a download confirmation.
      * @param code, the download code used to identify the specific download
      * @param status, accepted or declined
+     * @param targetDir, if not empty the item is saved there instead of in the download directory
+     */
+    void userAnswer(int code, Status status, const QString& targetDir);
+
+    /**
+     * @brief overwriteAnswer, slot called when the user answers the askOverwrite request
+     * @param overwrite, true to overwrite the existing item, false to save the download with newName
      */
-    void userAnswer(int code, Status status);
+    void overwriteAnswer(int code, bool overwrite, const QString& newName);
 
     void appClose();
     void abortConnection();
 
+    /**
+     * @brief setPaused, slot called through a queued connection when the user pauses or resumes the download.
+     * While paused the socket is not read anymore: its read buffer is bounded, so the TCP window closes and the sender
+     * slows down, while the TLS session stays up. The group the item is read from, if any, stops as well (GroupReceiver::setPaused).
+     * When resumed, the bytes already buffered are processed.
+     * @param pause
+     */
+    void setPaused(bool pause);
+
 signals:
     void terminationRequest();
     void waitForConfirmation(QSharedPointer<Download> download);
     void downloadFinished(QSharedPointer<Download> download);
     void updateDownload(QSharedPointer<Download> download);
-    bool askOverwrite(int code, const QString& type, const QString& oldName, const QString& newName);
+    /**
+     * @brief askOverwrite, emitted when the policy leaves the collision to the user. The handler does not wait: the answer arrives on overwriteAnswer.
+     */
+    void askOverwrite(int code, const QUuid& sender, const QString& type, const QString& oldName, const QString& newName);
     void informCollision(int code, const QString& oldName, const QString& newName);
+    void itemRenamed(int code, const QString& newName);
 
 private:
     /* -- socket attributes --*/
@@ -73,23 +105,71 @@ private:
     QMutex abort_m;
     bool abort = false;
     bool abortAlreadyCalled = false;
+    bool paused = false;
+    QTime pauseTime;
     qintptr socketDescriptor;
 
     /* -- download info -- */
     QSharedPointer<Download> download;
+    const CollisionPolicy* policy;
     bool metadataCompleted = false;
-    QString itemPath;
+    QString itemPath;       // where the item is written: in the staging directory until it is committed
+    QString finalPath;      // reserved in the StagingArea
+    QString stagingDir;
+    bool overwrite = false;
     quint16 firstMetadataSize = 0;
     qint16 subDirCounter = -1;
     qint16 filesCounter = -1;
     QDir dirToDownload;
-    QLockFile* fileLock = nullptr;
+    bool reserved = false;
+
+    /**
+     * @brief memoryId, the id of the download in the MemoryGovernor: the read buffer of the socket is limited to the share of the download
+     */
+    int memoryId = -1;
+    void boundReadBuffer();
+
+    /* -- multicast and swarm -- */
+    QIODevice* source = nullptr;    // where the item is read from: the socket, or the group offered by the sender
+    MulticastOffer multicastOffer;
+    quint32 swarm = 0;
+    quint16 swarmPort = 0;
+    bool awaitingManifest = false;
+    GroupReceiver* group = nullptr;
+
+    /**
+     * @brief joinGroup, once the answer is sent, the item is read from the multicast group offered by the sender (if any).
+     * For a swarm, the manifest of the chunks comes first on the socket (see getManifest).
+     * If the group cannot be joined, the item is asked on the socket.
+     */
+    void joinGroup();
+    void joinGroup(GroupReceiver* receiver);
+
+    /**
+     * @brief getManifest, reads the manifest of the swarm and starts pulling the chunks
+     * MANIFEST     QByteArray - see SwarmManifest
+     * @return false if the manifest is not complete yet
+     */
+    bool getManifest();
 
 
     /* -- current download attributes --*/
 
     bool infoFileCompleted = false;
     QFile* currentDownload = nullptr;
+    bool filePreallocated = false;
+
+    /**
+     * @brief writer, the bytes go from the buffer of the source to the blocks of the stream, and from them to the file
+     * (opened unbuffered) on the thread of the DiskWriter. The blocks are recycled: there is no new QByteArray for each read.
+     */
+    QSharedPointer<WriteStream> writer;
+
+    /**
+     * @brief flushWriter, waits for the DiskWriter to write everything queued
+     * @return false if a write failed (the download is then terminated)
+     */
+    bool flushWriter();
     quint16 pathSize = 0;
     QString relativePath;
     qint64 fileSize = 0;
@@ -118,18 +198,15 @@ private:
 
     /**
      * @brief getType, get the type or emit an error if the type is unknown
+     * @return the flags of the type byte: ITEM_COUNT_FLAG, MULTICAST_FLAG and SWARM_FLAG tell what follows the size in the metadata
      */
-    void getType();
+    quint8 getType();
 
     /**
      * @brief declined, sends the answer to the sender and asks the termination of the thread with the declined status
      */
     void declined();
 
-    /**
-     * @brief accepted, if the requests is accepted, it starts to elaborate the content of the first metadata. It check for collisions with existing file and if it is a directory, then the directory is created. If it is a file, it is is opened. At the end, the answer is send to the sender.
-     */
-    void accepted();
 
     /**
      * @brief sendAnswerToSender, sends true if the request is declined, false otherwise.
@@ -143,19 +220,58 @@ private:
     bool openFile();
 
     /**
-     * @brief computeDirDownloadPath, analyses the possibile collisions with already existing directory or with ongoing downloads name. If there is a collision the user can overwrite the file o save it with nameDir(i), where i is the first number that doesn't collide with other files. If other threads are currently downloading a directory with the same name, it is saved as 'dirName copy'. At the end, the itemPath points to the dir download location.
+     * @brief nextFreeName, the first name nameDir(i) or name(i).ext that doesn't collide with the items in the download directory
+     * @return an empty string if the name of the download doesn't collide
      */
-    void computeDirDownloadPath();
-    void computeFileDownloadPath();
-    bool concurrentCollision(const QString& fileExtension = nullptr);
-    QString getClearFileName(const QString& relativePath);
-    QString getFileExtension(const QString& relativePath);
+    QString nextFreeName();
 
     /**
-     * @brief newItemName, check if the newName found has to be used to ask the user if overwrite or not the file with the same name or save it with this new name
-     * @param newName the new name found
+     * @brief startDownload, if the item is a directory it is created, if it is a file it is opened. At the end, the answer is send to the sender.
      */
-    void newItemName(const QString& newName);
+    void startDownload();
+
+    /**
+     * @brief noSpace, the item doesn't fit in the free space of the volume (net of the space reserved by the other downloads): the sender receives a decline
+     */
+    void noSpace();
+
+    /**
+     * @brief preallocateFile, allocates the size of the current file so that a full volume is detected before writing
+     * @return false if the volume is full: the download is terminated with the NoSpace status
+     */
+    bool preallocateFile();
+
+    /**
+     * @brief skipped, the policy decided to skip the download: the sender receives a decline
+     */
+    void skipped();
+
+    /**
+     * @brief commitDownload, renames the completed item from the staging directory to its final path
+     * or, if it is taken in the meantime, to a new name. After COMMIT_ATTEMPTS failed renames the download is terminated with an error,
+     * and the completed item is left in the staging directory.
+     * @return false if the rename failed
+     */
+    bool commitDownload();
+
+    /**
+     * @brief renameFinalPath, releases the final path and reserves a new one, see reserveFreeName
+     */
+    void renameFinalPath();
+
+    /**
+     * @brief reserveFreeName, the first name nameDir(i) or name(i).ext that is neither in the download directory nor reserved by another download
+     * @return the name, already reserved in the StagingArea
+     */
+    QString reserveFreeName();
+
+    /**
+     * @brief concurrentCollision, reserves the final path in the StagingArea. If other threads are currently downloading an item with the same name, it is saved as 'name copy' and the collisions are checked again.
+     * @return true if there was a collision
+     */
+    bool concurrentCollision();
+    QString getClearFileName(const QString& relativePath);
+    QString getFileExtension(const QString& relativePath);
 
     /**
      * @brief downloadDir, execute the following operations, based on the number of available bytes.
@@ -200,7 +316,9 @@ private:
 
 
     /**
-     * @brief DownloadHandler::downloadFile, downloads the file opened in currentDownload, that points to itemPath + relativePath. If the download is effective, the temporary variable related to the download are cleared
+     * @brief DownloadHandler::downloadFile, downloads the file opened in currentDownload, that points to itemPath + relativePath, in blocks
+     * of WRITE_BLOCK_SIZE bytes written by the DiskWriter. Once the file is complete, its last block hands it over to the writer.
+     * If the download is effective, the temporary variable related to the download are cleared
      */
     void downloadFile();
 
@@ -217,10 +335,23 @@ private:
 
 private slots:
     /**
-     * @brief onReadyRead, slot called when the socket has some bytes available.
+     * @brief accepted, if the requests is accepted, it checks for collisions with existing items: the CollisionPolicy decides whether to overwrite, rename or skip, or the user is asked without blocking the thread.
+     * It is invoked in the transfer thread, after the handler left the NetworkIOPool.
+     */
+    void accepted();
+
+    /**
+     * @brief onReadyRead, slot called when the socket (or the group) has some bytes available.
      */
     void onReadyRead();
 
+    /**
+     * @brief requestUnicast, leaves the group (multicast or swarm) and asks the sender the rest of the item on the socket:
+     * OFFSET   qint64 - the bytes already read from the group
+     * At the end of a download from a group the receiver sends -1 instead, to confirm the completion.
+     */
+    void requestUnicast(const QString& reason);
+
 };
 
 #endif // DOWNLOADHANDLER_H
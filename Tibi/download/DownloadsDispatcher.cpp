@@ -7,58 +7,104 @@
 
 #include "DownloadsDispatcher.h"
 
+DownloadsDispatcher::DownloadsDispatcher() {
+    collisionPolicy.load();
+    acceptPolicy.load();
+    connect(this, &DownloadsDispatcher::downloadDirectoryMissing, this, &DownloadsDispatcher::showDownloadDirectoryMissing, Qt::QueuedConnection);
+}
+
 void DownloadsDispatcher::setUserInfo(UserHandler* user) {
     this->user = user;
+    // partial downloads of a previous run, in the current and in the past download directories
+    StagingArea::purge(user->getDownloadPath());
 }
 
+void DownloadsDispatcher::setIOPool(NetworkIOPool* ioPool) {
+    this->ioPool = ioPool;
+}
 
-void DownloadsDispatcher::createDownloadHandler(qintptr socketDescriptor) {
 
-    checkDownloadDirectoryExistance();
-    QThread *handlerThread = new QThread;
-    DownloadHandler* handler = new DownloadHandler(socketDescriptor, downloadsCode, user->getDownloadPath());
+void DownloadsDispatcher::createDownloadHandler(qintptr socketDescriptor) {
 
-    handler->moveToThread(handlerThread);
+    QMutexLocker ml(&downloads_m);
+    QString downloadPath = checkDownloadDirectoryExistance();
+    DownloadHandler* handler = new DownloadHandler(socketDescriptor, downloadsCode, downloadPath, &collisionPolicy);
+    handler->moveToThread(ioPool->next());
 
     downloads.insert(downloadsCode, handler);
     downloadsCode++;
+    ml.unlock();
 
     /* -- CONNECT -- */
+    // the dispatcher lives in the GUI thread: all the connections below are queued
 
     connect(this, &DownloadsDispatcher::cleanUp, handler, &DownloadHandler::appClose);
     connect(handler, &DownloadHandler::updateDownload, this,  &DownloadsDispatcher::updateDownload);
-    connect(handler, &DownloadHandler::askOverwrite, this, &DownloadsDispatcher::askOverwrite, Qt::BlockingQueuedConnection);
-    connect(handler, &DownloadHandler::informCollision, this, &DownloadsDispatcher::informCollision, Qt::BlockingQueuedConnection);
-    connect(handler, &DownloadHandler::terminationRequest, handlerThread, &QThread::quit);
+    connect(handler, &DownloadHandler::askOverwrite, this, &DownloadsDispatcher::askOverwrite);
+    connect(handler, &DownloadHandler::informCollision, this, &DownloadsDispatcher::informCollision);
+    connect(handler, &DownloadHandler::itemRenamed, this, &DownloadsDispatcher::updateDownloadName);
     connect(handler, &DownloadHandler::terminationRequest, handler, &DownloadHandler::deleteLater);
-    connect(handlerThread, &QThread::finished, handlerThread, &QObject::deleteLater);
-
+    connect(handler, &DownloadHandler::waitForConfirmation, this, &DownloadsDispatcher::computeAnswer);
+    // the handler is released in its own thread, before being deleted; the view is updated later
+    connect(handler, &DownloadHandler::downloadFinished, this, &DownloadsDispatcher::releaseHandler, Qt::DirectConnection);
+    connect(handler, &DownloadHandler::downloadFinished, this, &DownloadsDispatcher::downloadFinished);
 
     /* -- START --*/
-    connect(handlerThread, &QThread::started, handler, &DownloadHandler::initSocket);
+    QMetaObject::invokeMethod(handler, "initSocket", Qt::QueuedConnection);
 
+}
 
-    connect(handler, &DownloadHandler::waitForConfirmation, this, &DownloadsDispatcher::computeAnswer);
-    connect(handler, &DownloadHandler::downloadFinished, this, &DownloadsDispatcher::downloadFinished, Qt::BlockingQueuedConnection);
-    handlerThread->start();
+DownloadHandler* DownloadsDispatcher::handlerOf(int code) {
+    return downloads.value(code, nullptr);
+}
 
+void DownloadsDispatcher::releaseHandler(QSharedPointer<Download> download) {
+    QMutexLocker ml(&downloads_m);
+    downloads.remove(download->code);
 }
 
 
 void DownloadsDispatcher::abortFromView(int downloadCode) {
-    DownloadHandler* handler = downloads.value(downloadCode);
+    QMutexLocker ml(&downloads_m);
+    DownloadHandler* handler = handlerOf(downloadCode);
+    if( handler == nullptr ) return;
     handler->signalAbort();
     connect(this, &DownloadsDispatcher::abortDownload, handler, &DownloadHandler::abortConnection, Qt::QueuedConnection);
     emit abortDownload();
     connect(this, &DownloadsDispatcher::abortDownload, handler, &DownloadHandler::abortConnection);
 }
 
+void DownloadsDispatcher::pauseFromView(int downloadCode, bool pause) {
+    QMutexLocker ml(&downloads_m);
+    DownloadHandler* handler = handlerOf(downloadCode);
+    if( handler == nullptr ) return;
+    connect(this, &DownloadsDispatcher::pauseDownload, handler, &DownloadHandler::setPaused, Qt::QueuedConnection);
+    emit pauseDownload(pause);
+    disconnect(this, &DownloadsDispatcher::pauseDownload, handler, &DownloadHandler::setPaused);
+}
+
 void DownloadsDispatcher::computeAnswer(QSharedPointer<Download> download) {
     qDebug() << "DISPATCHER: download handler is waiting for an answer";
-    if( user->getConfirmation() ) {
+    AcceptVerdict verdict = acceptPolicy.evaluate(*download, user->getConfirmation());
+    if( !verdict.targetDir.isEmpty() ) targetDirs.insert(download->code, verdict.targetDir);
+
+    // early decline: there is no point in asking the user for an item that cannot fit where the policy would save it
+    QString targetDir = verdict.targetDir.isEmpty() ? download->downloadsPath : verdict.targetDir;
+    if( verdict.decision != AcceptRule::Decline && DiskQuota::Instance()->available(targetDir) < download->totalSize ) {
+        qDebug() << "DISPATCHER: no space for" << download->itemName << "in" << targetDir;
+        newAnswer(download, Status::NoSpace);
+        return;
+    }
+
+    if( verdict.decision == AcceptRule::Ask ) {
         manageConfrimationView(download);
     }
 
+    else if( verdict.decision == AcceptRule::Decline ) {
+        qDebug() << "DISPATCHER: download of" << download->itemName << "declined by the accept policy";
+        newAnswer(download, Status::Declined);
+    }
+
     else {
         newAnswer(download, Status::Accepted);
         emit addDownloadToTray();
@@ -87,19 +133,25 @@ void DownloadsDispatcher::manageConfrimationView(QSharedPointer<Download> downlo
     });
 
     timer->start(150*1000);
-    conf->showConfirmation(user->getLockFromId(download->idSender));
+    Tibier sender;
+    QString avatarPath;
+    if( user->lookupTibier(download->idSender, sender) && sender.avatarCode != 0 ) avatarPath = sender.avatarPath;
+    conf->showConfirmation(user->getLockFromId(download->idSender), avatarPath);
 
 }
 
 void DownloadsDispatcher::newAnswer(QSharedPointer<Download> download, Status status) {
     int code = download->code;
-    if(!downloads.contains(code)) return;
+    QString targetDir = targetDirs.take(code);
+    QMutexLocker ml(&downloads_m);
+    DownloadHandler* handler = handlerOf(code);
+    if( handler == nullptr ) return;
     if( status == Status::Accepted ) {
         emit addDownloadToView(false, code, download->usernameSender, download->itemName);
     }
-    connect(this, &DownloadsDispatcher::userAnswer, downloads.value(code), &DownloadHandler::userAnswer);
-    emit userAnswer(code, status);
-    disconnect(this, &DownloadsDispatcher::userAnswer, downloads.value(code), &DownloadHandler::userAnswer);
+    connect(this, &DownloadsDispatcher::userAnswer, handler, &DownloadHandler::userAnswer);
+    emit userAnswer(code, status, targetDir);
+    disconnect(this, &DownloadsDispatcher::userAnswer, handler, &DownloadHandler::userAnswer);
 }
 
 void DownloadsDispatcher::downloadFinished(QSharedPointer<Download> download) {
@@ -108,7 +160,13 @@ void DownloadsDispatcher::downloadFinished(QSharedPointer<Download> download) {
     if( download->status != Status::Declined) {
         emit notifyUserDownloadStatus(download);
     }
-    downloads.remove(download->code);
+    targetDirs.remove(download->code);
+    // a pending overwrite question has no handler to answer anymore
+    QPointer<QMessageBox> dialog = overwriteDialogs.take(download->code);
+    if( !dialog.isNull() ) {
+        dialog->disconnect(this);
+        dialog->close();
+    }
     //if the user close the app while the confirmation window is open
     if( conf!=nullptr && conf->code == download->code ) {
         timer->deleteLater();
@@ -117,34 +175,58 @@ void DownloadsDispatcher::downloadFinished(QSharedPointer<Download> download) {
     }
 }
 
-bool DownloadsDispatcher::askOverwrite(int code, const QString& type, const QString &oldName, const QString &newName) {
-    QMessageBox msgBox;
+void DownloadsDispatcher::askOverwrite(int code, const QUuid& sender, const QString& type, const QString &oldName, const QString &newName) {
+    QMessageBox* msgBox = new QMessageBox;
     QPixmap pixmapLogo(":/images/tibi-icon.png");
     pixmapLogo = pixmapLogo.scaled(50, 50, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-    msgBox.setIconPixmap(pixmapLogo);
-    msgBox.setText("A " + type +" called " + oldName + " already exists. \nDo you want to overwrite it?");
-    msgBox.setInformativeText("If you don't, It will be saved as " + newName);
-    msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
-    msgBox.setDefaultButton(QMessageBox::No);
-    int ret = msgBox.exec();
-    if( ret == QMessageBox::No ) {
-        emit updateDownloadName(code, newName);
-        return false;
-    }
-   return true;
+    msgBox->setIconPixmap(pixmapLogo);
+    msgBox->setText("A " + type +" called " + oldName + " already exists. \nDo you want to overwrite it?");
+    msgBox->setInformativeText("If you don't, It will be saved as " + newName);
+    msgBox->setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+    msgBox->setDefaultButton(QMessageBox::No);
+    msgBox->setCheckBox(new QCheckBox("Always do the same for this kind of " + type + " from this tibier"));
+    msgBox->setAttribute(Qt::WA_DeleteOnClose);
+
+    QString extension = CollisionPolicy::extensionOf(type == "directory" ? Types::Dir : Types::File, oldName);
+    connect(msgBox, &QMessageBox::finished, this, [=]() {
+        overwriteDialogs.remove(code);
+        bool overwrite = msgBox->standardButton(msgBox->clickedButton()) == QMessageBox::Yes;
+        if( msgBox->checkBox()->isChecked() ) {
+            collisionPolicy.remember(sender, extension, overwrite ? CollisionAction::Overwrite : CollisionAction::Rename);
+        }
+        if( !overwrite ) emit updateDownloadName(code, newName);
+
+        QMutexLocker ml(&downloads_m);
+        DownloadHandler* handler = handlerOf(code);
+        if( handler == nullptr ) return;
+        connect(this, &DownloadsDispatcher::overwriteAnswer, handler, &DownloadHandler::overwriteAnswer);
+        emit overwriteAnswer(code, overwrite, newName);
+        disconnect(this, &DownloadsDispatcher::overwriteAnswer, handler, &DownloadHandler::overwriteAnswer);
+    });
+
+    overwriteDialogs.insert(code, msgBox);
+    msgBox->show();
 }
 
 void DownloadsDispatcher::informCollision(int code, const QString& oldName, const QString& newName) {
-    QMessageBox::information(nullptr, "DOWNLOAD FILE PROBLEM", "You are currently downloading a file with the same name '" + oldName + "'. The file will be saved as " + newName);
+    QMessageBox* msgBox = new QMessageBox(QMessageBox::Information, "DOWNLOAD FILE PROBLEM", "You are currently downloading a file with the same name '" + oldName + "'. The file will be saved as " + newName);
+    msgBox->setAttribute(Qt::WA_DeleteOnClose);
+    msgBox->show();
     emit updateDownloadName(code, newName);
 }
-void DownloadsDispatcher::checkDownloadDirectoryExistance() {
-    if(QDir(user->getDownloadPath()).exists()) return;
 
-    user->setDownloadPath(QStandardPaths::writableLocation(QStandardPaths::DownloadLocation));
-    QMessageBox::critical(nullptr, "DOWNLOAD DIRECTORY", "The selected directory doesn't exist anymore. Downloads will be saved in " + user->getDownloadPath() + ". Change download directory in Preferences.");
+QString DownloadsDispatcher::checkDownloadDirectoryExistance() {
+    QString downloadPath = user->getDownloadPath();
+    if(QDir(downloadPath).exists()) return downloadPath;
 
+    downloadPath = QStandardPaths::writableLocation(QStandardPaths::DownloadLocation);
+    user->setDownloadPath(downloadPath);
+    emit downloadDirectoryMissing(downloadPath);
+    return downloadPath;
+}
 
+void DownloadsDispatcher::showDownloadDirectoryMissing(const QString& newPath) {
+    QMessageBox::critical(nullptr, "DOWNLOAD DIRECTORY", "The selected directory doesn't exist anymore. Downloads will be saved in " + newPath + ". Change download directory in Preferences.");
 }
 
 void DownloadsDispatcher::updateDownload(QSharedPointer<Download> download) {
@@ -168,10 +250,29 @@ void DownloadsDispatcher::updateDownload(QSharedPointer<Download> download) {
         info = "FAILED";
     }
 
+    else if( download->status == Status::Skipped) {
+        info = "SKIPPED";
+    }
+
+    else if( download->status == Status::NoSpace) {
+        info = "NO SPACE";
+    }
+
+    else if( download->status == Status::Paused ) {
+        info = "PAUSED";
+        qint64 byteReceived = download->totalSize - download->totalBytesLeft;
+        perc = download->totalSize == 0 ? 0 : static_cast<int>(byteReceived*100/download->totalSize);
+    }
+
     else if( download->status == Status::Accepted ) {
         qint64 byteReceived = download->totalSize - download->totalBytesLeft;
+        if( byteReceived == 0 ) {
+            // accepted, or resumed, before the first byte: no time left yet, but the row must leave the paused state
+            emit updateRowDownload(false, download->code, 0, t, info);
+            return;
+        }
         perc =  static_cast<int>(byteReceived*100/download->totalSize);
-        qint64 elapsedTime = download->timeStart.elapsed();
+        qint64 elapsedTime = download->timeStart.elapsed() - download->pausedMsecs;
         qint64 downloadTimeMsecs = (download->totalBytesLeft * elapsedTime) / byteReceived;
         t = t.addMSecs(downloadTimeMsecs);
     }
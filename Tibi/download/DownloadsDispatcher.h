@@ -10,7 +10,14 @@
 
 #include <QNetworkInterface>
 #include <QTimer>
+#include <QCheckBox>
+#include <QPointer>
+#include <QMutex>
+#include <QMutexLocker>
 #include "download/DownloadHandler.h"
+#include "network/NetworkIOPool.h"
+#include "download/CollisionPolicy.h"
+#include "download/AcceptPolicy.h"
 #include "view/ViewConfirmation.h"
 #include "user/UserHandler.h"
 
@@ -18,17 +25,25 @@ class DownloadsDispatcher : public QObject
 {
     Q_OBJECT
 public:
-    DownloadsDispatcher() {}
+    DownloadsDispatcher();
     void setUserInfo(UserHandler* user);
+    void setIOPool(NetworkIOPool* ioPool);
     ~DownloadsDispatcher();
 
 
 public slots:
+    /**
+     * @brief createDownloadHandler, called in the thread of the receiver shard that accepted the connection (direct connection).
+     * The handler is moved to a thread of the NetworkIOPool, where the TLS handshake and the metadata parsing happen:
+     * the GUI thread is only reached by the confirmation request. It is thread safe.
+     * @param socketDescriptor
+     */
     void createDownloadHandler(qintptr socketDescriptor);
     void updateDownload(QSharedPointer<Download> download);
 
     /**
-     * @brief computeAnswer has to dispatch the confirmation request of handlers. If the confirmation mode is disable, it will immediatly return that the answer is accepted, otherwise it opes the confirmation view and ask the user what to do.
+     * @brief computeAnswer has to dispatch the confirmation request of handlers. The AcceptPolicy decides whether the request is accepted or declined
+     * immediatly, or if the confirmation view has to ask the user what to do (by default, according to the confirmation mode). The policy can also choose the target directory.
      * @param download, the request object
      */
     void computeAnswer(QSharedPointer<Download> download);
@@ -47,14 +62,16 @@ public slots:
     void downloadFinished(QSharedPointer<Download> download);
 
     /**
-     * @brief askOverwrite, ask the user if the file/dir has to be overwritten or wants to keep both. The ViewUD is updated with the new name.
+     * @brief askOverwrite, ask the user if the file/dir has to be overwritten or wants to keep both. The dialog is not modal:
+     * the answer is sent to the handler with overwriteAnswer when the user closes it, and the ViewUD is updated with the new name.
+     * If the user asks to remember the answer, a CollisionPolicy rule for the sender and the extension is added.
      * @param code of the download
+     * @param sender, the id of the tibier sending the download
      * @param type dir/file
      * @param oldName
      * @param newName
-     * @return true if overwrite, false otherwise
      */
-    bool askOverwrite(int code, const QString& type, const QString &oldName, const QString &newName);
+    void askOverwrite(int code, const QUuid& sender, const QString& type, const QString &oldName, const QString &newName);
 
     /**
      * @brief informCollision inform the user that the download collides with other ongoing ones and that it will be saved with newName. The ViewUD is updated with the new name.
@@ -70,14 +87,27 @@ public slots:
      */
     void abortFromView(int downloadsCode);
 
+    /**
+     * @brief pauseFromView, the view requested to pause or resume a download. The request is forwarded to the handler thread through a queued connection.
+     * @param downloadCode
+     * @param pause
+     */
+    void pauseFromView(int downloadCode, bool pause);
+
 signals:
 
     /**
      * @brief userAnswer signal emitted to share the user answer with the handler
      * @param code, the hendler unique code
      * @param status, the answer
+     * @param targetDir, the directory chosen by the AcceptPolicy, empty for the download directory
      */
-    void userAnswer(int code, Status status);
+    void userAnswer(int code, Status status, const QString& targetDir);
+
+    /**
+     * @brief overwriteAnswer signal emitted to share the answer to askOverwrite with the handler
+     */
+    void overwriteAnswer(int code, bool overwrite, const QString& newName);
 
     void notifyUserDownloadStatus(QSharedPointer<Download> download);
 
@@ -99,11 +129,27 @@ signals:
      */
     void abortDownload();
 
+    /**
+     * @brief pauseDownload, as abortDownload, emitted when there is just one handler connected to it.
+     */
+    void pauseDownload(bool pause);
+
+    /**
+     * @brief downloadDirectoryMissing, emitted from the receiver thread when the download directory has been replaced by the default one
+     */
+    void downloadDirectoryMissing(const QString& newPath);
+
 
 private:
     UserHandler* user = nullptr;
+    NetworkIOPool* ioPool = nullptr;
+    QMutex downloads_m;
     QMap<int, DownloadHandler*> downloads;
     int downloadsCode = 0;
+    CollisionPolicy collisionPolicy;
+    AcceptPolicy acceptPolicy;
+    QMap<int, QString> targetDirs;
+    QMap<int, QPointer<QMessageBox>> overwriteDialogs;
     ViewConfirmation* conf = nullptr;
     QTimer* timer;
 
@@ -115,8 +161,24 @@ private:
 
     /**
      * @brief checkDownloadDirectoryExistance, before creating a new download handler, the existance of the download directory is checked. If it is not valid, it is substitute with the default one.
+     * It runs in the receiver thread: the user is informed through downloadDirectoryMissing. Called with downloads_m locked.
+     * @return the download directory to use
+     */
+    QString checkDownloadDirectoryExistance();
+
+    /**
+     * @brief handlerOf, the handler of the download code, nullptr if it is already finished. Called with downloads_m locked.
      */
-    void checkDownloadDirectoryExistance();
+    DownloadHandler* handlerOf(int code);
+
+    /**
+     * @brief releaseHandler, removes the handler from the active ones. It is called in the thread of the handler (direct connection),
+     * before the handler is deleted: the GUI thread uses a handler only while holding downloads_m.
+     */
+    void releaseHandler(QSharedPointer<Download> download);
+
+private slots:
+    void showDownloadDirectoryMissing(const QString& newPath);
 
 };
 
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef GROUPRECEIVER_H
+#define GROUPRECEIVER_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <cstring>
+
+/**
+ * @brief The GroupReceiver class, a sequential read-only device giving back the bytes that would have arrived on the TLS socket,
+ * when the item is received together with other tibiers (MulticastReceiver, SwarmReceiver).
+ * The subclasses append the bytes in order; when the group is not worth it anymore they emit fallback, and the
+ * DownloadHandler asks the rest of the item on the socket, starting from consumed().
+ */
+class GroupReceiver : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit GroupReceiver(QObject* parent = nullptr) : QIODevice(parent) {}
+
+    /**
+     * @brief join, opens the device and joins the group
+     * @return false if the group cannot be joined
+     */
+    virtual bool join() = 0;
+
+    /**
+     * @brief setPaused, the download is paused or resumed: while paused the group stops taking data for the reader
+     */
+    virtual void setPaused(bool paused) { Q_UNUSED(paused); }
+
+    /**
+     * @brief consumed, the bytes read from the device so far
+     */
+    qint64 consumed() const { return readBytes; }
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override { return ready.size() - readPos + QIODevice::bytesAvailable(); }
+
+signals:
+    void fallback(const QString& reason);
+
+protected:
+    /**
+     * @brief append, the next bytes of the stream, in order
+     */
+    void append(const QByteArray& data) { ready.append(data); }
+
+    /**
+     * @brief unread, the bytes appended and not read yet
+     */
+    qint64 unread() const { return ready.size() - readPos; }
+
+    /**
+     * @brief drained, called after each read: the subclass can append more
+     */
+    virtual void drained() {}
+
+    qint64 readData(char* data, qint64 maxSize) override {
+        qint64 size = qMin<qint64>(maxSize, ready.size() - readPos);
+        if( size <= 0 ) return 0;
+        memcpy(data, ready.constData() + readPos, static_cast<size_t>(size));
+        readPos += static_cast<int>(size);
+        readBytes += size;
+
+        // the bytes read are dropped once they are the larger part of the buffer
+        if( readPos * 2 > ready.size() ) {
+            ready.remove(0, readPos);
+            readPos = 0;
+        }
+        drained();
+        return size;
+    }
+
+    qint64 writeData(const char* data, qint64 maxSize) override {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+
+private:
+    QByteArray ready;
+    int readPos = 0;
+    qint64 readBytes = 0;
+
+};
+
+#endif // GROUPRECEIVER_H
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "MulticastReceiver.h"
+
+MulticastReceiver::MulticastReceiver(const MulticastOffer& offer, const QHostAddress& sender, QObject* parent) :
+    GroupReceiver(parent),
+    offer(offer)
+{
+    // the TLS server may see an IPv4 peer as IPv4-mapped IPv6, while the group is IPv4 only
+    bool isIPv4 = false;
+    quint32 ipv4 = sender.toIPv4Address(&isIPv4);
+    senderAddress = isIPv4 ? QHostAddress(ipv4) : sender;
+}
+
+bool MulticastReceiver::join() {
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    socket = new QUdpSocket(this);
+    if( !socket->bind(QHostAddress(QHostAddress::AnyIPv4), offer.port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint) ) {
+        qDebug() << "MULTICAST: impossible to bind" << offer.port << ":" << socket->errorString();
+        return false;
+    }
+    if( !socket->joinMulticastGroup(offer.group) ) {
+        qDebug() << "MULTICAST: impossible to join" << offer.group.toString() << ":" << socket->errorString();
+        return false;
+    }
+    connect(socket, &QUdpSocket::readyRead, this, &MulticastReceiver::readDatagrams);
+
+    nackTimer.setInterval(MCAST_NACK_TIME);
+    connect(&nackTimer, &QTimer::timeout, this, &MulticastReceiver::sendNacks);
+    nackTimer.start();
+    lastProgress.start();
+    qDebug() << "MULTICAST: joined session" << offer.session << "on" << offer.group.toString();
+    return true;
+}
+
+void MulticastReceiver::readDatagrams() {
+    while( socket->hasPendingDatagrams() ) {
+        QNetworkDatagram datagram = socket->receiveDatagram();
+        if( datagram.senderAddress() != senderAddress ) continue;
+        MulticastPacket packet;
+        if( !MulticastPacket::decode(datagram.data(), offer.key, packet) || packet.session != offer.session ) continue;
+        // the NACKs go back to the socket sending the packets
+        if( senderPort == 0 ) senderPort = static_cast<quint16>(datagram.senderPort());
+        receive(packet);
+        if( failed ) return;
+    }
+    deliver();
+}
+
+void MulticastReceiver::receive(const MulticastPacket& packet) {
+    switch( packet.kind ) {
+    case MulticastPacket::Data:
+        if( packet.seq < nextSeq || packets.contains(packet.seq) ) return;
+        packets.insert(packet.seq, packet.payload);
+        buffered += packet.payload.size();
+        highestSeq = qMax<qint64>(highestSeq, packet.seq);
+        recover(packet.seq / MCAST_FEC_BLOCK);
+        break;
+    case MulticastPacket::Parity:
+        if( (packet.seq + 1) * MCAST_FEC_BLOCK <= nextSeq || packet.payload.isEmpty() ) return;
+        parities.insert(packet.seq, qMakePair(packet.length, packet.payload));
+        recover(packet.seq);
+        break;
+    case MulticastPacket::End:
+        totalPackets = packet.seq;
+        break;
+    case MulticastPacket::Gone:
+        if( packet.seq >= nextSeq && !packets.contains(packet.seq) ) giveUp("the sender cannot send the missing data again");
+        break;
+    default:
+        break;
+    }
+}
+
+int MulticastReceiver::blockSize(quint32 block) const {
+    if( parities.contains(block) ) return static_cast<quint8>(parities.value(block).second.at(0));
+    if( totalPackets >= 0 ) return static_cast<int>(qBound<qint64>(0, totalPackets - block * MCAST_FEC_BLOCK, MCAST_FEC_BLOCK));
+    return MCAST_FEC_BLOCK;
+}
+
+void MulticastReceiver::recover(quint32 block) {
+    if( !parities.contains(block) ) return;
+    quint32 first = block * MCAST_FEC_BLOCK;
+    int count = blockSize(block);
+
+    qint64 missing = -1;
+    for( int i = 0; i < count; i++ ) {
+        if( packets.contains(first + i) ) continue;
+        if( missing >= 0 ) return; // more than one: only a NACK can help
+        missing = first + i;
+    }
+    if( missing < 0 ) return;
+
+    QPair<quint16, QByteArray> parity = parities.value(block);
+    QByteArray data = parity.second.mid(1);
+    quint16 length = parity.first;
+    for( int i = 0; i < count; i++ ) {
+        if( first + i == missing ) continue;
+        const QByteArray& other = packets[first + i];
+        MulticastPacket::xorInto(data, other);
+        length ^= static_cast<quint16>(other.size());
+    }
+    data.truncate(length);
+    packets.insert(static_cast<quint32>(missing), data);
+    buffered += data.size();
+}
+
+void MulticastReceiver::deliver() {
+    bool delivered = false;
+
+    // a block is given to the reader as a whole, so that its packets are still there to rebuild a missing one
+    while( totalPackets < 0 || nextSeq < totalPackets ) {
+        quint32 block = nextSeq / MCAST_FEC_BLOCK;
+        int count = blockSize(block);
+        if( count == 0 ) break;
+        bool complete = true;
+        for( int i = 0; i < count && complete; i++ ) {
+            complete = packets.contains(nextSeq + i);
+        }
+        if( !complete ) break;
+
+        for( int i = 0; i < count; i++ ) {
+            QByteArray data = packets.take(nextSeq + i);
+            buffered -= data.size();
+            append(data);
+            nacked.remove(nextSeq + i);
+        }
+        parities.remove(block);
+        nextSeq += count;
+        delivered = true;
+    }
+
+    if( delivered ) {
+        lastProgress.restart();
+        emit readyRead();
+    }
+
+    if( unread() + buffered > MCAST_MAX_BUFFER ) giveUp("too many bytes waiting to be written");
+}
+
+void MulticastReceiver::sendNacks() {
+    if( failed ) return;
+    if( totalPackets >= 0 && nextSeq >= totalPackets ) {
+        nackTimer.stop();
+        return;
+    }
+    if( lastProgress.elapsed() > MCAST_STALL_TIME ) {
+        giveUp("no data from the group");
+        return;
+    }
+    if( senderPort == 0 ) return;
+
+    qint64 end = totalPackets >= 0 ? totalPackets : highestSeq + 1;
+    QVector<quint32> missing;
+    for( qint64 seq = nextSeq; seq < end && missing.size() < MCAST_MAX_NACK; seq++ ) {
+        if( packets.contains(static_cast<quint32>(seq)) ) continue;
+        int& times = nacked[static_cast<quint32>(seq)];
+        if( times == 0 ) lost++;
+        if( ++times > MCAST_MAX_RETRIES ) {
+            giveUp("a packet has been lost too many times");
+            return;
+        }
+        missing.push_back(static_cast<quint32>(seq));
+    }
+    if( missing.isEmpty() ) return;
+
+    if( highestSeq > 100 && lost * 100 > (highestSeq + 1) * MCAST_MAX_LOSS ) {
+        giveUp("too many packets lost");
+        return;
+    }
+    socket->writeDatagram(MulticastPacket::nack(offer.session, missing).encode(offer.key), senderAddress, senderPort);
+}
+
+void MulticastReceiver::setPaused(bool paused) {
+    // on the socket TCP slows down the sender for this download only
+    if( paused ) giveUp("the download is paused");
+}
+
+void MulticastReceiver::giveUp(const QString& reason) {
+    if( failed ) return;
+    failed = true;
+    nackTimer.stop();
+    if( socket != nullptr ) socket->close();
+    qDebug() << "MULTICAST: leaving session" << offer.session << "-" << reason;
+    emit fallback(reason);
+}
+
+void MulticastReceiver::close() {
+    nackTimer.stop();
+    if( socket != nullptr ) socket->close();
+    QIODevice::close();
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef MULTICASTRECEIVER_H
+#define MULTICASTRECEIVER_H
+
+#include <QUdpSocket>
+#include <QNetworkDatagram>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QHash>
+#include <QPair>
+#include <QDebug>
+#include "network/MulticastPacket.h"
+#include "download/GroupReceiver.h"
+
+#define MCAST_NACK_TIME 200
+#define MCAST_MAX_RETRIES 5
+#define MCAST_MAX_LOSS 20
+#define MCAST_STALL_TIME 20*1000
+#define MCAST_MAX_BUFFER 32*1024*1024
+
+/**
+ * @brief The MulticastReceiver class joins the multicast group offered by the sender and gives back the bytes of the item. A block is given to the reader once all its packets
+ * are there: a single missing packet is rebuilt with the parity, the others are asked with a NACK every MCAST_NACK_TIME ms.
+ * It emits fallback when the multicast is not worth it anymore: more than MCAST_MAX_LOSS% of the packets lost, a packet
+ * asked MCAST_MAX_RETRIES times or gone, no progress for MCAST_STALL_TIME ms, or more than MCAST_MAX_BUFFER bytes waiting
+ * (the download is paused). A paused download leaves the group at once: the group doesn't wait for one member, and the
+ * packets not read would be lost anyway. The reader then asks the rest of the item on the TLS socket, starting from consumed().
+ * Only the packets coming from the address of the TLS peer and tagged with the key of the offer are read, and the NACKs only go back
+ * to that address: the key keeps out the hosts that are not members, the address the other members, who know the key as well.
+ */
+class MulticastReceiver : public GroupReceiver
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param sender, the address of the TLS peer offering the group
+     */
+    MulticastReceiver(const MulticastOffer& offer, const QHostAddress& sender, QObject* parent = nullptr);
+
+    bool join() override;
+    void setPaused(bool paused) override;
+    void close() override;
+
+private:
+    MulticastOffer offer;
+    QUdpSocket* socket = nullptr;
+    QTimer nackTimer;
+    QElapsedTimer lastProgress;
+    bool failed = false;
+
+    QHostAddress senderAddress;
+    quint16 senderPort = 0;     // the port of the socket sending the packets, known with the first one
+
+    quint32 nextSeq = 0;        // first packet not given to the reader yet
+    qint64 highestSeq = -1;
+    qint64 totalPackets = -1;   // known once the End arrives
+    QMap<quint32, QByteArray> packets;
+    QHash<quint32, QPair<quint16, QByteArray>> parities;
+    QHash<quint32, int> nacked;
+    qint64 lost = 0;
+    qint64 buffered = 0;
+
+    void readDatagrams();
+    void receive(const MulticastPacket& packet);
+    int blockSize(quint32 block) const;
+    void recover(quint32 block);
+    void deliver();
+    void sendNacks();
+    void giveUp(const QString& reason);
+
+};
+
+#endif // MULTICASTRECEIVER_H
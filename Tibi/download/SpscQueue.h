@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <QAtomicInteger>
+
+/**
+ * @brief The SpscQueue class, a lock-free ring of N items with a single producer thread and a single consumer thread.
+ * The producer only moves tail and the consumer only moves head: an item is published by the release store of tail
+ * and given back by the release store of head.
+ */
+template <typename T, int N>
+class SpscQueue
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "the size of a SpscQueue must be a power of two");
+
+public:
+    SpscQueue() {}
+
+    /**
+     * @brief push, producer side
+     * @return false if the queue is full
+     */
+    bool push(const T& item) {
+        quint32 t = tail.load();
+        if( t - head.loadAcquire() == static_cast<quint32>(N) ) return false;
+        items[t & (N - 1)] = item;
+        tail.storeRelease(t + 1);
+        return true;
+    }
+
+    /**
+     * @brief pop, consumer side
+     * @return false if the queue is empty
+     */
+    bool pop(T& item) {
+        quint32 h = head.load();
+        if( h == tail.loadAcquire() ) return false;
+        item = items[h & (N - 1)];
+        head.storeRelease(h + 1);
+        return true;
+    }
+
+    bool isEmpty() const { return head.loadAcquire() == tail.loadAcquire(); }
+
+private:
+    T items[N];
+    QAtomicInteger<quint32> head = 0;
+    QAtomicInteger<quint32> tail = 0;
+
+};
+
+#endif // SPSCQUEUE_H
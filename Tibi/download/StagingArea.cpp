@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "StagingArea.h"
+
+QMutex StagingArea::names_m;
+QSet<QString> StagingArea::names;
+QMutex StagingArea::roots_m;
+QSet<QString> StagingArea::roots;
+
+QString StagingArea::create(const QString& downloadsPath) {
+    QString stagingDir = downloadsPath + "/" + STAGING_DIR + "/" + QUuid::createUuid().toString(QUuid::WithoutBraces);
+    if( !QDir().mkpath(stagingDir) ) return "";
+    recordRoot(downloadsPath);
+    return stagingDir;
+}
+
+void StagingArea::recordRoot(const QString& downloadsPath) {
+    QString root = QDir(downloadsPath).absolutePath();
+    QMutexLocker ml(&roots_m);
+    if( roots.contains(root) ) return;
+    roots.insert(root);
+
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    QStringList recorded = settings.value("stagingDirs").toStringList();
+    if( recorded.contains(root) ) return;
+    recorded.append(root);
+    settings.setValue("stagingDirs", recorded);
+}
+
+bool StagingArea::reserveName(const QString& finalPath) {
+    QMutexLocker ml(&names_m);
+    if( names.contains(finalPath) ) return false;
+    names.insert(finalPath);
+    return true;
+}
+
+void StagingArea::releaseName(const QString& finalPath) {
+    QMutexLocker ml(&names_m);
+    names.remove(finalPath);
+}
+
+bool StagingArea::commit(const QString& stagingDir, const QString& stagedItem, const QString& finalPath, bool overwrite) {
+    QString replaced = stagingDir + "/" + REPLACED_ITEM;
+    bool exists = QFileInfo::exists(finalPath);
+    if( exists && !overwrite ) return false;
+
+    // rename(2) cannot replace a non empty directory: the old item is moved aside and dropped with the staging directory
+    if( exists && !QDir().rename(finalPath, replaced) ) {
+        qDebug() << "STAGING: impossible to move aside" << finalPath;
+        return false;
+    }
+
+    if( !QDir().rename(stagedItem, finalPath) ) {
+        qDebug() << "STAGING: impossible to rename" << stagedItem << "to" << finalPath;
+        if( exists ) QDir().rename(replaced, finalPath);
+        return false;
+    }
+
+    if( exists ) drop(stagingDir);
+    else QDir().rmdir(stagingDir);
+    return true;
+}
+
+void StagingArea::drop(const QString& stagingDir) {
+    if( stagingDir.isEmpty() ) return;
+    // <download dir>/.tibi-staging/<uuid>: the trash lives next to the staging directory, on the same file system
+    QString downloadsPath = QFileInfo(QFileInfo(stagingDir).absolutePath()).absolutePath();
+    TrashService::Instance()->trash(stagingDir, downloadsPath);
+}
+
+void StagingArea::purge(const QString& downloadsPath) {
+    QMutexLocker ml(&roots_m);
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    QStringList recorded = settings.value("stagingDirs").toStringList();
+    QString current = QDir(downloadsPath).absolutePath();
+    if( !recorded.contains(current) ) recorded.append(current);
+
+    // a download directory is forgotten once its staging directory is gone
+    QStringList kept;
+    for( auto root : recorded ) {
+        if( purgeRoot(root) ) kept.append(root);
+    }
+    settings.setValue("stagingDirs", kept);
+    roots = kept.toSet();
+}
+
+bool StagingArea::purgeRoot(const QString& downloadsPath) {
+    QDir staging(downloadsPath + "/" + STAGING_DIR);
+    if( !staging.exists() ) return false;
+    for( auto leftover : staging.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden) ) {
+        qDebug() << "STAGING: dropping the leftover" << leftover << "in" << downloadsPath;
+        drop(staging.filePath(leftover));
+    }
+    return !QDir().rmdir(staging.absolutePath());
+}
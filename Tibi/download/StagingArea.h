@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef STAGINGAREA_H
+#define STAGINGAREA_H
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QUuid>
+#include <QSet>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QDebug>
+#include "download/TrashService.h"
+
+#define STAGING_DIR ".tibi-staging"
+#define REPLACED_ITEM ".replaced"
+
+/**
+ * @brief The StagingArea class, the downloads are written in a hidden directory per transfer, <download dir>/.tibi-staging/<uuid>,
+ * on the same file system of their final path, and renamed into place only when completed: a partial item is never visible
+ * in the download directory, and dropping it is the rename of a single directory to the trash.
+ * The final paths of the ongoing downloads are kept in a set, so that two downloads cannot pick the same name.
+ * Every download directory that ever held a staging directory is recorded in the "stagingDirs" setting: the download directory
+ * of the preferences or of an accept rule can change between two runs, and the leftovers of all of them are purged at startup.
+ */
+class StagingArea
+{
+public:
+    /**
+     * @brief create, creates the staging directory of a new transfer
+     * @return its path, empty if it could not be created
+     */
+    static QString create(const QString& downloadsPath);
+
+    /**
+     * @brief reserveName, reserves the final path for a download
+     * @return false if another ongoing download already reserved it
+     */
+    static bool reserveName(const QString& finalPath);
+    static void releaseName(const QString& finalPath);
+
+    /**
+     * @brief commit, renames the staged item to its final path. If overwrite is set, the existing item is first moved
+     * to the staging directory and dropped with it.
+     * @return false if the rename failed
+     */
+    static bool commit(const QString& stagingDir, const QString& stagedItem, const QString& finalPath, bool overwrite);
+
+    /**
+     * @brief drop, moves a staging directory to the trash, that is emptied in the background by the TrashService
+     */
+    static void drop(const QString& stagingDir);
+
+    /**
+     * @brief purge, drops the staging directories left by a previous run in downloadsPath and in every recorded download directory
+     */
+    static void purge(const QString& downloadsPath);
+
+private:
+    static QMutex names_m;
+    static QSet<QString> names;
+    static QMutex roots_m;
+    static QSet<QString> roots;
+
+    static void recordRoot(const QString& downloadsPath);
+    static bool purgeRoot(const QString& downloadsPath);
+
+};
+
+#endif // STAGINGAREA_H
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "SwarmReceiver.h"
+
+SwarmReceiver::SwarmReceiver(QSharedPointer<SwarmManifest> manifest, quint32 swarm, const QHostAddress& origin, quint16 originPort, QObject* parent) :
+    GroupReceiver(parent),
+    manifest(manifest),
+    swarm(swarm),
+    origin(origin.toString() + ":" + QString::number(originPort)),
+    originAddress(origin),
+    originPort(originPort),
+    random(std::random_device()())
+{
+}
+
+SwarmReceiver::~SwarmReceiver() {
+    // the SwarmServer must not ask the chunks anymore before they are gone
+    SwarmServer::Instance()->removePeer(swarm);
+}
+
+bool SwarmReceiver::join() {
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    SwarmServer::Instance()->addPeer(swarm, this);
+
+    tracker = new QTcpSocket(this);
+    connect(tracker, &QTcpSocket::readyRead, this, &SwarmReceiver::readAnnounce);
+
+    tickTimer.setInterval(SWARM_TICK);
+    connect(&tickTimer, &QTimer::timeout, this, &SwarmReceiver::tick);
+    tickTimer.start();
+    announceTimer.setInterval(SWARM_ANNOUNCE_TIME);
+    connect(&announceTimer, &QTimer::timeout, this, &SwarmReceiver::announce);
+    announceTimer.start();
+    lastProgress.start();
+
+    qDebug() << "SWARM: joined swarm" << swarm << "of" << manifest->chunksCount() << "chunks";
+    announce();
+    schedule();
+    return true;
+}
+
+void SwarmReceiver::setPaused(bool paused) {
+    if( stopped || this->paused == paused ) return;
+    this->paused = paused;
+    if( paused ) {
+        tickTimer.stop();
+        dropLinks();
+        return;
+    }
+    lastProgress.restart();
+    if( nextChunk < manifest->chunksCount() ) tickTimer.start();
+    deliver();
+    schedule();
+}
+
+bool SwarmReceiver::chunk(quint32 index, QByteArray& data) {
+    QMutexLocker ml(&cache_m);
+    if( !cache.contains(index) ) return false;
+    data = cache.value(index);
+    return true;
+}
+
+void SwarmReceiver::drained() {
+    // the reader is inside read: the next chunks are given after it returns
+    if( deliverQueued || stopped ) return;
+    deliverQueued = true;
+    QMetaObject::invokeMethod(this, "deliver", Qt::QueuedConnection);
+}
+
+void SwarmReceiver::deliver() {
+    deliverQueued = false;
+    if( stopped ) return;
+    bool delivered = false;
+
+    {
+        QMutexLocker ml(&cache_m);
+        while( unread() < SWARM_MAX_UNREAD && cache.contains(nextChunk) ) {
+            append(cache.value(nextChunk));
+            nextChunk++;
+            delivered = true;
+        }
+        while( !cache.isEmpty() && cache.firstKey() + SWARM_WINDOW < nextChunk ) {
+            cache.erase(cache.begin());
+        }
+    }
+
+    if( delivered ) {
+        lastProgress.restart();
+        emit readyRead();
+    }
+}
+
+void SwarmReceiver::tick() {
+    if( stopped ) return;
+
+    for( QTcpSocket* socket : links.keys() ) {
+        const SwarmLink& link = links.value(socket);
+        if( link.chunk >= 0 && link.sent.elapsed() > SWARM_REQUEST_TIMEOUT ) {
+            qDebug() << "SWARM: no answer from" << link.peer << "for chunk" << link.chunk;
+            dropLink(socket);
+        }
+    }
+
+    deliver();
+    if( nextChunk >= manifest->chunksCount() ) {
+        // everything has been given to the reader: the window is still served until the download is closed
+        dropLinks();
+        tickTimer.stop();
+        return;
+    }
+
+    // a paused reader is not a stall
+    if( unread() >= SWARM_MAX_UNREAD ) lastProgress.restart();
+    if( lastProgress.elapsed() > SWARM_STALL_TIME ) {
+        giveUp("no chunks from the swarm");
+        return;
+    }
+    schedule();
+}
+
+void SwarmReceiver::announce() {
+    if( stopped ) return;
+    if( tracker->state() == QAbstractSocket::UnconnectedState ) {
+        trackerBuffer.clear();
+        tracker->connectToHost(originAddress, originPort);
+    }
+
+    quint32 base = nextChunk > SWARM_WINDOW ? nextChunk - SWARM_WINDOW : 0;
+    quint64 bitmap = 0;
+    {
+        QMutexLocker ml(&cache_m);
+        for( auto cached = cache.lowerBound(base); cached != cache.end() && cached.key() - base < 64; ++cached ) {
+            bitmap |= Q_UINT64_C(1) << (cached.key() - base);
+        }
+    }
+
+    QByteArray request;
+    QDataStream out(&request, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_5);
+    out << static_cast<quint32>(SWARM_MAGIC) << static_cast<quint8>(SwarmServer::Announce) << swarm;
+    out << SwarmServer::Instance()->serverPort() << base << bitmap;
+    tracker->write(SwarmServer::frame(request));
+}
+
+void SwarmReceiver::readAnnounce() {
+    trackerBuffer.append(tracker->readAll());
+
+    QByteArray response;
+    bool invalid = false;
+    while( SwarmServer::takeFrame(trackerBuffer, response, invalid) ) {
+        QDataStream in(response);
+        in.setVersion(QDataStream::Qt_5_5);
+        quint16 count = 0;
+        in >> count;
+
+        QHash<QString, SwarmPeerInfo> known;
+        for( int i = 0; i < count && in.status() == QDataStream::Ok; i++ ) {
+            QString address;
+            SwarmPeerInfo peer;
+            in >> address >> peer.port >> peer.base >> peer.bitmap;
+            peer.address = QHostAddress(address);
+            QString key = address + ":" + QString::number(peer.port);
+            if( !peer.address.isNull() && !banned.contains(key) ) known.insert(key, peer);
+        }
+        if( in.status() == QDataStream::Ok ) peers = known;
+    }
+    if( invalid ) tracker->abort();
+}
+
+void SwarmReceiver::schedule() {
+    if( paused ) return;
+    quint32 end = qMin<quint32>(nextChunk + SWARM_AHEAD, manifest->chunksCount());
+    QVector<quint32> missing;
+    {
+        QMutexLocker ml(&cache_m);
+        for( quint32 i = nextChunk; i < end; i++ ) {
+            if( !cache.contains(i) && !requested.contains(i) ) missing.push_back(i);
+        }
+    }
+    if( missing.isEmpty() ) return;
+
+    // rarest first: the chunks few peers hold are spread first; the next ones for the reader break the ties
+    QHash<quint32, int> holders;
+    for( quint32 i : missing ) {
+        int count = 0;
+        for( const SwarmPeerInfo& peer : peers ) {
+            if( peer.has(i) ) count++;
+        }
+        holders.insert(i, count);
+    }
+    std::stable_sort(missing.begin(), missing.end(), [&](quint32 a, quint32 b) {
+        int ha = holders.value(a), hb = holders.value(b);
+        // the chunks nobody holds come from the origin, after the others
+        if( (ha == 0) != (hb == 0) ) return hb == 0;
+        return ha < hb;
+    });
+
+    for( quint32 i : missing ) {
+        if( requested.size() >= SWARM_PARALLEL ) return;
+
+        QStringList candidates;
+        for( auto peer = peers.constBegin(); peer != peers.constEnd(); ++peer ) {
+            if( peer.value().has(i) && !banned.contains(peer.key()) ) candidates.push_back(peer.key());
+        }
+        std::shuffle(candidates.begin(), candidates.end(), random);
+
+        bool sent = false;
+        for( const QString& peer : candidates ) {
+            if( (sent = request(i, peer)) ) break;
+        }
+        if( !sent ) request(i, origin);
+    }
+}
+
+bool SwarmReceiver::request(quint32 chunk, const QString& peer) {
+    SwarmLink* link = idleLink(peer);
+    if( link == nullptr ) return false;
+
+    QByteArray request;
+    QDataStream out(&request, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_5);
+    out << static_cast<quint32>(SWARM_MAGIC) << static_cast<quint8>(SwarmServer::Get) << swarm << chunk;
+    link->socket->write(SwarmServer::frame(request));
+    link->chunk = chunk;
+    link->sent.start();
+    requested.insert(chunk);
+    return true;
+}
+
+SwarmLink* SwarmReceiver::idleLink(const QString& peer) {
+    int count = 0;
+    for( auto link = links.begin(); link != links.end(); ++link ) {
+        if( link.value().peer != peer ) continue;
+        if( link.value().chunk < 0 ) return &link.value();
+        count++;
+    }
+    if( count >= SWARM_LINKS_PER_PEER ) return nullptr;
+
+    QHostAddress address = peer == origin ? originAddress : peers.value(peer).address;
+    quint16 port = peer == origin ? originPort : peers.value(peer).port;
+    QTcpSocket* socket = new QTcpSocket(this);
+    connect(socket, &QTcpSocket::readyRead, this, [=]() { readChunk(socket); });
+    connect(socket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this, [=]() {
+        if( links.contains(socket) ) dropLink(socket);
+    });
+    socket->connectToHost(address, port);
+
+    SwarmLink link;
+    link.socket = socket;
+    link.peer = peer;
+    return &links.insert(socket, link).value();
+}
+
+void SwarmReceiver::readChunk(QTcpSocket* socket) {
+    if( !links.contains(socket) ) return;
+    SwarmLink& link = links[socket];
+    link.buffer.append(socket->readAll());
+
+    QByteArray response;
+    bool invalid = false;
+    if( SwarmServer::takeFrame(link.buffer, response, invalid) ) {
+        received(link, response);
+    } else if( invalid ) {
+        dropLink(socket);
+    }
+}
+
+void SwarmReceiver::received(SwarmLink& link, const QByteArray& response) {
+    QTcpSocket* socket = link.socket;
+    if( link.chunk < 0 ) {
+        dropLink(socket);
+        return;
+    }
+    quint32 index = static_cast<quint32>(link.chunk);
+    link.chunk = -1;
+
+    QDataStream in(response);
+    in.setVersion(QDataStream::Qt_5_5);
+    bool ok = false;
+    QByteArray data;
+    in >> ok >> data;
+
+    if( !ok ) {
+        // the peer doesn't hold it anymore: it is not asked again until the next announce
+        requested.remove(index);
+        if( peers.contains(link.peer) ) peers[link.peer].bitmap = 0;
+        schedule();
+        return;
+    }
+
+    // the chunk is hashed on the thread pool, while this thread keeps receiving: it stays requested until verified
+    QString peer = link.peer;
+    QSharedPointer<SwarmManifest> verifier = manifest;
+    QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [=]() {
+        verified(index, peer, data, watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([=]() { return verifier->verify(index, data); }));
+    schedule();
+}
+
+void SwarmReceiver::verified(quint32 index, const QString& peer, const QByteArray& data, bool valid) {
+    if( stopped ) return;
+    requested.remove(index);
+
+    if( !valid ) {
+        if( peer == origin ) {
+            giveUp("the origin sent a wrong chunk");
+            return;
+        }
+        qDebug() << "SWARM:" << peer << "sent a wrong chunk" << index;
+        banned.insert(peer);
+        peers.remove(peer);
+        for( QTcpSocket* socket : links.keys() ) {
+            if( links.value(socket).peer == peer ) dropLink(socket);
+        }
+    } else {
+        QMutexLocker ml(&cache_m);
+        if( index >= nextChunk ) cache.insert(index, data);
+    }
+
+    deliver();
+    schedule();
+}
+
+void SwarmReceiver::dropLink(QTcpSocket* socket) {
+    SwarmLink link = links.take(socket);
+    if( link.chunk >= 0 ) requested.remove(static_cast<quint32>(link.chunk));
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+}
+
+void SwarmReceiver::dropLinks() {
+    for( QTcpSocket* socket : links.keys() ) {
+        dropLink(socket);
+    }
+}
+
+void SwarmReceiver::stop() {
+    stopped = true;
+    tickTimer.stop();
+    announceTimer.stop();
+    dropLinks();
+    if( tracker != nullptr ) tracker->abort();
+    SwarmServer::Instance()->removePeer(swarm);
+}
+
+void SwarmReceiver::giveUp(const QString& reason) {
+    if( failed ) return;
+    failed = true;
+    stop();
+    qDebug() << "SWARM: leaving swarm" << swarm << "-" << reason;
+    emit fallback(reason);
+}
+
+void SwarmReceiver::close() {
+    stop();
+    QIODevice::close();
+}
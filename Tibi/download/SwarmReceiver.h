@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef SWARMRECEIVER_H
+#define SWARMRECEIVER_H
+
+#include <QTcpSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QDebug>
+#include <algorithm>
+#include <random>
+#include "download/GroupReceiver.h"
+#include "network/SwarmManifest.h"
+#include "network/SwarmServer.h"
+
+#define SWARM_TICK 50
+#define SWARM_ANNOUNCE_TIME 1000
+#define SWARM_WINDOW 32             // chunks kept after being given to the reader, for the other receivers
+#define SWARM_AHEAD 32              // chunks pulled ahead of the reader
+#define SWARM_PARALLEL 8
+#define SWARM_LINKS_PER_PEER 2
+#define SWARM_REQUEST_TIMEOUT 5000
+#define SWARM_STALL_TIME 20*1000
+#define SWARM_MAX_UNREAD 4*SWARM_CHUNK_SIZE
+
+/**
+ * @brief The SwarmLink class, a connection to the SwarmServer of a peer (or of the origin), with at most one request at a time
+ */
+class SwarmLink {
+public:
+    SwarmLink() {}
+    QTcpSocket* socket = nullptr;
+    QString peer;
+    qint64 chunk = -1;          // the chunk asked, -1 if the link is idle
+    QElapsedTimer sent;
+    QByteArray buffer;
+};
+
+/**
+ * @brief The SwarmReceiver class pulls the chunks of the item from the other receivers of the swarm and from the origin,
+ * verifies them with the manifest (on the thread pool) and gives them back in order to the reader.
+ * Every SWARM_ANNOUNCE_TIME ms it tells the tracker (the SwarmServer of the origin) which chunks it holds, and gets back the chunks of the others.
+ * The missing chunks of the next SWARM_AHEAD are asked rarest first, at most SWARM_PARALLEL at a time, to a random peer holding them,
+ * or to the origin when no peer does. A peer sending a chunk not matching the manifest is not asked anymore.
+ * The chunks stay in memory until SWARM_WINDOW more have been given to the reader, and in the meantime the SwarmServer
+ * serves them to the other receivers.
+ * While the download is paused no chunk is asked, and the ones already held are still served to the other receivers.
+ * It emits fallback when no chunk arrives for SWARM_STALL_TIME ms or the origin sends a wrong chunk.
+ */
+class SwarmReceiver : public GroupReceiver, public SwarmChunks
+{
+    Q_OBJECT
+
+public:
+    SwarmReceiver(QSharedPointer<SwarmManifest> manifest, quint32 swarm, const QHostAddress& origin, quint16 originPort, QObject* parent = nullptr);
+    ~SwarmReceiver() override;
+
+    bool join() override;
+    void setPaused(bool paused) override;
+    void close() override;
+
+    /**
+     * @brief chunk, called by the SwarmServer thread
+     */
+    bool chunk(quint32 index, QByteArray& data) override;
+
+protected:
+    void drained() override;
+
+private slots:
+    void deliver();
+    void tick();
+    void announce();
+
+private:
+    QSharedPointer<SwarmManifest> manifest;
+    quint32 swarm;
+    QString origin;
+    QHostAddress originAddress;
+    quint16 originPort;
+
+    QTimer tickTimer;
+    QTimer announceTimer;
+    QElapsedTimer lastProgress;
+    bool failed = false;
+    bool stopped = false;
+    bool paused = false;
+    bool deliverQueued = false;
+
+    QMutex cache_m;
+    QMap<quint32, QByteArray> cache;
+    quint32 nextChunk = 0;      // first chunk not given to the reader yet
+
+    QTcpSocket* tracker = nullptr;
+    QByteArray trackerBuffer;
+    QHash<QString, SwarmPeerInfo> peers;
+    QSet<QString> banned;
+    QHash<QTcpSocket*, SwarmLink> links;
+    QSet<quint32> requested;
+    std::mt19937 random;
+
+    void readAnnounce();
+    void readChunk(QTcpSocket* socket);
+    void received(SwarmLink& link, const QByteArray& response);
+    void verified(quint32 index, const QString& peer, const QByteArray& data, bool valid);
+    void schedule();
+    bool request(quint32 chunk, const QString& peer);
+    SwarmLink* idleLink(const QString& peer);
+    void dropLink(QTcpSocket* socket);
+    void dropLinks();
+    void stop();
+    void giveUp(const QString& reason);
+
+};
+
+#endif // SWARMRECEIVER_H
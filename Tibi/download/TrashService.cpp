@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TrashService.h"
+
+TrashService* TrashService::Instance()
+{
+    static TrashService instance;
+    return &instance;
+}
+
+void TrashService::start() {
+    if( workerThread != nullptr ) return;
+
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    for( auto dir : settings.value("trashDirs").toStringList() ) {
+        if( QFileInfo::exists(dir) ) trashDirs.insert(dir);
+    }
+
+    workerThread = new QThread;
+    workerThread->setObjectName("tibi-trash");
+    moveToThread(workerThread);
+    workerThread->start(QThread::IdlePriority);
+    QMetaObject::invokeMethod(this, "emptyTrash", Qt::QueuedConnection);
+}
+
+void TrashService::stop() {
+    if( workerThread == nullptr ) return;
+    workerThread->requestInterruption();
+    workerThread->quit();
+    if( !workerThread->wait(TRASH_STOP_TIMEOUT) ) {
+        qDebug() << "TRASH: the worker did not stop in time";
+        return;
+    }
+    delete workerThread;
+    workerThread = nullptr;
+}
+
+void TrashService::trash(const QString& path, const QString& dir) {
+    if( !QFileInfo::exists(path) ) return;
+    QString trashDir = dir + "/" + TRASH_DIR;
+    QString trashed = trashDir + "/" + QUuid::createUuid().toString(QUuid::WithoutBraces);
+
+    if( !QDir().mkpath(trashDir) || !QDir().rename(path, trashed) ) {
+        qDebug() << "TRASH: impossible to move" << path << "to the trash";
+        return;
+    }
+
+    QMutexLocker ml(&trashDirs_m);
+    if( !trashDirs.contains(trashDir) ) {
+        trashDirs.insert(trashDir);
+        saveTrashDirs();
+    }
+    ml.unlock();
+
+    if( workerThread != nullptr ) QMetaObject::invokeMethod(this, "emptyTrash", Qt::QueuedConnection);
+}
+
+void TrashService::emptyTrash() {
+    QMutexLocker ml(&trashDirs_m);
+    QList<QString> dirs = trashDirs.values();
+    ml.unlock();
+
+    for( auto trashDir : dirs ) {
+        QDir dir(trashDir);
+        for( auto entry : dir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System) ) {
+            if( !removeTree(dir.filePath(entry)) ) return;
+        }
+
+        ml.relock();
+        // an item trashed meanwhile is removed by the next run
+        if( dir.rmdir(trashDir) || !dir.exists() ) {
+            trashDirs.remove(trashDir);
+            saveTrashDirs();
+        }
+        ml.unlock();
+    }
+}
+
+bool TrashService::removeTree(const QString& path) {
+    if( QThread::currentThread()->isInterruptionRequested() ) return false;
+
+    QFileInfo info(path);
+    if( info.isDir() && !info.isSymLink() ) {
+        QDir dir(path);
+        for( auto entry : dir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System) ) {
+            if( !removeTree(dir.filePath(entry)) ) return false;
+        }
+        QDir().rmdir(path);
+    } else {
+        QFile::remove(path);
+    }
+
+    // the low priority of the thread is not enough to keep the disk free for the transfers
+    if( ++removedInBatch >= TRASH_BATCH ) {
+        removedInBatch = 0;
+        QThread::msleep(TRASH_PAUSE);
+    }
+    return true;
+}
+
+void TrashService::saveTrashDirs() {
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    settings.setValue("trashDirs", QStringList(trashDirs.values()));
+}
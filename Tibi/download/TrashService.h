@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TRASHSERVICE_H
+#define TRASHSERVICE_H
+
+#include <QObject>
+#include <QThread>
+#include <QDir>
+#include <QFileInfo>
+#include <QUuid>
+#include <QSet>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QDebug>
+
+#define TRASH_DIR ".tibi-trash"
+#define TRASH_BATCH 500
+#define TRASH_PAUSE 5
+#define TRASH_STOP_TIMEOUT 2000
+
+/**
+ * @brief The TrashService class removes the partial downloads without blocking the handlers.
+ * trash renames the item into <dir>/.tibi-trash/<uuid>, on the same file system, and returns immediately; a worker thread
+ * with the lowest priority empties the trash directories in batches of TRASH_BATCH entries, pausing TRASH_PAUSE ms between them.
+ * The trash directories are stored in the "trashDirs" setting, so that the removal interrupted by the exit is resumed at the next start.
+ */
+class TrashService : public QObject
+{
+    Q_OBJECT
+
+public:
+    static TrashService* Instance();
+
+    /**
+     * @brief start, starts the worker and resumes the removal of the trash left by the previous run
+     */
+    void start();
+
+    /**
+     * @brief stop, interrupts the worker: what is left is removed at the next start
+     */
+    void stop();
+
+    /**
+     * @brief trash, moves the item to the trash directory of dir. It is thread safe.
+     * @param path, the item to remove
+     * @param dir, the directory hosting the trash, on the same file system of the item
+     */
+    void trash(const QString& path, const QString& dir);
+
+private slots:
+    void emptyTrash();
+
+private:
+    TrashService() {}
+    QThread* workerThread = nullptr;
+    QMutex trashDirs_m;
+    QSet<QString> trashDirs;
+    int removedInBatch = 0;
+
+    void saveTrashDirs();
+
+    /**
+     * @brief removeTree, removes the item, checking for the interruption of the worker after each entry
+     * @return false if interrupted
+     */
+    bool removeTree(const QString& path);
+
+};
+
+#endif // TRASHSERVICE_H
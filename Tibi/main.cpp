@@ -7,6 +7,19 @@
 
 #include <QApplication>
 #include "TibiMediator.h"
+#include "network/TibiDirectory.h"
+
+/**
+ * @brief runDirectory, a headless Tibi serving only as TibiDirectory: Tibi --directory [port]
+ */
+static int runDirectory(int argc, char *argv[], int option) {
+    QCoreApplication app(argc, argv);
+    quint16 port = DIRECTORY_PORT;
+    if( option + 1 < argc && QString(argv[option + 1]).toUInt() > 0 ) port = static_cast<quint16>(QString(argv[option + 1]).toUInt());
+    TibiDirectory directory;
+    if( !directory.listen(port) ) return 1;
+    return app.exec();
+}
 
 int main(int argc, char *argv[])
 {
@@ -14,6 +27,10 @@ int main(int argc, char *argv[])
 
     QCoreApplication::setOrganizationName("valentina-di-vincenzo");
     QCoreApplication::setApplicationName("Tibi");
+    for( int i = 1; i < argc; i++ ) {
+        if( QString(argv[i]) == "--directory" ) return runDirectory(argc, argv, i);
+    }
+
     QCoreApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
     QApplication app(argc, argv);
     if (!QSystemTrayIcon::isSystemTrayAvailable()) {
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "MemoryGovernor.h"
+
+MemoryGovernor* MemoryGovernor::Instance()
+{
+    static MemoryGovernor instance;
+    return &instance;
+}
+
+MemoryGovernor::MemoryGovernor() {
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    budget = qMax(1, settings.value("memoryBudget", MEMORY_BUDGET).toInt()) * Q_INT64_C(1024) * 1024;
+    qDebug() << "MEMORY: budget of" << budget << "bytes for the transfers";
+}
+
+int MemoryGovernor::join() {
+    QMutexLocker ml(&memory_m);
+    int transfer = nextId++;
+    transfers.insert(transfer, 0);
+    return transfer;
+}
+
+void MemoryGovernor::leave(int transfer) {
+    QMutexLocker ml(&memory_m);
+    total -= transfers.take(transfer);
+}
+
+void MemoryGovernor::update(int transfer, qint64 inFlight) {
+    QMutexLocker ml(&memory_m);
+    if( !transfers.contains(transfer) ) return;
+    qint64& held = transfers[transfer];
+    total += inFlight - held;
+    held = inFlight;
+}
+
+qint64 MemoryGovernor::share() {
+    QMutexLocker ml(&memory_m);
+    return shareOf();
+}
+
+bool MemoryGovernor::admits(int transfer, qint64 bytes) {
+    QMutexLocker ml(&memory_m);
+    qint64 held = transfers.value(transfer, 0);
+    if( held == 0 ) return true;
+    return held + bytes <= shareOf() && total + bytes <= budget;
+}
+
+qint64 MemoryGovernor::shareOf() const {
+    // the budget is split evenly among the transfers
+    qint64 even = budget / qMax(1, transfers.size());
+    return qBound<qint64>(MEMORY_MIN_SHARE, even, MEMORY_PER_TRANSFER);
+}
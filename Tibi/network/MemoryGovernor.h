@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef MEMORYGOVERNOR_H
+#define MEMORYGOVERNOR_H
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QDebug>
+
+#define MEMORY_BUDGET 256           // MB, unless the "memoryBudget" setting says otherwise
+#define MEMORY_PER_TRANSFER 4*1024*1024
+#define MEMORY_MIN_SHARE 64*1024
+
+/**
+ * @brief The MemoryGovernor class is the ledger of the bytes held in the socket buffers by all the transfers, shared by the handler threads.
+ * A socket never blocks on write and reads as much as the peer sends: without a bound, a slow receiver (or a slow disk)
+ * lets a whole item pile up in memory. Each transfer gets a share of the budget (at most MEMORY_PER_TRANSFER bytes,
+ * at least MEMORY_MIN_SHARE bytes): an upload writes a block only if it fits in its share and in the budget,
+ * a download limits the read buffer of its socket to its share, so that TCP slows down the sender.
+ */
+class MemoryGovernor
+{
+public:
+    static MemoryGovernor* Instance();
+
+    /**
+     * @brief join, a new transfer
+     * @return the id of the transfer in the ledger
+     */
+    int join();
+    void leave(int transfer);
+
+    /**
+     * @brief update, the bytes the transfer holds in memory now
+     */
+    void update(int transfer, qint64 inFlight);
+
+    /**
+     * @brief share, the bytes each transfer can hold
+     */
+    qint64 share();
+
+    /**
+     * @brief admits, whether the transfer can add bytes to the ones it holds.
+     * A transfer holding nothing is always admitted, so that every transfer moves on.
+     */
+    bool admits(int transfer, qint64 bytes);
+
+private:
+    MemoryGovernor();
+    QMutex memory_m;
+    QHash<int, qint64> transfers;
+    qint64 budget;
+    qint64 total = 0;
+    int nextId = 0;
+
+    qint64 shareOf() const;
+
+};
+
+#endif // MEMORYGOVERNOR_H
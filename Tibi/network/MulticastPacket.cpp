@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "MulticastPacket.h"
+
+QByteArray MulticastPacket::encode(const QByteArray& key) const {
+    QByteArray datagram(MCAST_HEADER_SIZE, 0);
+    uchar* out = reinterpret_cast<uchar*>(datagram.data());
+
+    qToBigEndian<quint32>(MCAST_MAGIC, out);
+    out[4] = kind;
+    qToBigEndian<quint32>(session, out + 5);
+    qToBigEndian<quint32>(seq, out + 9);
+    qToBigEndian<quint16>(length, out + 13);
+    datagram.append(payload);
+    datagram.append(tag(datagram.constData(), datagram.size(), key));
+    return datagram;
+}
+
+bool MulticastPacket::decode(const QByteArray& datagram, const QByteArray& key, MulticastPacket& packet) {
+    if( key.size() != MCAST_KEY_SIZE || datagram.size() < MCAST_HEADER_SIZE + MCAST_TAG_SIZE ) return false;
+    const uchar* in = reinterpret_cast<const uchar*>(datagram.constData());
+    if( qFromBigEndian<quint32>(in) != MCAST_MAGIC ) return false;
+
+    // the whole tag is compared, so that the time taken doesn't tell how many bytes of a forged tag are right
+    int signedSize = datagram.size() - MCAST_TAG_SIZE;
+    QByteArray expected = tag(datagram.constData(), signedSize, key);
+    quint8 difference = 0;
+    for( int i = 0; i < MCAST_TAG_SIZE; i++ ) {
+        difference |= static_cast<quint8>(expected.at(i) ^ datagram.at(signedSize + i));
+    }
+    if( difference != 0 ) return false;
+
+    packet.kind = in[4];
+    packet.session = qFromBigEndian<quint32>(in + 5);
+    packet.seq = qFromBigEndian<quint32>(in + 9);
+    packet.length = qFromBigEndian<quint16>(in + 13);
+    packet.payload = datagram.mid(MCAST_HEADER_SIZE, signedSize - MCAST_HEADER_SIZE);
+    if( packet.kind == Data && packet.payload.size() != packet.length ) return false;
+    return packet.kind <= Nack;
+}
+
+MulticastPacket MulticastPacket::nack(quint32 session, const QVector<quint32>& missing) {
+    MulticastPacket packet;
+    packet.kind = Nack;
+    packet.session = session;
+    int count = qMin(missing.size(), MCAST_MAX_NACK);
+    packet.seq = static_cast<quint32>(count);
+    packet.payload.resize(count * 4);
+    uchar* out = reinterpret_cast<uchar*>(packet.payload.data());
+    for( int i = 0; i < count; i++ ) {
+        qToBigEndian<quint32>(missing.at(i), out + i * 4);
+    }
+    return packet;
+}
+
+QVector<quint32> MulticastPacket::nackedPackets() const {
+    QVector<quint32> missing;
+    const uchar* in = reinterpret_cast<const uchar*>(payload.constData());
+    int count = qMin(static_cast<int>(seq), payload.size() / 4);
+    for( int i = 0; i < count; i++ ) {
+        missing.push_back(qFromBigEndian<quint32>(in + i * 4));
+    }
+    return missing;
+}
+
+void MulticastPacket::xorInto(QByteArray& parity, const QByteArray& data) {
+    if( parity.size() < data.size() ) parity.append(QByteArray(data.size() - parity.size(), 0));
+    char* out = parity.data();
+    const char* in = data.constData();
+    for( int i = 0; i < data.size(); i++ ) {
+        out[i] ^= in[i];
+    }
+}
+
+QByteArray MulticastPacket::tag(const char* data, int size, const QByteArray& key) {
+    QMessageAuthenticationCode mac(QCryptographicHash::Sha256, key);
+    mac.addData(data, size);
+    return mac.result().left(MCAST_TAG_SIZE);
+}
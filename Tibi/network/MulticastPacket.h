@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef MULTICASTPACKET_H
+#define MULTICASTPACKET_H
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QVector>
+#include <QtEndian>
+#include <QMessageAuthenticationCode>
+
+#define MCAST_MAGIC 0x5449424D // "TIBM"
+#define MCAST_HEADER_SIZE 15
+#define MCAST_TAG_SIZE 16
+#define MCAST_KEY_SIZE 32
+#define MCAST_PAYLOAD 1400
+#define MCAST_FEC_BLOCK 8
+#define MCAST_DATA_PORT 45460
+#define MCAST_MAX_NACK 256
+
+/**
+ * @brief The MulticastOffer class, the multicast group of a transfer, announced to the receiver in the first metadata.
+ * A null session means that the transfer is unicast only. The key authenticates the packets of the session: it only travels
+ * on the TLS sockets, so a host that is not a member cannot forge them.
+ */
+class MulticastOffer {
+public:
+    MulticastOffer() {}
+    QHostAddress group;
+    quint16 port = 0;
+    quint32 session = 0;
+    QByteArray key;     // MCAST_KEY_SIZE random bytes
+};
+
+/**
+ * @brief The MulticastPacket class, the fixed-layout datagram of the multicast data mode.
+ * The data packets carry, in order, the same bytes that a unicast upload writes after the answer of the receiver.
+ * Every MCAST_FEC_BLOCK data packets the sender adds a parity packet, the XOR of their payloads: a single packet lost
+ * in a block is rebuilt without asking. The other losses are asked again with a NACK, sent unicast to the sender.
+ * Layout (big endian):
+ * MAGIC    quint32 - "TIBM"
+ * KIND     quint8  - Kind
+ * SESSION  quint32 - the transfer, as offered in the first metadata
+ * SEQ      quint32 - Data: the packet number, Parity: the block number, End: the number of data packets,
+ *                    Gone: the packet that cannot be sent again, Nack: the number of packet numbers in the payload
+ * LENGTH   quint16 - Data: the payload size, Parity: the XOR of the payload sizes of the block
+ * PAYLOAD  Data: the bytes, Parity: quint8 packets in the block, then the XOR, Nack: quint32 packet numbers
+ * TAG      MCAST_TAG_SIZE bytes - the HMAC-SHA256 of all the bytes before it with the key of the offer, truncated
+ * A datagram whose tag doesn't match is dropped before it is read: the multicast data are not encrypted, but they cannot be altered.
+ */
+class MulticastPacket
+{
+public:
+    enum Kind : quint8 {
+        Data = 0,
+        Parity = 1,
+        End = 2,        // all the data packets have been sent
+        Gone = 3,       // the packet is not in the history of the sender anymore: the receiver has to go unicast
+        Nack = 4        // from a receiver: the packets it misses
+    };
+
+    MulticastPacket() {}
+
+    quint8 kind = Data;
+    quint32 session = 0;
+    quint32 seq = 0;
+    quint16 length = 0;
+    QByteArray payload;
+
+    /**
+     * @brief encode, the datagram of the packet, tagged with key
+     */
+    QByteArray encode(const QByteArray& key) const;
+
+    /**
+     * @brief decode, reads a packet from a datagram
+     * @return false if the datagram is not a multicast packet or its tag doesn't match key
+     */
+    static bool decode(const QByteArray& datagram, const QByteArray& key, MulticastPacket& packet);
+
+    /**
+     * @brief nack, the NACK asking the given packets
+     */
+    static MulticastPacket nack(quint32 session, const QVector<quint32>& missing);
+    QVector<quint32> nackedPackets() const;
+
+    /**
+     * @brief xorInto, accumulates data into the parity (growing it if needed)
+     */
+    static void xorInto(QByteArray& parity, const QByteArray& data);
+
+private:
+    static QByteArray tag(const char* data, int size, const QByteArray& key);
+
+};
+
+#endif // MULTICASTPACKET_H
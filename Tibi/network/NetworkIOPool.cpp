@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "NetworkIOPool.h"
+
+void NetworkIOPool::start() {
+    if( !threads.isEmpty() ) return;
+
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    int defaultThreads = qBound(2, QThread::idealThreadCount(), DEFAULT_IO_THREADS);
+    int count = qBound(1, settings.value("networkThreads", defaultThreads).toInt(), MAX_IO_THREADS);
+
+    for( int i = 0; i < count; i++ ) {
+        QThread* thread = new QThread;
+        thread->setObjectName("tibi-io-" + QString::number(i));
+        thread->start();
+        threads.push_back(thread);
+    }
+    qDebug() << "NETWORK IO POOL: started" << count << "threads";
+}
+
+QThread* NetworkIOPool::next() {
+    int i = nextThread.fetchAndAddRelaxed(1);
+    return threads.at((i & 0x7fffffff) % threads.size());
+}
+
+int NetworkIOPool::size() const {
+    return threads.size();
+}
+
+void NetworkIOPool::stop() {
+    for( auto thread : threads ) {
+        thread->quit();
+    }
+    for( auto thread : threads ) {
+        if( !thread->wait(IO_POOL_STOP_TIMEOUT) ) {
+            qDebug() << "NETWORK IO POOL:" << thread->objectName() << "did not stop in time";
+            continue;
+        }
+        delete thread;
+    }
+    threads.clear();
+}
+
+NetworkIOPool::~NetworkIOPool() {
+    stop();
+}
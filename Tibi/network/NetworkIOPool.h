@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef NETWORKIOPOOL_H
+#define NETWORKIOPOOL_H
+
+#include <QThread>
+#include <QVector>
+#include <QAtomicInt>
+#include <QSettings>
+#include <QDebug>
+
+#define DEFAULT_IO_THREADS 4
+#define MAX_IO_THREADS 16
+#define IO_POOL_STOP_TIMEOUT 3000
+
+/**
+ * @brief The NetworkIOPool class is a fixed set of threads, each one running its own event loop, that host the
+ * receiver listeners and the download handlers until the user answers the confirmation request:
+ * accept, TLS handshake and metadata parsing never wait behind the GUI thread.
+ * The number of threads is read from the "networkThreads" setting (default: the number of cores, between 2 and DEFAULT_IO_THREADS).
+ */
+class NetworkIOPool
+{
+public:
+    NetworkIOPool() {}
+    ~NetworkIOPool();
+
+    void start();
+
+    /**
+     * @brief next, the threads are assigned round-robin. It is safe to call it from any thread once the pool is started.
+     */
+    QThread* next();
+    int size() const;
+
+    /**
+     * @brief stop, quits the event loops and waits for the threads to exit
+     */
+    void stop();
+
+private:
+    QVector<QThread*> threads;
+    QAtomicInt nextThread;
+};
+
+#endif // NETWORKIOPOOL_H
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "PathSelector.h"
+
+QList<QHostAddress> PathSelector::rank(const QList<QHostAddress>& addresses) {
+    QList<QPair<int, QHostAddress>> scored;
+    for( const QHostAddress& address : addresses ) {
+        int s = score(address);
+        if( s > 0 ) scored.push_back(qMakePair(s, address));
+    }
+    std::stable_sort(scored.begin(), scored.end(), [](const QPair<int, QHostAddress>& a, const QPair<int, QHostAddress>& b) {
+        return a.first > b.first;
+    });
+
+    QList<QHostAddress> ranked;
+    for( const auto& s : scored ) {
+        ranked.push_back(s.second);
+    }
+    return ranked;
+}
+
+int PathSelector::score(const QHostAddress& address) {
+    for( const QNetworkInterface& iface : TibiInterfaces::multicastInterfaces() ) {
+        bool reachable = false;
+        if( address.protocol() == QAbstractSocket::IPv6Protocol && address.isLinkLocal() ) {
+            reachable = !address.scopeId().isEmpty() && (address.scopeId() == iface.name() || address.scopeId() == QString::number(iface.index()));
+        } else {
+            for( const QNetworkAddressEntry& entry : iface.addressEntries() ) {
+                if( entry.ip().protocol() == address.protocol() && address.isInSubnet(entry.ip(), entry.prefixLength()) ) {
+                    reachable = true;
+                    break;
+                }
+            }
+        }
+        // class first, then link speed (Mb/s, capped)
+        if( reachable ) return interfaceClass(iface) * 100000 + qMin(linkSpeed(iface), 99999);
+    }
+    return 0;
+}
+
+int PathSelector::interfaceClass(const QNetworkInterface& iface) {
+    static const QStringList virtualPrefixes = { "docker", "veth", "br-", "virbr", "vmnet", "vboxnet", "tun", "tap", "utun", "zt", "wg" };
+    for( const QString& prefix : virtualPrefixes ) {
+        if( iface.name().startsWith(prefix) ) return 1;
+    }
+
+    switch( iface.type() ) {
+    case QNetworkInterface::Ethernet: return 4;
+    case QNetworkInterface::Wifi: return 3;
+    case QNetworkInterface::Virtual: return 1;
+    default: return 2;
+    }
+}
+
+int PathSelector::linkSpeed(const QNetworkInterface& iface) {
+#ifdef Q_OS_LINUX
+    QFile speed("/sys/class/net/" + iface.name() + "/speed");
+    if( speed.open(QIODevice::ReadOnly) ) {
+        int mbps = speed.readAll().trimmed().toInt();
+        if( mbps > 0 ) return mbps;
+    }
+#else
+    Q_UNUSED(iface);
+#endif
+    return 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef PATHSELECTOR_H
+#define PATHSELECTOR_H
+
+#include <QHostAddress>
+#include <QNetworkInterface>
+#include <QFile>
+#include <algorithm>
+#include "network/TibiInterfaces.h"
+
+/**
+ * @brief The PathSelector class chooses the address of a tibier to send to, when it advertises more than one.
+ * Each address is reached through the local interface on the same subnet (or the scope of an IPv6 link-local address),
+ * and the interfaces are ranked: wired before Wi-Fi before anything else, virtual bridges and tunnels last,
+ * then by link speed. TibiConnector races the connections in this order, so the fastest path among the best ones wins.
+ */
+class PathSelector
+{
+public:
+    /**
+     * @brief rank, orders the addresses from the best path to the worst; the unreachable ones are dropped
+     */
+    static QList<QHostAddress> rank(const QList<QHostAddress>& addresses);
+
+private:
+    static int score(const QHostAddress& address);
+    static int interfaceClass(const QNetworkInterface& iface);
+    static int linkSpeed(const QNetworkInterface& iface);
+
+};
+
+#endif // PATHSELECTOR_H
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "SwarmManifest.h"
+
+SwarmManifest::SwarmManifest(QSharedPointer<ItemStream> stream) :
+    stream(stream)
+{
+}
+
+bool SwarmManifest::build() {
+    stream->layout();
+    size = stream->size();
+    for( qint64 offset = 0; offset < size; offset += chunkSize ) {
+        QByteArray data;
+        if( !stream->read(offset, chunkSize, data) ) {
+            qDebug() << "SWARM: impossible to read the item at" << offset;
+            return false;
+        }
+        hashes.append(QCryptographicHash::hash(data, QCryptographicHash::Sha256));
+    }
+    valid.storeRelease(1);
+    qDebug() << "SWARM: manifest of" << chunksCount() << "chunks for" << size << "bytes";
+    return true;
+}
+
+QByteArray SwarmManifest::encode() const {
+    QByteArray encoded;
+    QDataStream out(&encoded, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_5);
+    out << size;
+    out << chunkSize;
+    out << hashes;
+    return encoded;
+}
+
+bool SwarmManifest::decode(const QByteArray& encoded) {
+    QDataStream in(encoded);
+    in.setVersion(QDataStream::Qt_5_5);
+    in >> size;
+    in >> chunkSize;
+    in >> hashes;
+    if( in.status() != QDataStream::Ok || size < 0 || chunkSize <= 0 ) return false;
+    valid.storeRelease(hashes.size() == static_cast<qint64>(chunksCount()) * SWARM_HASH_SIZE ? 1 : 0);
+    return valid.loadAcquire();
+}
+
+quint32 SwarmManifest::chunksCount() const {
+    return static_cast<quint32>((size + chunkSize - 1) / chunkSize);
+}
+
+qint64 SwarmManifest::streamSize() const {
+    return size;
+}
+
+bool SwarmManifest::verify(quint32 index, const QByteArray& data) const {
+    if( index >= chunksCount() ) return false;
+    qint64 expected = qMin<qint64>(chunkSize, size - static_cast<qint64>(index) * chunkSize);
+    if( data.size() != expected ) return false;
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256) == hashes.mid(static_cast<int>(index) * SWARM_HASH_SIZE, SWARM_HASH_SIZE);
+}
+
+bool SwarmManifest::chunk(quint32 index, QByteArray& data) {
+    if( stream.isNull() || !valid.loadAcquire() || index >= chunksCount() ) return false;
+    return stream->read(static_cast<qint64>(index) * chunkSize, chunkSize, data);
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef SWARMMANIFEST_H
+#define SWARMMANIFEST_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QFuture>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include "upload/ItemStream.h"
+
+#define SWARM_CHUNK_SIZE 256*1024
+#define SWARM_HASH_SIZE 32
+#define SWARM_MIN_RECEIVERS 3
+
+/**
+ * @brief The SwarmChunks class, what a SwarmServer can serve for a swarm: the origin reads the chunks from disk,
+ * a receiver from the chunks it keeps in memory. chunk must be thread safe.
+ */
+class SwarmChunks {
+public:
+    virtual ~SwarmChunks() {}
+
+    /**
+     * @return false if the chunk is not available
+     */
+    virtual bool chunk(quint32 index, QByteArray& data) = 0;
+};
+
+/**
+ * @brief The SwarmManifest class splits the stream of an item (see ItemStream) in chunks of SWARM_CHUNK_SIZE bytes,
+ * each one identified by its SHA-256. The origin builds it and sends it to the receivers on the TLS socket, so that the chunks
+ * pulled from the other receivers can be verified.
+ * Encoding (QDataStream):
+ * STREAM SIZE  qint64
+ * CHUNK SIZE   qint32
+ * HASHES       QByteArray - SWARM_HASH_SIZE bytes for each chunk
+ */
+class SwarmManifest : public SwarmChunks
+{
+public:
+    /**
+     * @brief SwarmManifest, on the origin
+     */
+    explicit SwarmManifest(QSharedPointer<ItemStream> stream);
+
+    /**
+     * @brief SwarmManifest, on a receiver: it is filled by decode
+     */
+    SwarmManifest() {}
+
+    /**
+     * @brief build, reads the item and hashes the chunks. It is called once, on the thread pool (see SwarmOffer::built):
+     * the manifest is encoded only after it finished.
+     * @return false if the item cannot be read
+     */
+    bool build();
+    QByteArray encode() const;
+    bool decode(const QByteArray& encoded);
+
+    quint32 chunksCount() const;
+    qint64 streamSize() const;
+    bool verify(quint32 index, const QByteArray& data) const;
+
+    /**
+     * @brief chunk, reads the chunk from disk (on the origin only)
+     */
+    bool chunk(quint32 index, QByteArray& data) override;
+
+private:
+    QSharedPointer<ItemStream> stream;
+    QAtomicInt valid = 0;   // the SwarmServer may ask the chunks while the manifest is being built
+    qint64 size = 0;
+    qint32 chunkSize = SWARM_CHUNK_SIZE;
+    QByteArray hashes;
+
+};
+
+/**
+ * @brief The SwarmOffer class, the swarm of a transfer, announced to the receiver in the first metadata:
+ * its id and the port of the SwarmServer of the origin. A null swarm means that the transfer doesn't use it.
+ */
+class SwarmOffer {
+public:
+    SwarmOffer() {}
+    quint32 swarm = 0;
+    quint16 port = 0;
+    QSharedPointer<SwarmManifest> manifest;    // on the origin only
+    QFuture<bool> built;                        // the build of the manifest, shared by the handlers of the swarm
+};
+
+#endif // SWARMMANIFEST_H
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "SwarmServer.h"
+
+SwarmServer* SwarmServer::Instance()
+{
+    static SwarmServer instance;
+    return &instance;
+}
+
+void SwarmServer::listen() {
+    if( server != nullptr ) return;
+    server = new QTcpServer(this);
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    quint16 requested = static_cast<quint16>(settings.value("swarmPort", 0).toUInt());
+    if( !server->listen(QHostAddress::Any, requested) ) {
+        qDebug() << "SWARM: the server cannot listen:" << server->errorString();
+        return;
+    }
+    connect(server, &QTcpServer::newConnection, this, &SwarmServer::newConnection);
+    port.storeRelease(server->serverPort());
+    qDebug() << "SWARM: serving chunks on port" << server->serverPort();
+}
+
+void SwarmServer::close() {
+    if( server == nullptr ) return;
+    port.storeRelease(0);
+    server->close();
+    for( QTcpSocket* socket : buffers.keys() ) {
+        socket->abort();
+        socket->deleteLater();
+    }
+    buffers.clear();
+    trackers.clear();
+    // it is deleted by the thread owning it, before the pool stops
+    delete server;
+    server = nullptr;
+}
+
+quint16 SwarmServer::serverPort() const {
+    return static_cast<quint16>(port.loadAcquire());
+}
+
+void SwarmServer::addSeed(quint32 swarm, QSharedPointer<SwarmManifest> manifest) {
+    QMutexLocker ml(&swarms_m);
+    // the swarms whose handlers are gone
+    for( auto seed = seeds.begin(); seed != seeds.end(); ) {
+        if( seed.value().isNull() ) seed = seeds.erase(seed);
+        else ++seed;
+    }
+    seeds.insert(swarm, manifest);
+}
+
+void SwarmServer::addPeer(quint32 swarm, SwarmChunks* chunks) {
+    QMutexLocker ml(&swarms_m);
+    peers.insert(swarm, chunks);
+}
+
+void SwarmServer::removePeer(quint32 swarm) {
+    QMutexLocker ml(&swarms_m);
+    peers.remove(swarm);
+}
+
+void SwarmServer::newConnection() {
+    while( server->hasPendingConnections() ) {
+        QTcpSocket* socket = server->nextPendingConnection();
+        buffers.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, [=]() { readRequests(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [=]() {
+            buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void SwarmServer::readRequests(QTcpSocket* socket) {
+    QByteArray& buffer = buffers[socket];
+    buffer.append(socket->readAll());
+
+    QByteArray request;
+    bool invalid = false;
+    while( takeFrame(buffer, request, invalid) ) {
+        QByteArray response = handle(request, unmapped(socket->peerAddress()));
+        if( response.isNull() ) {
+            invalid = true;
+            break;
+        }
+        socket->write(frame(response));
+    }
+
+    if( invalid ) {
+        buffers.remove(socket);
+        socket->abort();
+        socket->deleteLater();
+    }
+}
+
+QByteArray SwarmServer::handle(const QByteArray& request, const QHostAddress& from) {
+    QDataStream in(request);
+    in.setVersion(QDataStream::Qt_5_5);
+    quint32 magic = 0;
+    quint8 kind = 0;
+    quint32 swarm = 0;
+    in >> magic >> kind >> swarm;
+    if( magic != SWARM_MAGIC ) return QByteArray();
+
+    if( kind == Get ) {
+        quint32 chunk = 0;
+        in >> chunk;
+        return serveChunk(swarm, chunk);
+    }
+    if( kind == Announce ) {
+        quint16 peerPort = 0;
+        quint32 base = 0;
+        quint64 bitmap = 0;
+        in >> peerPort >> base >> bitmap;
+        return track(swarm, from, peerPort, base, bitmap);
+    }
+    return QByteArray();
+}
+
+QByteArray SwarmServer::serveChunk(quint32 swarm, quint32 chunk) {
+    QByteArray data;
+    bool ok = false;
+
+    QMutexLocker ml(&swarms_m);
+    if( peers.contains(swarm) ) {
+        // the receiver cannot go away while its chunk is copied
+        ok = peers.value(swarm)->chunk(chunk, data);
+    } else {
+        QSharedPointer<SwarmManifest> manifest = seeds.value(swarm).toStrongRef();
+        ml.unlock();
+        if( !manifest.isNull() ) ok = manifest->chunk(chunk, data);
+    }
+
+    QByteArray response;
+    QDataStream out(&response, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_5);
+    out << ok;
+    out << (ok ? data : QByteArray());
+    return response;
+}
+
+QByteArray SwarmServer::track(quint32 swarm, const QHostAddress& from, quint16 peerPort, quint32 base, quint64 bitmap) {
+    QByteArray response;
+    QDataStream out(&response, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_5);
+
+    {
+        QMutexLocker ml(&swarms_m);
+        if( seeds.value(swarm).isNull() ) {
+            trackers.remove(swarm);
+            out << static_cast<quint16>(0);
+            return response;
+        }
+    }
+
+    QVector<SwarmPeerInfo>& known = trackers[swarm];
+    bool found = false;
+    for( int i = known.size() - 1; i >= 0; i-- ) {
+        SwarmPeerInfo& peer = known[i];
+        if( peer.address == from && peer.port == peerPort ) {
+            peer.base = base;
+            peer.bitmap = bitmap;
+            peer.seen.restart();
+            found = true;
+        } else if( peer.seen.elapsed() > SWARM_PEER_TIMEOUT ) {
+            known.remove(i);
+        }
+    }
+    if( !found && peerPort != 0 ) {
+        SwarmPeerInfo peer;
+        peer.address = from;
+        peer.port = peerPort;
+        peer.base = base;
+        peer.bitmap = bitmap;
+        peer.seen.start();
+        known.push_back(peer);
+    }
+
+    // a random subset of the others, so that the load spreads among them
+    QVector<SwarmPeerInfo> others;
+    for( const SwarmPeerInfo& peer : known ) {
+        if( peer.address != from || peer.port != peerPort ) others.push_back(peer);
+    }
+    std::shuffle(others.begin(), others.end(), std::mt19937(std::random_device()()));
+    if( others.size() > SWARM_MAX_PEERS ) others.resize(SWARM_MAX_PEERS);
+
+    out << static_cast<quint16>(others.size());
+    for( const SwarmPeerInfo& peer : others ) {
+        out << peer.address.toString() << peer.port << peer.base << peer.bitmap;
+    }
+    return response;
+}
+
+QByteArray SwarmServer::frame(const QByteArray& payload) {
+    QByteArray framed(4, 0);
+    qToBigEndian<quint32>(static_cast<quint32>(payload.size()), reinterpret_cast<uchar*>(framed.data()));
+    framed.append(payload);
+    return framed;
+}
+
+bool SwarmServer::takeFrame(QByteArray& buffer, QByteArray& payload, bool& invalid) {
+    if( buffer.size() < 4 ) return false;
+    quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(buffer.constData()));
+    if( size > SWARM_MAX_FRAME ) {
+        invalid = true;
+        return false;
+    }
+    if( static_cast<quint32>(buffer.size()) < 4 + size ) return false;
+    payload = buffer.mid(4, static_cast<int>(size));
+    buffer.remove(0, static_cast<int>(4 + size));
+    return true;
+}
+
+QHostAddress SwarmServer::unmapped(const QHostAddress& address) {
+    bool isIPv4 = false;
+    quint32 ipv4 = address.toIPv4Address(&isIPv4);
+    return isIPv4 ? QHostAddress(ipv4) : address;
+}
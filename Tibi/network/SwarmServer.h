@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef SWARMSERVER_H
+#define SWARMSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHash>
+#include <QWeakPointer>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QtEndian>
+#include <QSettings>
+#include <algorithm>
+#include <random>
+#include "network/SwarmManifest.h"
+
+#define SWARM_MAGIC 0x54494253 // "TIBS"
+#define SWARM_MAX_FRAME 2*SWARM_CHUNK_SIZE
+#define SWARM_PEER_TIMEOUT 5000
+#define SWARM_MAX_PEERS 40
+
+/**
+ * @brief The SwarmPeerInfo class, a receiver of a swarm as known by the tracker: where its SwarmServer listens
+ * and which chunks it can serve, as a bitmap of 64 chunks starting from base.
+ */
+class SwarmPeerInfo {
+public:
+    SwarmPeerInfo() {}
+    QHostAddress address;
+    quint16 port = 0;
+    quint32 base = 0;
+    quint64 bitmap = 0;
+    QElapsedTimer seen;
+
+    bool has(quint32 chunk) const { return chunk >= base && chunk - base < 64 && (bitmap >> (chunk - base)) & 1; }
+};
+
+/**
+ * @brief The SwarmServer class serves the chunks of the swarms this tibier takes part in, to the other receivers:
+ * on the origin it reads them from disk, and it is the tracker of the swarm; on a receiver it serves the chunks it keeps in memory.
+ * The chunks are verified by the receivers with the manifest received on TLS: the requests are not encrypted, and only the
+ * receivers knowing the swarm id (sent on TLS as well) can ask them.
+ * Each message is a frame: SIZE quint32 (big endian), then the payload written with QDataStream:
+ * MAGIC quint32, KIND quint8, SWARM quint32, then
+ * - Get:      CHUNK quint32                                  -> OK bool, DATA QByteArray
+ * - Announce: PORT quint16, BASE quint32, BITMAP quint64     -> COUNT quint16, then for each peer ADDRESS QString, PORT, BASE, BITMAP
+ * It lives in a thread of the NetworkIOPool.
+ */
+class SwarmServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Kind : quint8 {
+        Get = 0,
+        Announce = 1
+    };
+
+    static SwarmServer* Instance();
+
+    /**
+     * @brief serverPort, 0 until the server listens. It is thread safe.
+     */
+    quint16 serverPort() const;
+
+    /**
+     * @brief addSeed, the origin serves the chunks of the manifest, as long as it exists, and tracks the receivers of the swarm
+     */
+    void addSeed(quint32 swarm, QSharedPointer<SwarmManifest> manifest);
+
+    /**
+     * @brief addPeer and removePeer, a receiver serves the chunks it has until it is removed.
+     * Once removePeer returns, the chunks are not asked anymore.
+     */
+    void addPeer(quint32 swarm, SwarmChunks* chunks);
+    void removePeer(quint32 swarm);
+
+    /* -- framing, used by the SwarmReceiver as well -- */
+    static QByteArray frame(const QByteArray& payload);
+
+    /**
+     * @brief takeFrame, removes the first complete frame from the buffer
+     * @return false if there is no complete frame yet (or the buffer is not valid, see invalid)
+     */
+    static bool takeFrame(QByteArray& buffer, QByteArray& payload, bool& invalid);
+
+    /**
+     * @brief unmapped, the IPv4 address of an IPv4-mapped IPv6 address (a dual stack socket)
+     */
+    static QHostAddress unmapped(const QHostAddress& address);
+
+public slots:
+    void listen();
+    void close();
+
+private slots:
+    void newConnection();
+
+private:
+    SwarmServer() {}
+    QTcpServer* server = nullptr;
+    QAtomicInt port = 0;
+
+    QMutex swarms_m;
+    QHash<quint32, QWeakPointer<SwarmManifest>> seeds;
+    QHash<quint32, SwarmChunks*> peers;
+
+    /* -- server thread only -- */
+    QHash<QTcpSocket*, QByteArray> buffers;
+    QHash<quint32, QVector<SwarmPeerInfo>> trackers;
+
+    void readRequests(QTcpSocket* socket);
+    QByteArray handle(const QByteArray& request, const QHostAddress& from);
+    QByteArray serveChunk(quint32 swarm, quint32 chunk);
+    QByteArray track(quint32 swarm, const QHostAddress& from, quint16 port, quint32 base, quint64 bitmap);
+
+};
+
+#endif // SWARMSERVER_H
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TibiBeacon.h"
+#include <cstring>
+
+QByteArray TibiBeacon::encode() const {
+    QByteArray datagram(BEACON_V2_SIZE, 0);
+    uchar* out = reinterpret_cast<uchar*>(datagram.data());
+
+    qToBigEndian<quint32>(BEACON_MAGIC, out);
+    out[4] = version;
+    qToBigEndian<quint16>(capabilities, out + 5);
+    QByteArray rawId = id.toRfc4122();
+    memcpy(out + 7, rawId.constData(), 16);
+    qToBigEndian<quint16>(port, out + 23);
+    qToBigEndian<quint16>(profilePort, out + 25);
+    qToBigEndian<quint32>(nameHash, out + 27);
+    qToBigEndian<quint32>(avatarHash, out + 31);
+    qToBigEndian<quint16>(interval, out + 35);
+
+    datagram.append(static_cast<char>(qMin(addresses.size(), 255)));
+    for( int i = 0; i < addresses.size() && i < 255; i++ ) {
+        const QHostAddress& address = addresses.at(i);
+        if( address.protocol() == QAbstractSocket::IPv4Protocol ) {
+            char ipv4[5];
+            ipv4[0] = 4;
+            qToBigEndian<quint32>(address.toIPv4Address(), reinterpret_cast<uchar*>(ipv4 + 1));
+            datagram.append(ipv4, 5);
+        } else {
+            Q_IPV6ADDR ipv6 = address.toIPv6Address();
+            datagram.append(static_cast<char>(6));
+            datagram.append(reinterpret_cast<const char*>(ipv6.c), 16);
+        }
+    }
+
+    return datagram;
+}
+
+bool TibiBeacon::decode(const QByteArray& datagram, TibiBeacon& beacon) {
+    return decode(datagram.constData(), datagram.size(), beacon);
+}
+
+bool TibiBeacon::decode(const char* datagram, qint64 size, TibiBeacon& beacon) {
+    beacon.id = peekId(datagram, size);
+    if( beacon.id.isNull() ) return false;
+    const uchar* in = reinterpret_cast<const uchar*>(datagram);
+
+    beacon.version = in[4];
+    beacon.capabilities = qFromBigEndian<quint16>(in + 5);
+    beacon.port = qFromBigEndian<quint16>(in + 23);
+    beacon.profilePort = qFromBigEndian<quint16>(in + 25);
+    beacon.nameHash = qFromBigEndian<quint32>(in + 27);
+    beacon.avatarHash = qFromBigEndian<quint32>(in + 31);
+    beacon.interval = DEFAULT_BEACON_INTERVAL;
+    if( beacon.version >= 2 && size >= BEACON_V2_SIZE ) beacon.interval = qMax<quint16>(1, qFromBigEndian<quint16>(in + 35));
+
+    beacon.addresses.clear();
+    if( beacon.version >= 3 && size > BEACON_V2_SIZE ) {
+        int count = in[BEACON_V2_SIZE];
+        qint64 offset = BEACON_V2_SIZE + 1;
+        for( int i = 0; i < count; i++ ) {
+            if( offset < size && in[offset] == 4 && offset + 5 <= size ) {
+                beacon.addresses.push_back(QHostAddress(qFromBigEndian<quint32>(in + offset + 1)));
+                offset += 5;
+            } else if( offset < size && in[offset] == 6 && offset + 17 <= size ) {
+                beacon.addresses.push_back(QHostAddress(in + offset + 1));
+                offset += 17;
+            } else {
+                break; // truncated or unknown family
+            }
+        }
+    }
+
+    return true;
+}
+
+QUuid TibiBeacon::peekId(const char* datagram, qint64 size) {
+    if( size < BEACON_SIZE ) return QUuid();
+    if( qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(datagram)) != BEACON_MAGIC ) return QUuid();
+    return QUuid::fromRfc4122(QByteArray::fromRawData(datagram + 7, 16));
+}
+
+QByteArray TibiBeacon::encodeQuery(const QUuid& id) {
+    QByteArray datagram(QUERY_SIZE, 0);
+    uchar* out = reinterpret_cast<uchar*>(datagram.data());
+    qToBigEndian<quint32>(QUERY_MAGIC, out);
+    out[4] = 1;
+    QByteArray rawId = id.toRfc4122();
+    memcpy(out + 5, rawId.constData(), 16);
+    return datagram;
+}
+
+QUuid TibiBeacon::peekQuery(const char* datagram, qint64 size) {
+    if( size < QUERY_SIZE ) return QUuid();
+    if( qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(datagram)) != QUERY_MAGIC ) return QUuid();
+    return QUuid::fromRfc4122(QByteArray::fromRawData(datagram + 5, 16));
+}
+
+quint32 TibiBeacon::hash32(const QByteArray& data) {
+    QByteArray md5 = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+    quint32 hash = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(md5.constData()));
+    return hash == 0 ? 1 : hash;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIBIBEACON_H
+#define TIBIBEACON_H
+
+#include <QByteArray>
+#include <QUuid>
+#include <QHostAddress>
+#include <QList>
+#include <QtEndian>
+#include <QCryptographicHash>
+
+#define BEACON_MAGIC 0x54494249 // "TIBI"
+#define BEACON_VERSION 3
+#define BEACON_SIZE 35
+#define BEACON_V2_SIZE 37
+#define DEFAULT_BEACON_INTERVAL 5
+#define QUERY_MAGIC 0x54494251 // "TIBQ"
+#define QUERY_SIZE 21
+
+/**
+ * @brief The TibiBeacon class, the fixed-layout datagram multicast by TibiPing.
+ * It only says who the tibier is and where to reach it: the username and the avatar are represented by their hash,
+ * and are fetched once through TibiProfileFetcher when the hash changes.
+ * Layout (big endian):
+ * MAGIC         quint32 - "TIBI"
+ * VERSION       quint8
+ * CAPABILITIES  quint16 - bitmap of Capability
+ * ID            16 bytes - QUuid in RFC 4122 order
+ * PORT          quint16 - port of the TibiReceiver
+ * PROFILE PORT  quint16 - port of the TibiProfileServer
+ * NAME HASH     quint32
+ * AVATAR HASH   quint32 - 0 for the default avatar
+ * INTERVAL      quint16 - s until the next beacon at most, since version 2 (DEFAULT_BEACON_INTERVAL before)
+ * ADDRESSES     quint8 count, then for each address quint8 family (4 or 6) and 4 or 16 bytes, since version 3
+ * The address is the sender address of the datagram. Newer versions can only append fields.
+ * The query ("who is here") is multicast by a tibier that just started listening, the others answer with their beacon in unicast:
+ * MAGIC         quint32 - "TIBQ"
+ * VERSION       quint8
+ * ID            16 bytes - the id of the tibier asking
+ */
+class TibiBeacon
+{
+public:
+    enum Capability : quint16 {
+        Transfers = 0x0001,     // accepts TLS transfers on PORT
+        Profile = 0x0002,       // serves its username and avatar on PROFILE PORT
+        ItemCount = 0x0004,     // reads the item count announced in the first metadata of a transfer
+        Multicast = 0x0008,     // joins the multicast group offered in the first metadata of a transfer
+        Swarm = 0x0010          // pulls the chunks of the swarm offered in the first metadata from the other receivers
+    };
+
+    TibiBeacon() {}
+
+    quint8 version = BEACON_VERSION;
+    quint16 capabilities = 0;
+    QUuid id;
+    quint16 port = 0;
+    quint16 profilePort = 0;
+    quint32 nameHash = 0;
+    quint32 avatarHash = 0;
+    quint16 interval = DEFAULT_BEACON_INTERVAL;
+    QList<QHostAddress> addresses;  // every local address of the tibier, IPv6 link-local ones without scope
+
+    QByteArray encode() const;
+
+    /**
+     * @brief decode, reads a beacon from a datagram
+     * @return false if the datagram is not a beacon
+     */
+    static bool decode(const QByteArray& datagram, TibiBeacon& beacon);
+    static bool decode(const char* datagram, qint64 size, TibiBeacon& beacon);
+
+    /**
+     * @brief peekId, reads only the id of a beacon, without copying the datagram
+     * @return a null id if the datagram is not a beacon
+     */
+    static QUuid peekId(const char* datagram, qint64 size);
+
+    static QByteArray encodeQuery(const QUuid& id);
+
+    /**
+     * @brief peekQuery, reads the id of the tibier asking
+     * @return a null id if the datagram is not a query
+     */
+    static QUuid peekQuery(const char* datagram, qint64 size);
+
+    /**
+     * @brief hash32, the first 32 bits of the MD5 of data, never 0 (0 means "nothing")
+     */
+    static quint32 hash32(const QByteArray& data);
+
+};
+
+#endif // TIBIBEACON_H
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TibiBeaconReader.h"
+#include <cstring>
+
+TibiBeaconReader::TibiBeaconReader(TibiBeaconSink* sink, const QUuid& ownId) :
+    sink(sink),
+    ownId(ownId)
+{
+    receiveBuffer.resize(BEACON_BUFFER_SIZE);
+#ifdef Q_OS_LINUX
+    batchBuffer.resize(RECV_BATCH * BEACON_BUFFER_SIZE);
+    batchHeaders.resize(RECV_BATCH);
+    batchVectors.resize(RECV_BATCH);
+    batchSenders.resize(RECV_BATCH);
+    for( int i = 0; i < RECV_BATCH; i++ ) {
+        batchVectors[i].iov_base = batchBuffer.data() + i * BEACON_BUFFER_SIZE;
+        batchVectors[i].iov_len = BEACON_BUFFER_SIZE;
+        memset(&batchHeaders[i], 0, sizeof(mmsghdr));
+        batchHeaders[i].msg_hdr.msg_iov = &batchVectors[i];
+        batchHeaders[i].msg_hdr.msg_iovlen = 1;
+        batchHeaders[i].msg_hdr.msg_name = &batchSenders[i];
+    }
+#endif
+}
+
+void TibiBeaconReader::readSocket(QUdpSocket* socket, bool batched) {
+    while (socket->hasPendingDatagrams()) {
+        // a read through Qt re-arms the read notification of the socket
+        qint64 size = socket->readDatagram(receiveBuffer.data(), receiveBuffer.size(), &senderAddress);
+        if( size < 0 ) break;
+        readBeacon(receiveBuffer.constData(), size, senderAddress);
+#ifdef Q_OS_LINUX
+        if( batched ) drainBatches(socket);
+#else
+        Q_UNUSED(batched);
+#endif
+    }
+}
+
+#ifdef Q_OS_LINUX
+void TibiBeaconReader::drainBatches(QUdpSocket* socket) {
+    int received = RECV_BATCH;
+    while( received == RECV_BATCH ) {
+        for( int i = 0; i < RECV_BATCH; i++ ) {
+            batchHeaders[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+        received = recvmmsg(static_cast<int>(socket->socketDescriptor()), batchHeaders.data(), RECV_BATCH, MSG_DONTWAIT, nullptr);
+        for( int i = 0; i < received; i++ ) {
+            senderAddress.setAddress(ntohl(batchSenders.at(i).sin_addr.s_addr));
+            readBeacon(batchBuffer.constData() + i * BEACON_BUFFER_SIZE, batchHeaders.at(i).msg_len, senderAddress);
+        }
+    }
+}
+#endif
+
+void TibiBeaconReader::readBeacon(const char* datagram, qint64 size, const QHostAddress& sender) {
+    QUuid id = TibiBeacon::peekId(datagram, size);
+    if( id.isNull() ) {
+        sink->readQuery(datagram, size, sender);
+        return;
+    }
+    if( id == ownId ) return;
+
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+    // the common case: the same beacon as last time, from any of the interfaces
+    auto last = lastBeacons.constFind(id);
+    if( last != lastBeacons.constEnd() && last->size() == size
+            && memcmp(last->constData(), datagram, size) == 0
+            && sink->touchTibier(id, now) ) {
+        return;
+    }
+
+    TibiBeacon beacon;
+    TibiBeacon::decode(datagram, size, beacon);
+
+    QSharedPointer<Tibier> tibierPing(new Tibier);
+    tibierPing->id = beacon.id;
+    tibierPing->address = sender.protocol() == QAbstractSocket::IPv6Protocol && sender.toIPv4Address() ? QHostAddress(sender.toIPv4Address()) : sender;
+    tibierPing->addresses = beacon.addresses;
+    for( QHostAddress& address : tibierPing->addresses ) {
+        // a link-local address is only usable through the interface the beacon came from
+        if( address.isLinkLocal() && address.protocol() == QAbstractSocket::IPv6Protocol && !sender.scopeId().isEmpty() ) address.setScopeId(sender.scopeId());
+    }
+    if( !tibierPing->addresses.contains(tibierPing->address) ) tibierPing->addresses.prepend(tibierPing->address);
+    tibierPing->port = beacon.port;
+    tibierPing->profilePort = beacon.profilePort;
+    tibierPing->capabilities = beacon.capabilities;
+    tibierPing->nameHash = beacon.nameHash;
+    tibierPing->avatarHash = beacon.avatarHash;
+    tibierPing->avatarCode = beacon.avatarHash == 0 ? 0 : 1;
+    tibierPing->pingInterval = beacon.interval;
+    tibierPing->updateAvatarPath();
+    tibierPing->online = true;
+    tibierPing->lastPing = now;
+
+    Tibier known;
+    bool isKnown = sink->lookupTibier(beacon.id, known);
+    // the same tibier is heard from all its interfaces: its address changes only if the old one is gone
+    if( isKnown && tibierPing->addresses.contains(known.address) ) tibierPing->address = known.address;
+    bool needName = !isKnown || known.nameHash != beacon.nameHash;
+    // the avatars are cached by hash, possibly downloaded for another tibier or in a previous session
+    bool needAvatar = beacon.avatarHash != 0 && !QFile::exists(tibierPing->avatarPath);
+
+    if( (needName || needAvatar) && (beacon.capabilities & TibiBeacon::Profile) ) {
+        sink->fetchProfile(*tibierPing, needName, needAvatar);
+    }
+    if( !isKnown ) return; // shown when its username arrives
+
+    // until the new profile arrives, the tibier is kept alive with the old one
+    tibierPing->username = known.username;
+    if( needName ) tibierPing->nameHash = known.nameHash;
+    if( needAvatar ) {
+        tibierPing->avatarHash = known.avatarHash;
+        tibierPing->avatarCode = known.avatarCode;
+        tibierPing->avatarPath = known.avatarPath;
+    }
+    sink->newPing(tibierPing);
+
+    // the beacon is fully applied only if nothing is missing
+    if( needName || needAvatar ) {
+        lastBeacons.remove(id);
+    } else {
+        lastBeacons.insert(id, QByteArray(datagram, static_cast<int>(size)));
+    }
+}
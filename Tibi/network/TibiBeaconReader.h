@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIBIBEACONREADER_H
+#define TIBIBEACONREADER_H
+
+#include <QUdpSocket>
+#include <QHostAddress>
+#include <QByteArray>
+#include <QHash>
+#include <QUuid>
+#include <QFile>
+#include <QDateTime>
+#include <QSharedPointer>
+#include "network/TibiBeacon.h"
+#include "user/tibier.h"
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+#define BEACON_BUFFER_SIZE 512
+#define RECV_BATCH 32
+
+/**
+ * @brief The TibiBeaconSink class, where the TibiBeaconReader applies the beacons: TibiDiscovery in the application,
+ * the registry alone in TibiDiscoveryBench.
+ */
+class TibiBeaconSink {
+public:
+    virtual ~TibiBeaconSink() {}
+
+    /**
+     * @brief touchTibier, see UserHandler::touchTibier
+     */
+    virtual bool touchTibier(const QUuid& id, qint64 lastPing) = 0;
+    virtual bool lookupTibier(const QUuid& id, Tibier& tibier) = 0;
+    virtual void newPing(QSharedPointer<Tibier> tibier) = 0;
+
+    /**
+     * @brief fetchProfile, the username (needName) or the avatar (needAvatar) of the tibier are not known yet
+     */
+    virtual void fetchProfile(const Tibier& tibier, bool needName, bool needAvatar) = 0;
+
+    /**
+     * @brief readQuery, a datagram that is not a beacon: possibly a query
+     */
+    virtual void readQuery(const char* datagram, qint64 size, const QHostAddress& sender) = 0;
+};
+
+/**
+ * @brief The TibiBeaconReader class, the hot path of the discovery: it reads the datagrams of a socket and applies the beacons to a TibiBeaconSink.
+ * The datagrams are read in a buffer allocated once (on Linux, from an IPv4 socket, RECV_BATCH at a time with recvmmsg) and parsed in place:
+ * a beacon identical to the previous one of the same tibier only refreshes the time of its last ping.
+ */
+class TibiBeaconReader
+{
+public:
+    TibiBeaconReader(TibiBeaconSink* sink, const QUuid& ownId);
+
+    /**
+     * @brief readSocket, reads every pending datagram of socket
+     * @param batched, the socket is IPv4: the datagrams after the first one are read with recvmmsg where available
+     */
+    void readSocket(QUdpSocket* socket, bool batched);
+
+    /**
+     * @brief readBeacon, applies a single datagram, as received from sender
+     */
+    void readBeacon(const char* datagram, qint64 size, const QHostAddress& sender);
+
+private:
+    TibiBeaconSink* sink;
+    QUuid ownId;
+
+    /* -- RECEIVE BUFFERS --*/
+    QByteArray receiveBuffer;
+    QHostAddress senderAddress;
+#ifdef Q_OS_LINUX
+    QByteArray batchBuffer;
+    QVector<mmsghdr> batchHeaders;
+    QVector<iovec> batchVectors;
+    QVector<sockaddr_in> batchSenders;
+    void drainBatches(QUdpSocket* socket);
+#endif
+
+    /* -- LAST BEACON OF EACH TIBIER --*/
+    QHash<QUuid, QByteArray> lastBeacons;
+
+};
+
+#endif // TIBIBEACONREADER_H
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TibiConnector.h"
+
+QMutex TibiConnector::routes_m;
+QHash<QUuid, QHostAddress> TibiConnector::routes;
+
+TibiConnector::TibiConnector(QSharedPointer<Tibier> tibier, QObject* parent) :
+    QObject(parent),
+    tibier(tibier)
+{
+    staggerTimer.setSingleShot(true);
+    connect(&staggerTimer, &QTimer::timeout, this, &TibiConnector::startNextAttempt);
+    timeoutTimer.setSingleShot(true);
+    connect(&timeoutTimer, &QTimer::timeout, this, [=]() {
+        fail("No address of " + this->tibier->username + " answered: " + lastError);
+    });
+}
+
+void TibiConnector::configure(QSslSocket* socket) {
+    QSslConfiguration config = socket->sslConfiguration();
+    config.setPeerVerifyMode(QSslSocket::VerifyNone);
+    socket->setSslConfiguration(config);
+    socket->ignoreSslErrors();
+    socket->addCaCertificates(":/certificates/tibi.pem");
+}
+
+void TibiConnector::start() {
+    QList<QHostAddress> addresses = tibier->addresses;
+    if( !addresses.contains(tibier->address) ) addresses.prepend(tibier->address);
+
+    {
+        // the route that won last time goes first, if it is still advertised
+        QMutexLocker ml(&routes_m);
+        QHostAddress cached = routes.value(tibier->id);
+        if( !cached.isNull() && addresses.contains(cached) ) candidates.push_back(cached);
+    }
+    for( const QHostAddress& address : PathSelector::rank(addresses) ) {
+        if( !candidates.contains(address) ) candidates.push_back(address);
+    }
+    // the ones not on a local subnet may still be routed
+    for( const QHostAddress& address : addresses ) {
+        if( !candidates.contains(address) ) candidates.push_back(address);
+    }
+
+    timeoutTimer.start(CONNECT_TIMEOUT);
+    startNextAttempt();
+}
+
+void TibiConnector::startNextAttempt() {
+    if( done || next >= candidates.size() ) return;
+
+    QHostAddress address = candidates.at(next++);
+    qDebug() << "[CONNECTOR] trying " << address.toString() << "@" << tibier->port;
+
+    QSslSocket* socket = new QSslSocket(this);
+    configure(socket);
+    attempts.insert(socket, address);
+    connect(socket, &QSslSocket::encrypted, this, [=]() { finish(socket); });
+    connect(socket, static_cast<void ( QTcpSocket::* )( QAbstractSocket::SocketError )>( &QAbstractSocket::error ), this,
+            [=]( QAbstractSocket::SocketError ) { attemptFailed(socket); });
+    socket->connectToHostEncrypted(address.toString(), tibier->port);
+
+    if( next < candidates.size() ) staggerTimer.start(CONNECT_STAGGER);
+}
+
+void TibiConnector::attemptFailed(QSslSocket* socket) {
+    if( done || !attempts.contains(socket) ) return;
+    lastError = socket->errorString();
+    QHostAddress address = attempts.take(socket);
+    socket->disconnect(this);
+    socket->deleteLater();
+    qDebug() << "[CONNECTOR] " << address.toString() << " failed: " << lastError;
+
+    {
+        QMutexLocker ml(&routes_m);
+        if( routes.value(tibier->id) == address ) routes.remove(tibier->id);
+    }
+
+    if( next < candidates.size() ) {
+        // no need to wait for the stagger
+        staggerTimer.stop();
+        startNextAttempt();
+    } else if( attempts.isEmpty() ) {
+        fail("No address of " + tibier->username + " is reachable: " + lastError);
+    }
+}
+
+void TibiConnector::finish(QSslSocket* winner) {
+    if( done ) return;
+    done = true;
+    staggerTimer.stop();
+    timeoutTimer.stop();
+
+    QHostAddress address = attempts.take(winner);
+    for( QSslSocket* loser : attempts.keys() ) {
+        loser->disconnect(this);
+        loser->abort();
+        loser->deleteLater();
+    }
+    attempts.clear();
+
+    {
+        QMutexLocker ml(&routes_m);
+        routes.insert(tibier->id, address);
+    }
+    qDebug() << "[CONNECTOR] route to " << tibier->username << " through " << address.toString();
+
+    winner->disconnect(this);
+    winner->setParent(nullptr);
+    emit connectedSocket(winner);
+}
+
+void TibiConnector::fail(const QString& error) {
+    if( done ) return;
+    abort();
+    emit failed(error);
+}
+
+void TibiConnector::abort() {
+    done = true;
+    staggerTimer.stop();
+    timeoutTimer.stop();
+    for( QSslSocket* socket : attempts.keys() ) {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    attempts.clear();
+}
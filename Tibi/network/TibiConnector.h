@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIBICONNECTOR_H
+#define TIBICONNECTOR_H
+
+#include <QObject>
+#include <QSslSocket>
+#include <QSslConfiguration>
+#include <QTimer>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include "user/tibier.h"
+#include "network/PathSelector.h"
+
+#define CONNECT_STAGGER 250
+#define CONNECT_TIMEOUT 10*1000
+
+/**
+ * @brief The TibiConnector class opens the TLS connection to the receiver of a tibier that advertises several addresses.
+ * The addresses are tried in the order of PathSelector, starting a new attempt every CONNECT_STAGGER ms (or as soon as one fails)
+ * without waiting for the previous ones: the first connection that completes the TLS handshake wins and the others are aborted.
+ * The winning address is cached per tibier and tried first next time, so an unreachable address costs at most a stagger.
+ * It lives in the thread of the UploadHandler that creates it.
+ */
+class TibiConnector : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TibiConnector(QSharedPointer<Tibier> tibier, QObject* parent = nullptr);
+    void start();
+    void abort();
+
+    /**
+     * @brief configure, configures the ssl connection by specyfying to don't
+     * verify the peer identity and ignoring any ssl error related to the handshake
+     */
+    static void configure(QSslSocket* socket);
+
+signals:
+    /**
+     * @brief connectedSocket, the encrypted socket of the winning attempt, now owned by the receiver of the signal
+     */
+    void connectedSocket(QSslSocket* socket);
+    void failed(const QString& error);
+
+private:
+    QSharedPointer<Tibier> tibier;
+    QList<QHostAddress> candidates;
+    int next = 0;
+    QHash<QSslSocket*, QHostAddress> attempts;
+    QTimer staggerTimer;
+    QTimer timeoutTimer;
+    QString lastError;
+    bool done = false;
+
+    /* -- routes that won, shared by all the uploads --*/
+    static QMutex routes_m;
+    static QHash<QUuid, QHostAddress> routes;
+
+    void startNextAttempt();
+    void attemptFailed(QSslSocket* socket);
+    void finish(QSslSocket* winner);
+    void fail(const QString& error);
+
+};
+
+#endif // TIBICONNECTOR_H
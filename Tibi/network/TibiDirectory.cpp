@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TibiDirectory.h"
+
+TibiDirectory::TibiDirectory(QObject* parent) : QObject(parent) {
+    connect(&server, &QTcpServer::newConnection, this, &TibiDirectory::newMember);
+    connect(&sweepTimer, &QTimer::timeout, this, &TibiDirectory::sweep);
+}
+
+bool TibiDirectory::listen(quint16 port) {
+    if( !server.listen(QHostAddress::Any, port) ) {
+        qDebug() << "TIBI DIRECTORY cannot listen on" << port << ":" << server.errorString();
+        return false;
+    }
+    sweepTimer.start(DIRECTORY_SWEEP_TIME);
+    qDebug() << "TIBI DIRECTORY listening on" << server.serverPort();
+    return true;
+}
+
+void TibiDirectory::newMember() {
+    while( server.hasPendingConnections() ) {
+        QTcpSocket* socket = server.nextPendingConnection();
+        members.insert(socket, Member());
+        members[socket].address = SwarmServer::unmapped(socket->peerAddress());
+        members[socket].seen.start();
+        connect(socket, &QTcpSocket::readyRead, this, [=]() { readMember(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [=]() { drop(socket); });
+    }
+}
+
+void TibiDirectory::readMember(QTcpSocket* socket) {
+    if( !members.contains(socket) ) return;
+    QByteArray& buffer = members[socket].buffer;
+    buffer.append(socket->readAll());
+
+    QByteArray payload;
+    bool invalid = false;
+    while( !invalid && members.contains(socket) && SwarmServer::takeFrame(members[socket].buffer, payload, invalid) ) {
+        readRegistration(socket, payload);
+    }
+    if( invalid ) drop(socket);
+}
+
+void TibiDirectory::readRegistration(QTcpSocket* socket, const QByteArray& payload) {
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_5_5);
+    quint32 magic = 0;
+    quint8 kind = 0;
+    QByteArray beacon;
+    in >> magic >> kind >> beacon;
+    TibiBeacon decoded;
+    if( in.status() != QDataStream::Ok || magic != DIRECTORY_MAGIC || kind != Register || !TibiBeacon::decode(beacon, decoded) ) {
+        drop(socket);
+        return;
+    }
+
+    if( members[socket].beacon == beacon ) {
+        members[socket].seen.restart();
+        return; // only alive
+    }
+
+    bool first = members[socket].id.isNull();
+    if( !first && decoded.id != members[socket].id ) {
+        drop(socket);
+        return;
+    }
+    if( first ) {
+        // a client cannot take over the id of a registered tibier: a tibier that restarted before its old connection
+        // timed out is refused until the sweep drops it, and registers at its next retry
+        if( registered.contains(decoded.id) ) {
+            qDebug() << "TIBI DIRECTORY refused a second registration of" << decoded.id << "from" << members[socket].address;
+            drop(socket);
+            return;
+        }
+        registered.insert(decoded.id, socket);
+
+        // the subscription starts with all the tibiers already registered
+        for( auto other = members.constBegin(); other != members.constEnd(); ++other ) {
+            if( other.key() != socket && !other->beacon.isEmpty() ) send(socket, peerPayload(*other));
+        }
+    }
+
+    Member& member = members[socket];
+    member.seen.restart();
+    member.id = decoded.id;
+    member.beacon = beacon;
+    member.maxSilence = qMax<qint64>(MAX_TIME_BETWEEN_PING, decoded.interval * PINGS_BEFORE_DISCONNECTED);
+    broadcast(socket, peerPayload(member));
+}
+
+QByteArray TibiDirectory::peerPayload(const Member& member) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_5);
+    out << static_cast<quint32>(DIRECTORY_MAGIC) << static_cast<quint8>(Peer) << member.address.toString() << member.beacon;
+    return payload;
+}
+
+void TibiDirectory::send(QTcpSocket* socket, const QByteArray& payload) {
+    socket->write(SwarmServer::frame(payload));
+}
+
+void TibiDirectory::broadcast(QTcpSocket* from, const QByteArray& payload) {
+    QByteArray framed = SwarmServer::frame(payload);
+    QVector<QTcpSocket*> slow;
+    for( auto member = members.constBegin(); member != members.constEnd(); ++member ) {
+        if( member.key() == from || member->id.isNull() ) continue;
+        if( member.key()->bytesToWrite() > DIRECTORY_MAX_BACKLOG ) {
+            slow.push_back(member.key());
+            continue;
+        }
+        member.key()->write(framed);
+    }
+    for( QTcpSocket* socket : slow ) {
+        drop(socket);
+    }
+}
+
+void TibiDirectory::drop(QTcpSocket* socket) {
+    if( !members.contains(socket) ) return;
+    Member member = members.take(socket);
+    if( !member.id.isNull() && registered.value(member.id) == socket ) {
+        registered.remove(member.id);
+        QByteArray payload;
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_5);
+        out << static_cast<quint32>(DIRECTORY_MAGIC) << static_cast<quint8>(Gone) << member.id;
+        broadcast(socket, payload);
+    }
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+}
+
+void TibiDirectory::sweep() {
+    QVector<QTcpSocket*> silent;
+    for( auto member = members.constBegin(); member != members.constEnd(); ++member ) {
+        qint64 limit = member->id.isNull() ? DIRECTORY_REGISTER_TIMEOUT : member->maxSilence * 1000;
+        if( member->seen.elapsed() > limit ) silent.push_back(member.key());
+    }
+    for( QTcpSocket* socket : silent ) {
+        drop(socket);
+    }
+}
+
+QByteArray TibiDirectory::registerFrame(const QByteArray& beacon) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_5);
+    out << static_cast<quint32>(DIRECTORY_MAGIC) << static_cast<quint8>(Register) << beacon;
+    return SwarmServer::frame(payload);
+}
+
+bool TibiDirectory::readFrame(const QByteArray& payload, quint8& kind, QHostAddress& address, QByteArray& beacon, QUuid& id) {
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_5_5);
+    quint32 magic = 0;
+    in >> magic >> kind;
+    if( magic != DIRECTORY_MAGIC ) return false;
+    if( kind == Peer ) {
+        QString addressString;
+        in >> addressString >> beacon;
+        address = QHostAddress(addressString);
+        id = TibiBeacon::peekId(beacon.constData(), beacon.size());
+        return in.status() == QDataStream::Ok && !id.isNull() && !address.isNull();
+    }
+    if( kind == Gone ) {
+        in >> id;
+        return in.status() == QDataStream::Ok && !id.isNull();
+    }
+    return false;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIBIDIRECTORY_H
+#define TIBIDIRECTORY_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QDataStream>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "network/TibiBeacon.h"
+#include "network/SwarmServer.h"
+#include "user/tibier.h"
+
+#define DIRECTORY_MAGIC 0x54494244 // "TIBD"
+#define DIRECTORY_PORT 45455
+#define DIRECTORY_SWEEP_TIME 1000
+#define DIRECTORY_REGISTER_TIMEOUT 5000
+#define DIRECTORY_MAX_BACKLOG 4*1024*1024
+
+/**
+ * @brief The TibiDirectory class, the rendezvous of the tibiers that don't share a link, and so never hear each other's beacons.
+ * Each tibier configured with the "directory" setting keeps a connection to it (see TibiDiscovery) and registers its beacon there:
+ * at the registration it receives the beacons of all the others, then only the changes, pushed as they happen.
+ * A beacon identical to the previous one only keeps the registration alive; a tibier silent for more than its Tibier::maxSilence,
+ * or disconnected, is announced as gone. An id is registered by a single connection: a second registration of the same id
+ * is refused until the first one is closed or timed out. A subscriber that doesn't read its updates (more than DIRECTORY_MAX_BACKLOG bytes pending) is dropped.
+ * It runs in a headless Tibi started with --directory [port].
+ * Each message is a frame as in SwarmServer: SIZE quint32 (big endian), then the payload written with QDataStream:
+ * MAGIC quint32, KIND quint8, then
+ * - Register (tibier -> directory): BEACON QByteArray, as multicast by TibiPing
+ * - Peer (directory -> tibier):     ADDRESS QString, the address the tibier registered from, BEACON QByteArray
+ * - Gone (directory -> tibier):     ID QUuid
+ */
+class TibiDirectory : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Kind : quint8 {
+        Register = 0,
+        Peer = 1,
+        Gone = 2
+    };
+
+    explicit TibiDirectory(QObject* parent = nullptr);
+    bool listen(quint16 port);
+
+    static QByteArray registerFrame(const QByteArray& beacon);
+
+    /**
+     * @brief readFrame, reads a frame sent by the directory
+     * @return false if the frame is not valid
+     */
+    static bool readFrame(const QByteArray& payload, quint8& kind, QHostAddress& address, QByteArray& beacon, QUuid& id);
+
+private:
+    class Member {
+    public:
+        QByteArray buffer;
+        QUuid id;
+        QHostAddress address;
+        QByteArray beacon;
+        qint64 maxSilence = MAX_TIME_BETWEEN_PING;
+        QElapsedTimer seen;
+    };
+
+    QTcpServer server;
+    QHash<QTcpSocket*, Member> members;
+    QHash<QUuid, QTcpSocket*> registered;
+    QTimer sweepTimer;
+
+    void readRegistration(QTcpSocket* socket, const QByteArray& payload);
+    void send(QTcpSocket* socket, const QByteArray& payload);
+    void broadcast(QTcpSocket* from, const QByteArray& payload);
+    void drop(QTcpSocket* socket);
+    static QByteArray peerPayload(const Member& member);
+
+private slots:
+    void newMember();
+    void readMember(QTcpSocket* socket);
+    void sweep();
+
+};
+
+#endif // TIBIDIRECTORY_H
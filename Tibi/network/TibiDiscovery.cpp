@@ -14,98 +14,213 @@ void TibiDiscovery::setUserInfo(UserHandler* user) {
 }
 
 void TibiDiscovery::startDiscovery() {
-    tibierPing = QSharedPointer<Tibier>(new Tibier);
-    avatarArrayPing = QSharedPointer<QByteArray>(new QByteArray);
-    groupAddress4.setAddress("224.0.0.1");
+    groupAddress4.setAddress(GROUP_ADDRESS4);
     udpSocket4 = new QUdpSocket();
-    udpSocket4->bind(QHostAddress::AnyIPv4, 45454, QUdpSocket::ShareAddress);
-    udpSocket4->joinMulticastGroup(groupAddress4);
+    udpSocket4->bind(QHostAddress::AnyIPv4, DISCOVERY_PORT, QUdpSocket::ShareAddress);
     connect(udpSocket4, &QUdpSocket::readyRead,
             this, &TibiDiscovery::processPendingDatagrams);
-}
 
+    groupAddress6.setAddress(GROUP_ADDRESS6);
+    udpSocket6 = new QUdpSocket();
+    if( udpSocket6->bind(QHostAddress::AnyIPv6, DISCOVERY_PORT, QUdpSocket::ShareAddress) ) {
+        connect(udpSocket6, &QUdpSocket::readyRead,
+                this, &TibiDiscovery::processPendingDatagrams6);
+    } else {
+        qDebug() << "No IPv6 discovery: " << udpSocket6->errorString();
+    }
 
+    refreshMembership();
+    membershipTimer = new QTimer(this);
+    connect(membershipTimer, &QTimer::timeout, this, &TibiDiscovery::refreshMembership);
+    membershipTimer->start(MEMBERSHIP_REFRESH_TIME);
 
-void TibiDiscovery::processPendingDatagrams() {
+    fetcher = new TibiProfileFetcher(this);
+    connect(fetcher, &TibiProfileFetcher::profileFetched, this, &TibiDiscovery::profileFetched);
+    prober = new TibiLinkProber(user, this);
 
-    while (udpSocket4->hasPendingDatagrams()) {
+    reader = new TibiBeaconReader(this, user->getId());
 
-        QNetworkDatagram dgram = udpSocket4->receiveDatagram();
-        data = new QByteArray;
-        *data = dgram.data();
-        ping = new QDataStream(data, QIODevice::ReadOnly);
+    sendQuery();
+    startDirectory();
+}
 
+void TibiDiscovery::sendQuery() {
+    if( udpSocket4 == nullptr ) return;
+    if( lastQuery.isValid() && lastQuery.elapsed() < MIN_TIME_BETWEEN_QUERIES ) return;
+    lastQuery.start();
+    writeQuery();
+    QTimer::singleShot(QUERY_REPEAT_TIME, this, &TibiDiscovery::writeQuery);
+}
 
-        if( checkLoopback() ) continue;
-        readPing();
-        if(tibierPing->avatarCode != 0 && user->checkIfNewAvatarTibier(tibierPing->id, tibierPing->avatarCode)) {
-            createNewAvatarArray();
+void TibiDiscovery::writeQuery() {
+    if( udpSocket4 == nullptr ) return;
+    // sent from the discovery port: the beacons answering it come back to the discovery sockets
+    QByteArray datagram = TibiBeacon::encodeQuery(user->getId());
+    for( const QNetworkInterface& iface : TibiInterfaces::multicastInterfaces() ) {
+        if( TibiInterfaces::hasIPv4(iface) ) {
+            udpSocket4->setMulticastInterface(iface);
+            udpSocket4->writeDatagram(datagram, groupAddress4, DISCOVERY_PORT);
+        }
+        if( TibiInterfaces::hasIPv6(iface) && udpSocket6->state() == QAbstractSocket::BoundState ) {
+            udpSocket6->setMulticastInterface(iface);
+            QHostAddress scopedGroup = groupAddress6;
+            scopedGroup.setScopeId(iface.name());
+            udpSocket6->writeDatagram(datagram, scopedGroup, DISCOVERY_PORT);
         }
-        user->newPing(tibierPing, avatarArrayPing);
-        tibierPing.reset(new Tibier);
-        avatarArrayPing.reset(new QByteArray);
-        delete ping;
-        ping = nullptr;
-        delete data;
-        data = nullptr;
-        /*
-        qDebug() << "Received PING from " <<  dgram.senderAddress().toString()
-                 << "@" << dgram.senderPort()
-                 << "size: " << dgram.data().size()
-                 << "\nPING: "
-                 << "\n id: " << tibierPing->id.toString()
-                 << "\n username: " << tibierPing->username
-                 << "\n address: " << tibierPing->address
-                 << "\n port: " << tibierPing->port
-                 << "\n avatar code: " << tibierPing->avatarCode;
-*/
     }
 }
 
-bool TibiDiscovery::checkLoopback() {
-    *ping >> tibierPing->id;
 
-    if( tibierPing->id == user->getId() ) {
-        return true;
+
+void TibiDiscovery::refreshMembership() {
+    for( const QNetworkInterface& iface : TibiInterfaces::multicastInterfaces() ) {
+        if( TibiInterfaces::hasIPv4(iface) && !joined4.contains(iface.name()) ) {
+            if( udpSocket4->joinMulticastGroup(groupAddress4, iface) ) joined4.insert(iface.name());
+        }
+        if( TibiInterfaces::hasIPv6(iface) && !joined6.contains(iface.name()) && udpSocket6->state() == QAbstractSocket::BoundState ) {
+            if( udpSocket6->joinMulticastGroup(groupAddress6, iface) ) joined6.insert(iface.name());
+        }
     }
-    tibierPing->updateAvatarPath();
-    return false;
+}
 
+void TibiDiscovery::processPendingDatagrams() {
+    reader->readSocket(udpSocket4, true);
 }
-void TibiDiscovery::readPing() {
 
-    *ping >> tibierPing->username;
-    QString addressPing;
-    *ping >> addressPing;
-    tibierPing->address = QHostAddress(addressPing);
-    *ping >> tibierPing->port;
-    *ping >> tibierPing->avatarCode;
-    tibierPing->online = true;
-    tibierPing->lastPing = QDateTime::currentSecsSinceEpoch();
+void TibiDiscovery::processPendingDatagrams6() {
+    reader->readSocket(udpSocket6, false);
+}
 
-    //qDebug() << QThread::currentThreadId() << " - TIBI DISCOVERY ping read";
+bool TibiDiscovery::touchTibier(const QUuid& id, qint64 lastPing) {
+    return user->touchTibier(id, lastPing);
+}
+
+bool TibiDiscovery::lookupTibier(const QUuid& id, Tibier& tibier) {
+    return user->lookupTibier(id, tibier);
+}
 
+void TibiDiscovery::newPing(QSharedPointer<Tibier> tibier) {
+    user->newPing(tibier);
 }
 
-void TibiDiscovery::createNewAvatarArray() {
+void TibiDiscovery::fetchProfile(const Tibier& tibier, bool needName, bool needAvatar) {
+    fetcher->fetch(tibier, needName, needAvatar);
+}
 
-    *ping >> avatarSizePing;
-    for( int i=0; i< avatarSizePing; i++) {
-        qint8 byte;
-        *ping >> byte;
-        avatarArrayPing->append(byte);
+void TibiDiscovery::startDirectory() {
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    QString setting = settings.value("directory").toString().trimmed();
+    if( setting.isEmpty() ) return;
+
+    int colon = setting.lastIndexOf(':');
+    directoryHost = setting;
+    // host, host:port, or [IPv6]:port
+    if( colon > 0 && (setting.count(':') == 1 || setting.at(colon-1) == ']') ) {
+        directoryHost = setting.left(colon);
+        directoryPort = static_cast<quint16>(setting.mid(colon+1).toUInt());
+        if( directoryPort == 0 ) directoryPort = DIRECTORY_PORT;
     }
+    directoryHost.remove('[').remove(']');
+
+    directory = new QTcpSocket(this);
+    connect(directory, &QTcpSocket::connected, this, &TibiDiscovery::directoryConnected);
+    connect(directory, &QTcpSocket::disconnected, this, &TibiDiscovery::directoryLost);
+    connect(directory, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this, &TibiDiscovery::directoryLost);
+    connect(directory, &QTcpSocket::readyRead, this, &TibiDiscovery::readDirectory);
+    connectDirectory();
+}
 
-    qDebug() << QThread::currentThreadId() << " - TIBI DISCOVERY creato nuovo avatar array";
+void TibiDiscovery::connectDirectory() {
+    if( directory == nullptr || directory->state() != QAbstractSocket::UnconnectedState ) return;
+    qDebug() << QThread::currentThreadId() << " - TIBI DISCOVERY connecting to the directory" << directoryHost << directoryPort;
+    directoryBuffer.clear();
+    directory->connectToHost(directoryHost, directoryPort);
+}
 
+void TibiDiscovery::directoryConnected() {
+    if( !ownBeacon.isEmpty() ) directory->write(TibiDirectory::registerFrame(ownBeacon));
+}
+
+void TibiDiscovery::directoryLost() {
+    if( directory == nullptr || directoryRetrying ) return;
+    directoryRetrying = true;
+    // the tibiers known through the directory expire as if they stopped beaconing
+    for( const QUuid& id : directoryPeers ) {
+        user->vouchTibier(id, false);
+    }
+    directoryPeers.clear();
+    directory->abort();
+    QTimer::singleShot(DIRECTORY_RETRY_TIME, this, [this]() {
+        directoryRetrying = false;
+        connectDirectory();
+    });
+}
+
+void TibiDiscovery::registerBeacon(const QByteArray& beacon) {
+    ownBeacon = beacon;
+    if( directory != nullptr && directory->state() == QAbstractSocket::ConnectedState ) directory->write(TibiDirectory::registerFrame(beacon));
+}
+
+void TibiDiscovery::readDirectory() {
+    directoryBuffer.append(directory->readAll());
+    QByteArray payload;
+    bool invalid = false;
+    while( SwarmServer::takeFrame(directoryBuffer, payload, invalid) ) {
+        readDirectoryFrame(payload);
+    }
+    if( invalid ) directoryLost();
+}
+
+void TibiDiscovery::readDirectoryFrame(const QByteArray& payload) {
+    quint8 kind = 0;
+    QHostAddress address;
+    QByteArray beacon;
+    QUuid id;
+    if( !TibiDirectory::readFrame(payload, kind, address, beacon, id) ) return;
+
+    if( kind == TibiDirectory::Gone ) {
+        // it expires as if it stopped beaconing
+        directoryPeers.remove(id);
+        user->vouchTibier(id, false);
+        return;
+    }
+    directoryPeers.insert(id);
+    reader->readBeacon(beacon.constData(), beacon.size(), address);
+    // a new tibier is vouched for once its profile arrives, see profileFetched
+    user->vouchTibier(id, true);
+}
+
+void TibiDiscovery::readQuery(const char* datagram, qint64 size, const QHostAddress& sender) {
+    QUuid asker = TibiBeacon::peekQuery(datagram, size);
+    if( asker.isNull() || asker == user->getId() ) return;
+    emit queryReceived(sender);
+}
+
+void TibiDiscovery::profileFetched(QSharedPointer<Tibier> tibier, QSharedPointer<QByteArray> avatarArray) {
+    if( !avatarArray->isEmpty() ) user->saveNewTibierAvatar(tibier->id, tibier->avatarPath, avatarArray);
+
+    Tibier known;
+    if( tibier->username.isNull() && user->lookupTibier(tibier->id, known) ) {
+        // only the avatar was requested
+        tibier->username = known.username;
+    }
+    if( tibier->username.isNull() ) return;
+
+    tibier->lastPing = QDateTime::currentSecsSinceEpoch();
+    qDebug() << QThread::currentThreadId() << " - TIBI DISCOVERY profile received from" << tibier->username;
+    user->newPing(tibier);
+    if( directoryPeers.contains(tibier->id) ) user->vouchTibier(tibier->id, true);
 }
 
 
 void TibiDiscovery::closeSocket() {
-    if( ping != nullptr) delete ping;
-    if( data != nullptr) delete data;
     if( udpSocket4 != nullptr) delete udpSocket4;
+    if( udpSocket6 != nullptr) delete udpSocket6;
+    udpSocket4 = nullptr;
+    udpSocket6 = nullptr;
+    if( directory != nullptr ) {
+        directory->disconnect(this);
+        directory->abort();
+    }
     emit finished();
 }
-
-
@@ -1,4 +1,4 @@
-﻿/*
+/*
  * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
  *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
  * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
@@ -12,19 +12,45 @@
 #include <QUdpSocket>
 #include <QtNetwork>
 #include <QUuid>
+#include <QSet>
 #include "user/UserHandler.h"
+#include "network/TibiBeacon.h"
+#include "network/TibiBeaconReader.h"
+#include "network/TibiProfileFetcher.h"
+#include "network/TibiInterfaces.h"
+#include "network/TibiDirectory.h"
+#include "network/TibiLinkProber.h"
+
+#define MEMBERSHIP_REFRESH_TIME 30*1000
+#define QUERY_REPEAT_TIME 300
+#define MIN_TIME_BETWEEN_QUERIES 2000
+#define DIRECTORY_RETRY_TIME 10*1000
 
 
 /**
- * @brief The TibiDiscovery class, listen for TibiPing. If the avatar code is different from the one stored, the new avatar is downloaded.
+ * @brief The TibiDiscovery class, listen for the beacons of TibiPing.
+ * If the name hash of a tibier is unknown, or its avatar is not in the avatars directory yet, they are fetched once
+ * from its TibiProfileServer; in the meantime the tibier is kept with the profile already known. The round trip time to the online
+ * tibiers is measured by the TibiLinkProber owned by TibiDiscovery.
+ * The datagrams are read and applied by a TibiBeaconReader, with TibiDiscovery as its sink (the same reader is driven by TibiDiscoveryBench).
+ * The groups are joined on every active interface, over IPv4 and IPv6, and again every MEMBERSHIP_REFRESH_TIME ms for the new interfaces:
+ * the same beacon arriving from several interfaces is applied once.
+ * At start, and each time the tibiers are about to be shown, a query is multicast (again after QUERY_REPEAT_TIME ms, in case it is lost,
+ * and at most once every MIN_TIME_BETWEEN_QUERIES ms): the other tibiers answer with their beacon in unicast, without waiting for their next one.
+ * The queries of the others are passed to TibiPing with queryReceived.
+ * If the "directory" setting holds the host[:port] of a TibiDirectory, the beacons of TibiPing are registered there too, and the beacons
+ * it pushes are read as if they were received from the link. The directory only pushes the changes: while it is connected,
+ * its tibiers are vouched for (see UserHandler::vouchTibier) and stay online without beacons, until it announces them gone.
+ * The connection is retried every DIRECTORY_RETRY_TIME ms.
  */
 
-class TibiDiscovery : public QObject
+class TibiDiscovery : public QObject, public TibiBeaconSink
 {
     Q_OBJECT
 
 public:
     TibiDiscovery() {}
+    ~TibiDiscovery() override { delete reader; }
     void setUserInfo(UserHandler* user);
 
 public slots:
@@ -32,32 +58,66 @@ public slots:
     void startDiscovery();
     void closeSocket();
 
+    /**
+     * @brief sendQuery, asks the tibiers around to beacon now
+     */
+    void sendQuery();
+
+    /**
+     * @brief registerBeacon, sends the beacon just multicast by TibiPing to the directory, if any
+     */
+    void registerBeacon(const QByteArray& beacon);
+
 signals:
     void finished();
+    void queryReceived(QHostAddress asker);
 
 private:
     UserHandler* user = nullptr;
 
     /* -- NETWORK --*/
     QUdpSocket* udpSocket4 = nullptr;
+    QUdpSocket* udpSocket6 = nullptr;
     QHostAddress groupAddress4;
-    QDataStream* ping = nullptr;
-    QByteArray* data = nullptr;
-
-    /* -- PING RECEIVED --*/
-    QSharedPointer<Tibier> tibierPing;
-    int avatarSizePing = 0;
-    QSharedPointer<QByteArray> avatarArrayPing;
-
-    /* -- METHODS --*/
-    void readPing();
-    bool checkLoopback();
-    void checkIfNewAvatar();
-    bool checkIfNewTibier();
-    void createNewAvatarArray();
+    QHostAddress groupAddress6;
+    QSet<QString> joined4;
+    QSet<QString> joined6;
+    QTimer* membershipTimer = nullptr;
+    TibiProfileFetcher* fetcher = nullptr;
+    TibiLinkProber* prober = nullptr;
+    TibiBeaconReader* reader = nullptr;
+
+    /* -- QUERY --*/
+    QElapsedTimer lastQuery;
+
+    /* -- DIRECTORY --*/
+    QTcpSocket* directory = nullptr;
+    QString directoryHost;
+    quint16 directoryPort = DIRECTORY_PORT;
+    QByteArray directoryBuffer;
+    bool directoryRetrying = false;
+    QByteArray ownBeacon;
+    QSet<QUuid> directoryPeers;
+    void startDirectory();
+    void readDirectoryFrame(const QByteArray& payload);
+
+    /* -- BEACON SINK --*/
+    bool touchTibier(const QUuid& id, qint64 lastPing) override;
+    bool lookupTibier(const QUuid& id, Tibier& tibier) override;
+    void newPing(QSharedPointer<Tibier> tibier) override;
+    void fetchProfile(const Tibier& tibier, bool needName, bool needAvatar) override;
+    void readQuery(const char* datagram, qint64 size, const QHostAddress& sender) override;
 
 private slots:
     void processPendingDatagrams();
+    void processPendingDatagrams6();
+    void refreshMembership();
+    void writeQuery();
+    void connectDirectory();
+    void directoryConnected();
+    void directoryLost();
+    void readDirectory();
+    void profileFetched(QSharedPointer<Tibier> tibier, QSharedPointer<QByteArray> avatarArray);
 
 };
 
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TibiInterfaces.h"
+
+QList<QNetworkInterface> TibiInterfaces::multicastInterfaces() {
+    QList<QNetworkInterface> interfaces;
+    for( const QNetworkInterface& iface : QNetworkInterface::allInterfaces() ) {
+        QNetworkInterface::InterfaceFlags flags = iface.flags();
+        if( !(flags & QNetworkInterface::IsUp) || !(flags & QNetworkInterface::IsRunning) ) continue;
+        if( !(flags & QNetworkInterface::CanMulticast) || (flags & QNetworkInterface::IsLoopBack) ) continue;
+        interfaces.push_back(iface);
+    }
+    return interfaces;
+}
+
+QList<QHostAddress> TibiInterfaces::localAddresses() {
+    QList<QHostAddress> addresses;
+    for( const QNetworkInterface& iface : multicastInterfaces() ) {
+        for( const QNetworkAddressEntry& entry : iface.addressEntries() ) {
+            if( entry.ip().isLoopback() ) continue;
+            addresses.push_back(entry.ip());
+            if( addresses.size() == MAX_BEACON_ADDRESSES ) return addresses;
+        }
+    }
+    return addresses;
+}
+
+bool TibiInterfaces::hasIPv4(const QNetworkInterface& iface) {
+    for( const QNetworkAddressEntry& entry : iface.addressEntries() ) {
+        if( entry.ip().protocol() == QAbstractSocket::IPv4Protocol ) return true;
+    }
+    return false;
+}
+
+bool TibiInterfaces::hasIPv6(const QNetworkInterface& iface) {
+    for( const QNetworkAddressEntry& entry : iface.addressEntries() ) {
+        if( entry.ip().protocol() == QAbstractSocket::IPv6Protocol ) return true;
+    }
+    return false;
+}
+
+quint8 TibiInterfaces::mediumTowards(const QHostAddress& address) {
+    for( const QNetworkInterface& iface : QNetworkInterface::allInterfaces() ) {
+        if( !(iface.flags() & QNetworkInterface::IsUp) ) continue;
+        for( const QNetworkAddressEntry& entry : iface.addressEntries() ) {
+            if( entry.ip() == address ) return LinkStats::Local;
+            if( entry.prefixLength() < 0 || !address.isInSubnet(entry.ip(), entry.prefixLength()) ) continue;
+            switch( iface.type() ) {
+            case QNetworkInterface::Loopback: return LinkStats::Local;
+            case QNetworkInterface::Ethernet: return LinkStats::Wired;
+            case QNetworkInterface::Wifi: return LinkStats::Wireless;
+            case QNetworkInterface::Virtual:
+            case QNetworkInterface::Ppp: return LinkStats::Virtual;
+            default: return LinkStats::Routed;
+            }
+        }
+    }
+    return LinkStats::Routed;
+}
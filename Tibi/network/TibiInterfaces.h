@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIBIINTERFACES_H
+#define TIBIINTERFACES_H
+
+#include <QNetworkInterface>
+#include <QHostAddress>
+#include <QList>
+#include "user/LinkStats.h"
+
+#define GROUP_ADDRESS4 "224.0.0.1"
+#define GROUP_ADDRESS6 "ff02::7469:6269"   // link-local scope, "tibi"
+#define DISCOVERY_PORT 45454
+#define MAX_BEACON_ADDRESSES 16
+
+/**
+ * @brief The TibiInterfaces class lists the network interfaces and addresses Tibi uses:
+ * every interface that is up, running and can multicast, except the loopback.
+ */
+class TibiInterfaces
+{
+public:
+    static QList<QNetworkInterface> multicastInterfaces();
+
+    /**
+     * @brief localAddresses, the IPv4 and IPv6 addresses of the multicast interfaces, at most MAX_BEACON_ADDRESSES
+     */
+    static QList<QHostAddress> localAddresses();
+
+    static bool hasIPv4(const QNetworkInterface& iface);
+    static bool hasIPv6(const QNetworkInterface& iface);
+
+    /**
+     * @brief mediumTowards, the LinkStats::Medium of the local interface on the subnet of address
+     */
+    static quint8 mediumTowards(const QHostAddress& address);
+
+};
+
+#endif // TIBIINTERFACES_H
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TibiLinkProber.h"
+
+TibiLinkProber::TibiLinkProber(UserHandler* user, QObject* parent) :
+    QObject(parent),
+    user(user)
+{
+    connect(&tickTimer, &QTimer::timeout, this, &TibiLinkProber::probeStale);
+    tickTimer.start(LINK_PROBE_TICK);
+}
+
+void TibiLinkProber::probeStale() {
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+    int started = 0;
+    for( const Tibier& tibier : *user->readCurrentlyConnectedTibiers() ) {
+        if( started >= LINK_PROBES_PER_TICK ) break;
+        if( !(tibier.capabilities & TibiBeacon::Profile) || tibier.profilePort == 0 ) continue;
+        if( now - tibier.link.probed < LINK_PROBE_AGE || probes.values().contains(tibier.id) ) continue;
+        probe(tibier);
+        started++;
+    }
+}
+
+void TibiLinkProber::probe(const Tibier& tibier) {
+    QTcpSocket* socket = new QTcpSocket(this);
+    probes.insert(socket, tibier.id);
+    QSharedPointer<QElapsedTimer> rtt(new QElapsedTimer);
+
+    connect(socket, &QTcpSocket::connected, this, [=]() { finish(socket, rtt->nsecsElapsed()); });
+    connect(socket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this, [=]() { finish(socket, -1); });
+    QTimer::singleShot(LINK_PROBE_TIMEOUT, socket, [=]() { finish(socket, -1); });
+
+    rtt->start();
+    socket->connectToHost(tibier.address, static_cast<quint16>(tibier.profilePort));
+}
+
+void TibiLinkProber::finish(QTcpSocket* socket, qint64 rttNsecs) {
+    if( !probes.contains(socket) ) return;
+    QUuid id = probes.take(socket);
+    QHostAddress address = socket->peerAddress();
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+
+    // an unreachable tibier is probed again after LINK_PROBE_AGE s like the others: its stats are left as they are
+    if( rttNsecs < 0 ) {
+        user->recordRtt(id, -1, LinkStats::Routed);
+        return;
+    }
+    user->recordRtt(id, rttNsecs / 1e6, TibiInterfaces::mediumTowards(address));
+}
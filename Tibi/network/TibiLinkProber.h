@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIBILINKPROBER_H
+#define TIBILINKPROBER_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "user/UserHandler.h"
+#include "network/TibiBeacon.h"
+#include "network/TibiInterfaces.h"
+
+#define LINK_PROBE_TICK 2000
+#define LINK_PROBE_AGE 60               // s
+#define LINK_PROBES_PER_TICK 4
+#define LINK_PROBE_TIMEOUT 3000
+
+/**
+ * @brief The TibiLinkProber class measures the round trip time to the online tibiers, for their LinkStats.
+ * A probe is a TCP handshake with the TibiProfileServer of the tibier, closed as soon as it completes: it costs the other tibier
+ * nothing more than an accepted connection, and needs no support from it. Every LINK_PROBE_TICK ms, at most LINK_PROBES_PER_TICK
+ * tibiers not probed in the last LINK_PROBE_AGE s are probed, so a new tibier is measured within a few seconds,
+ * without flooding a large network. It lives in the thread of TibiDiscovery.
+ */
+class TibiLinkProber : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TibiLinkProber(UserHandler* user, QObject* parent = nullptr);
+
+public slots:
+    void probeStale();
+
+private:
+    UserHandler* user;
+    QTimer tickTimer;
+    QHash<QTcpSocket*, QUuid> probes;
+
+    void probe(const Tibier& tibier);
+    void finish(QTcpSocket* socket, qint64 rttNsecs);
+
+};
+
+#endif // TIBILINKPROBER_H
@@ -10,7 +10,6 @@
 void TibiPing::setUserInfo(UserHandler* user) {
     this->user = user;
     id = user->getId();
-    address = user->getAddress().toString();
     port = user->getPort();
     avatarPath = user->getAvatarPath();
     avatarCode = user->getAvatarCode();
@@ -19,20 +18,34 @@ void TibiPing::setUserInfo(UserHandler* user) {
 void TibiPing::startPing() {
     qDebug() << QThread::currentThreadId() << " - TIBI PING start sending";
 
-    groupAddress4.setAddress("224.0.0.1");
+    groupAddress4.setAddress(GROUP_ADDRESS4);
     udpSocket4 = new QUdpSocket;
     connect(this, &TibiPing::finished, udpSocket4, &QUdpSocket::deleteLater);
     udpSocket4->bind(QHostAddress(QHostAddress::AnyIPv4), 0);
     udpSocket4->setSocketOption(QAbstractSocket::MulticastTtlOption, 5);
-    qDebug() << "Ready to multicast ping to group " << groupAddress4.toString() << "@" << "45454";
+
+    groupAddress6.setAddress(GROUP_ADDRESS6);
+    udpSocket6 = new QUdpSocket;
+    connect(this, &TibiPing::finished, udpSocket6, &QUdpSocket::deleteLater);
+    if( !udpSocket6->bind(QHostAddress(QHostAddress::AnyIPv6), 0) ) {
+        qDebug() << "No IPv6 ping: " << udpSocket6->errorString();
+    }
+    qDebug() << "Ready to multicast ping to groups " << groupAddress4.toString() << groupAddress6.toString() << "@" << DISCOVERY_PORT;
+
+    profileServer = new TibiProfileServer(user);
+    connect(this, &TibiPing::finished, profileServer, &TibiProfileServer::deleteLater);
+    if( !profileServer->listen(QHostAddress::Any) ) {
+        emit error("profile server", profileServer->errorString());
+    }
 
     updateAvatar(user->getAvatarCode());
     timer = new QTimer;
+    timer->setSingleShot(true);
     connect(this, &TibiPing::finished, timer, &QTimer::deleteLater);
     connect(timer, &QTimer::timeout, this, &TibiPing::sendDatagram);
 
     if( user->getStatus() ) {
-        timer->start(TIME_PING);
+        sendNow();
     }
 
 
@@ -40,7 +53,7 @@ void TibiPing::startPing() {
             << "PING: "
             << "\n id: " << id.toString()
             << "\n username: " << user->getUsername()
-            << "\n address: " << address
+            << "\n profile port: " << profileServer->serverPort()
             << "\n port: " << port
             << "\n avatar code: " << user->getAvatarCode();
 
@@ -49,57 +62,137 @@ void TibiPing::startPing() {
 
 bool TibiPing::updateAvatar(qint8 code) {
     avatarCode = code;
-    if(avatarCode == 0 ) return true; //default avatar
-    QFile file(avatarPath + ".jpg");
     avatarArray.clear();
-    if( ! file.open(QIODevice::ReadOnly) ) {
-        avatarCode = 0;
-        return false;
+    avatarHash = 0;
+    if(avatarCode != 0 ) {
+        QFile file(avatarPath + ".jpg");
+        if( file.open(QIODevice::ReadOnly) ) {
+            avatarArray = file.readAll();
+            avatarHash = TibiBeacon::hash32(avatarArray);
+            qDebug() << "Avatar array size: " << avatarArray.size();
+        } else {
+            avatarCode = 0;
+        }
+    }
+    if( profileServer != nullptr ) profileServer->setAvatar(avatarArray, avatarHash);
+    if( timer != nullptr && user->getStatus() ) sendNow();
+    return avatarCode == code;
+
+}
+
+QByteArray TibiPing::beaconDatagram() {
+    QString username = user->getUsername();
+    if( username != hashedUsername || nameHash == 0 ) {
+        hashedUsername = username;
+        nameHash = TibiBeacon::hash32(username.toUtf8());
     }
-    avatarArray.insert(0, file.readAll());
-    qDebug() << "Avatar array size: " << avatarArray.size();
-    return true;
 
+    TibiBeacon beacon;
+    beacon.capabilities = TibiBeacon::Transfers | TibiBeacon::Profile | TibiBeacon::ItemCount | TibiBeacon::Multicast | TibiBeacon::Swarm;
+    beacon.id = id;
+    beacon.port = port;
+    beacon.profilePort = profileServer->serverPort();
+    beacon.nameHash = nameHash;
+    beacon.avatarHash = avatarHash;
+    beacon.interval = static_cast<quint16>((interval + 999) / 1000);
+    beacon.addresses = TibiInterfaces::localAddresses();
+    return beacon.encode();
 }
 
 void TibiPing::sendDatagram() {
     //qDebug() << "\nNow sending ping ";
-
-    QByteArray datagram;
-    QDataStream ping(&datagram, QIODevice::WriteOnly);
-
-    ping << id;
-    ping << user->getUsername();
-    ping << address;
-    ping << port;
-    ping << avatarCode;
-    if( avatarCode != 0 ) {
-        ping << avatarArray.size();
-        for( qint8 byte : avatarArray ) {
-            ping << byte;
+    // the beacon advertises the interval until the one after it, not the interval that led to it
+    updateInterval();
+    QByteArray datagram = beaconDatagram();
+
+    // the interfaces are read at every beacon: cables, Wi-Fi networks and VPNs come and go
+    for( const QNetworkInterface& iface : TibiInterfaces::multicastInterfaces() ) {
+        if( TibiInterfaces::hasIPv4(iface) ) {
+            udpSocket4->setMulticastInterface(iface);
+            udpSocket4->writeDatagram(datagram, groupAddress4, DISCOVERY_PORT);
+        }
+        if( TibiInterfaces::hasIPv6(iface) && udpSocket6->state() == QAbstractSocket::BoundState ) {
+            udpSocket6->setMulticastInterface(iface);
+            QHostAddress scopedGroup = groupAddress6;
+            scopedGroup.setScopeId(iface.name());
+            udpSocket6->writeDatagram(datagram, scopedGroup, DISCOVERY_PORT);
         }
     }
-    /*
-    qDebug()
-    << "\nPING size: " << datagram.size()
-    << "\n id: " << user.id.toString()
-    << "\n username: " << user.username
-    << "\n address: " << user.address.toString()
-    << "\n port: " << user.port;
+    lastBeacon.start();
+    emit beaconSent(datagram);
+    scheduleNext();
 
-*/
-    udpSocket4->writeDatagram(datagram, groupAddress4, 45454);
+}
 
-    //qDebug() << "Bytes sent: " << sent;
+void TibiPing::updateInterval() {
+    int tibiers = user->countOnlineTibiers() + 1;
+    interval = qBound(TIME_PING, tibiers * 1000 / TARGET_BEACONS_PER_SECOND, MAX_TIME_PING);
+}
 
+void TibiPing::scheduleNext() {
+    // the advertised interval is the nominal one: the jitter can only make it shorter than advertised
+    double jitter = 1 - PING_JITTER * QRandomGenerator::global()->generateDouble();
+    timer->start(static_cast<int>(interval * jitter));
 }
 
+void TibiPing::sendNow() {
+    if( timer == nullptr || !user->getStatus() ) return;
+    qint64 sinceLast = lastBeacon.isValid() ? lastBeacon.elapsed() : MIN_TIME_BETWEEN_BEACONS;
+    if( sinceLast >= MIN_TIME_BETWEEN_BEACONS ) {
+        timer->stop();
+        sendDatagram();
+        return;
+    }
+    int wait = static_cast<int>(MIN_TIME_BETWEEN_BEACONS - sinceLast);
+    if( !timer->isActive() || timer->remainingTime() > wait ) timer->start(wait);
+}
+
+
+void TibiPing::answerQuery(QHostAddress asker) {
+    if( timer == nullptr || !user->getStatus() ) return;
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if( now - lastReplies.value(asker, 0) < MIN_TIME_BETWEEN_REPLIES ) return;
+    if( !repliesSecond.isValid() || repliesSecond.elapsed() >= 1000 ) {
+        repliesSecond.start();
+        repliesInSecond = 0;
+    }
+    if( repliesInSecond >= MAX_REPLIES_PER_SECOND ) return;
+    repliesInSecond++;
+
+    if( lastReplies.size() > MAX_REPLY_ASKERS ) {
+        for( auto last = lastReplies.begin(); last != lastReplies.end(); ) {
+            if( now - last.value() >= MIN_TIME_BETWEEN_REPLIES ) last = lastReplies.erase(last);
+            else ++last;
+        }
+    }
+    lastReplies.insert(asker, now);
+
+    // the replies of all the tibiers are spread over the window, instead of reaching the asker together
+    int tibiers = user->countOnlineTibiers() + 1;
+    int window = qBound(MIN_REPLY_WINDOW, tibiers * 1000 / TARGET_REPLIES_PER_SECOND, MAX_REPLY_WINDOW);
+    qint64 delay = QRandomGenerator::global()->bounded(window);
+    QTimer::singleShot(static_cast<int>(delay), this, [this, asker, delay]() { sendReply(asker, delay); });
+}
+
+void TibiPing::sendReply(const QHostAddress& asker, qint64 delay) {
+    if( timer == nullptr || !user->getStatus() ) return;
+    // a beacon multicast after the query reached the asker as well
+    if( lastBeacon.isValid() && lastBeacon.elapsed() <= delay ) return;
+
+    QByteArray datagram = beaconDatagram();
+    if( asker.protocol() == QAbstractSocket::IPv6Protocol ) {
+        if( udpSocket6->state() == QAbstractSocket::BoundState ) udpSocket6->writeDatagram(datagram, asker, DISCOVERY_PORT);
+    } else {
+        udpSocket4->writeDatagram(datagram, asker, DISCOVERY_PORT);
+    }
+}
 
 void TibiPing::updateStatus(bool online) {
     if (!online) {
         timer->stop();
     } else {
-        timer->start(TIME_PING);
+        sendNow();
     }
 }
 
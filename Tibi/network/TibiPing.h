@@ -13,19 +13,34 @@
 #include <QTimer>
 #include <QUuid>
 #include "user/UserHandler.h"
+#include "network/TibiBeacon.h"
+#include "network/TibiProfileServer.h"
+#include "network/TibiInterfaces.h"
 
 #define TIME_PING 5000
+#define MAX_TIME_PING 60*1000
+#define TARGET_BEACONS_PER_SECOND 20
+#define PING_JITTER 0.25
+#define MIN_TIME_BETWEEN_BEACONS 1000
+#define MIN_REPLY_WINDOW 200
+#define MAX_REPLY_WINDOW 3000
+#define TARGET_REPLIES_PER_SECOND 200
+#define MIN_TIME_BETWEEN_REPLIES 2000
+#define MAX_REPLIES_PER_SECOND 20
+#define MAX_REPLY_ASKERS 1024
 
 /**
- * @brief The TibiPing class, if online sends a ping every 5 seconds.
- * Ping structure:
- * ID           QUuid - 128 bit - 16-bytes
- * USERNAME     QString
- * ADDRESS      QString
- * PORT         int
- * AVATAR CODE  qint8
- * AVATAR SIZE  qint64
- * ABATAR ARRAY qByteArray
+ * @brief The TibiPing class, if online multicasts a TibiBeacon.
+ * The interval grows with the number of online tibiers, so that the whole network sends about TARGET_BEACONS_PER_SECOND
+ * beacons (never less than TIME_PING, never more than MAX_TIME_PING), with a random jitter of PING_JITTER so that
+ * the tibiers don't beacon in lockstep. The interval is advertised in the beacon, and the other tibiers use it to decide when
+ * we are gone. A change of status, username or avatar is beaconed immediately, at most once every MIN_TIME_BETWEEN_BEACONS.
+ * The beacon only carries the hashes of username and avatar: they are served once, on request, by the TibiProfileServer owned by TibiPing.
+ * It is sent on every active interface (TibiInterfaces), to GROUP_ADDRESS4 and to the link-local GROUP_ADDRESS6, and lists all the local addresses.
+ * A query of TibiDiscovery is answered with the beacon in unicast, after a random delay in a window that grows with the online tibiers
+ * (so that the network sends about TARGET_REPLIES_PER_SECOND replies to the asker, within MIN_REPLY_WINDOW and MAX_REPLY_WINDOW ms).
+ * The replies are rate limited: once every MIN_TIME_BETWEEN_REPLIES ms to the same tibier, MAX_REPLIES_PER_SECOND in total,
+ * and none if a multicast beacon has been sent in the meantime.
  */
 
 class TibiPing : public QObject
@@ -42,29 +57,62 @@ public slots:
     bool updateAvatar(qint8 code);
     void closeSocket();
 
+    /**
+     * @brief sendNow, sends a beacon as soon as MIN_TIME_BETWEEN_BEACONS allows
+     */
+    void sendNow();
+
+    /**
+     * @brief answerQuery, schedules the beacon in unicast to the tibier asking
+     */
+    void answerQuery(QHostAddress asker);
+
 signals:
     void error(const QString& object, const QString& error);
     void finished();
 
+    /**
+     * @brief beaconSent, the beacon just multicast, registered by TibiDiscovery in the directory
+     */
+    void beaconSent(const QByteArray& beacon);
+
 
 private:
     /* --- NETWORK ATTRIBUTES --*/
     QUdpSocket* udpSocket4 = nullptr;
+    QUdpSocket* udpSocket6 = nullptr;
     QHostAddress groupAddress4;
+    QHostAddress groupAddress6;
 
     /* --- PING INFO -- */
     UserHandler* user = nullptr;
         // immutable
     QUuid id;
-    QString address;
     int port;
         // mutable
     qint8 avatarCode;
     QString avatarPath;
     QByteArray avatarArray;
+    quint32 avatarHash = 0;
+    QString hashedUsername;
+    quint32 nameHash = 0;
+
+    /* --- PROFILE -- */
+    TibiProfileServer* profileServer = nullptr;
 
     /* --- TIMER FOR PING -- */
     QTimer* timer = nullptr;
+    QElapsedTimer lastBeacon;
+    int interval = TIME_PING;
+    void updateInterval();
+    void scheduleNext();
+    QByteArray beaconDatagram();
+
+    /* --- REPLIES TO THE QUERIES -- */
+    QHash<QHostAddress, qint64> lastReplies;     // ms since epoch
+    QElapsedTimer repliesSecond;
+    int repliesInSecond = 0;
+    void sendReply(const QHostAddress& asker, qint64 delay);
 
 private slots:
     void sendDatagram();
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TibiProfileFetcher.h"
+
+void TibiProfileFetcher::fetch(const Tibier& tibier, bool name, bool avatar) {
+    if( fetching.contains(tibier.id) ) return;
+
+    Request request;
+    request.tibier = QSharedPointer<Tibier>(new Tibier(tibier));
+    request.flags = (name ? PROFILE_NAME : 0) | (avatar ? PROFILE_AVATAR : 0);
+
+    QTcpSocket* socket = new QTcpSocket(this);
+    requests.insert(socket, request);
+    fetching.insert(tibier.id);
+
+    connect(socket, &QTcpSocket::connected, this, [=]() {
+        QByteArray out(PROFILE_REQUEST_SIZE, 0);
+        uchar* data = reinterpret_cast<uchar*>(out.data());
+        qToBigEndian<quint32>(BEACON_MAGIC, data);
+        data[4] = BEACON_VERSION;
+        data[5] = requests.value(socket).flags;
+        socket->write(out);
+    });
+    connect(socket, &QTcpSocket::readyRead, this, [=]() { readResponse(socket); });
+    connect(socket, &QTcpSocket::disconnected, this, [=]() {
+        // the server closes right after the response
+        readResponse(socket);
+        endRequest(socket);
+    });
+    connect(socket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this, [=]() { endRequest(socket); });
+    QTimer::singleShot(PROFILE_TIMEOUT, socket, [=]() { endRequest(socket); });
+
+    socket->connectToHost(tibier.address, tibier.profilePort);
+}
+
+bool TibiProfileFetcher::isFetching(const QUuid& id) const {
+    return fetching.contains(id);
+}
+
+void TibiProfileFetcher::readResponse(QTcpSocket* socket) {
+    if( !requests.contains(socket) ) return;
+    Request& request = requests[socket];
+    request.buffer.append(socket->readAll());
+    if( request.buffer.size() < static_cast<int>(sizeof(quint32)) ) return;
+
+    quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(request.buffer.constData()));
+    if( size > MAX_PROFILE_SIZE ) {
+        endRequest(socket);
+        return;
+    }
+    if( static_cast<quint32>(request.buffer.size()) - sizeof(quint32) < size ) return;
+
+    QDataStream in(request.buffer.mid(sizeof(quint32), size));
+    in.setVersion(QDataStream::Qt_5_12);
+    quint32 nameHash, avatarHash;
+    QString username;
+    QSharedPointer<QByteArray> avatarArray(new QByteArray);
+    in >> nameHash >> username >> avatarHash >> *avatarArray;
+
+    QSharedPointer<Tibier> tibier = request.tibier;
+    quint8 flags = request.flags;
+    bool valid = in.status() == QDataStream::Ok;
+    // the profile must be the one announced by the beacon, otherwise it changed in the meantime and the next beacon will tell
+    if( flags & PROFILE_NAME ) valid = valid && nameHash == tibier->nameHash && TibiBeacon::hash32(username.toUtf8()) == nameHash;
+    if( flags & PROFILE_AVATAR ) valid = valid && avatarHash == tibier->avatarHash && TibiBeacon::hash32(*avatarArray) == avatarHash;
+
+    endRequest(socket);
+    if( !valid ) return;
+
+    if( flags & PROFILE_NAME ) tibier->username = username;
+    emit profileFetched(tibier, avatarArray);
+}
+
+void TibiProfileFetcher::endRequest(QTcpSocket* socket) {
+    if( !requests.contains(socket) ) return;
+    fetching.remove(requests.value(socket).tibier->id);
+    requests.remove(socket);
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIBIPROFILEFETCHER_H
+#define TIBIPROFILEFETCHER_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QSharedPointer>
+#include "user/tibier.h"
+#include "network/TibiProfileServer.h"
+
+/**
+ * @brief The TibiProfileFetcher class asks a TibiProfileServer the username and/or the avatar of a tibier.
+ * There is at most one request per tibier: the beacons received while it runs don't start another one,
+ * and a failed request is simply retried at the next beacon. It lives in the thread of TibiDiscovery.
+ */
+class TibiProfileFetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TibiProfileFetcher(QObject* parent = nullptr) : QObject(parent) {}
+
+    /**
+     * @brief fetch, starts a request to the profile server of the tibier
+     * @param tibier, the tibier read from the beacon (address, profilePort, nameHash and avatarHash are used)
+     */
+    void fetch(const Tibier& tibier, bool name, bool avatar);
+    bool isFetching(const QUuid& id) const;
+
+signals:
+    /**
+     * @brief profileFetched, the username and avatar were received and match the hashes of the beacon
+     * @param tibier, the tibier of the request with the username filled (if requested)
+     * @param avatarArray, the avatar (if requested)
+     */
+    void profileFetched(QSharedPointer<Tibier> tibier, QSharedPointer<QByteArray> avatarArray);
+
+private:
+    class Request {
+    public:
+        QSharedPointer<Tibier> tibier;
+        quint8 flags = 0;
+        QByteArray buffer;
+    };
+
+    QHash<QTcpSocket*, Request> requests;
+    QSet<QUuid> fetching;
+
+    void readResponse(QTcpSocket* socket);
+    void endRequest(QTcpSocket* socket);
+
+};
+
+#endif // TIBIPROFILEFETCHER_H
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TibiProfileServer.h"
+
+TibiProfileServer::TibiProfileServer(UserHandler* user, QObject* parent) :
+    QTcpServer(parent),
+    user(user)
+{
+    connect(this, &QTcpServer::newConnection, this, &TibiProfileServer::newProfileRequest);
+}
+
+void TibiProfileServer::setAvatar(const QByteArray& avatarArray, quint32 avatarHash) {
+    this->avatarArray = avatarArray;
+    this->avatarHash = avatarHash;
+}
+
+void TibiProfileServer::newProfileRequest() {
+    while( hasPendingConnections() ) {
+        QTcpSocket* socket = nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [=]() { answerRequest(socket); });
+        // a request never takes long: whoever doesn't send it is dropped
+        QTimer::singleShot(PROFILE_TIMEOUT, socket, [=]() { socket->abort(); });
+    }
+}
+
+void TibiProfileServer::answerRequest(QTcpSocket* socket) {
+    if( socket->bytesAvailable() < PROFILE_REQUEST_SIZE ) return;
+    disconnect(socket, &QTcpSocket::readyRead, this, nullptr);
+
+    QByteArray request = socket->read(PROFILE_REQUEST_SIZE);
+    const uchar* in = reinterpret_cast<const uchar*>(request.constData());
+    if( qFromBigEndian<quint32>(in) != BEACON_MAGIC ) {
+        socket->abort();
+        return;
+    }
+    quint8 flags = in[5];
+
+    QString username = user->getUsername();
+    QByteArray body;
+    QDataStream out(&body, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << TibiBeacon::hash32(username.toUtf8());
+    out << ((flags & PROFILE_NAME) ? username : QString());
+    out << avatarHash;
+    out << ((flags & PROFILE_AVATAR) ? avatarArray : QByteArray());
+
+    QByteArray size(sizeof(quint32), 0);
+    qToBigEndian<quint32>(body.size(), reinterpret_cast<uchar*>(size.data()));
+    socket->write(size);
+    socket->write(body);
+    socket->disconnectFromHost();
+}
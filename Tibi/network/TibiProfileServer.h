@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIBIPROFILESERVER_H
+#define TIBIPROFILESERVER_H
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QDataStream>
+#include <QTimer>
+#include "user/UserHandler.h"
+#include "network/TibiBeacon.h"
+
+#define PROFILE_NAME 0x01
+#define PROFILE_AVATAR 0x02
+#define PROFILE_REQUEST_SIZE 6
+#define PROFILE_TIMEOUT 5000
+#define MAX_PROFILE_SIZE 4*1024*1024
+
+/**
+ * @brief The TibiProfileServer class serves the username and the avatar of the user to the tibiers
+ * that received a beacon with a hash they don't know. It lives in the thread of TibiPing.
+ * Request:
+ * MAGIC        quint32 - "TIBI"
+ * VERSION      quint8
+ * FLAGS        quint8 - PROFILE_NAME | PROFILE_AVATAR
+ * Response (QDataStream):
+ * SIZE         quint32 - size of the rest of the response
+ * NAME HASH    quint32
+ * USERNAME     QString - null if not requested
+ * AVATAR HASH  quint32
+ * AVATAR       QByteArray - empty if not requested or default avatar
+ */
+class TibiProfileServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    explicit TibiProfileServer(UserHandler* user, QObject* parent = nullptr);
+    void setAvatar(const QByteArray& avatarArray, quint32 avatarHash);
+
+private:
+    UserHandler* user;
+    QByteArray avatarArray;
+    quint32 avatarHash = 0;
+
+private slots:
+    void newProfileRequest();
+    void answerRequest(QTcpSocket* socket);
+
+};
+
+#endif // TIBIPROFILESERVER_H
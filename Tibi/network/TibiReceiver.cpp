@@ -6,17 +6,96 @@
  */
 
 #include "TibiReceiver.h"
-
+#include <QSettings>
 
 #include <stdlib.h>
 
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
 void TibiReceiver::startReceiver() {
+    // every interface, IPv4 and IPv6: the sender chooses the path among the addresses in our beacon
+    listenSharded(0);
     QHostAddress ipAddress = getIpAddress();
-    listen(ipAddress);
-    emit receiverRunningAt(serverAddress(), serverPort());
+    emit receiverRunningAt(ipAddress, serverPort());
 
     qDebug() << "Receiver listening on IP:" << serverAddress().toString()
-             << "@" << serverPort();
+             << "@" << serverPort() << " - main address " << ipAddress.toString();
+}
+
+void TibiReceiver::startShard(quint16 port) {
+    if( !listenSharded(port) ) {
+        qDebug() << "Receiver shard" << shard << "failed to bind port" << port;
+        return;
+    }
+    qDebug() << "Receiver shard" << shard << "listening @" << serverPort();
+}
+
+int TibiReceiver::shardsCount(int poolSize) {
+#ifdef Q_OS_LINUX
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    int shards = settings.value("receiverShards", qMin(poolSize, MAX_RECEIVER_SHARDS)).toInt();
+    return qBound(1, shards, qMax(1, poolSize));
+#else
+    Q_UNUSED(poolSize);
+    return 1;
+#endif
+}
+
+int TibiReceiver::backlog() {
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    return qBound(1, settings.value("receiverBacklog", RECEIVER_BACKLOG).toInt(), MAX_RECEIVER_BACKLOG);
+}
+
+bool TibiReceiver::listenSharded(quint16 port) {
+    int pending = backlog();
+    setMaxPendingConnections(pending);
+
+#ifdef Q_OS_LINUX
+    // QTcpServer::listen has a fixed backlog and no SO_REUSEPORT: the socket is prepared here and then adopted
+    int fd = ::socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    bool v6 = fd >= 0;
+    if( !v6 ) fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if( fd >= 0 ) {
+        int on = 1;
+        int off = 0;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+        int bound;
+        if( v6 ) {
+            // dual stack, as QHostAddress::Any
+            ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+            sockaddr_in6 address;
+            memset(&address, 0, sizeof(address));
+            address.sin6_family = AF_INET6;
+            address.sin6_addr = in6addr_any;
+            address.sin6_port = htons(port);
+            bound = ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        } else {
+            sockaddr_in address;
+            memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            address.sin_port = htons(port);
+            bound = ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        }
+
+        if( bound == 0 && ::listen(fd, pending) == 0 && setSocketDescriptor(fd) ) return true;
+
+        qDebug() << "Receiver shard" << shard << ": SO_REUSEPORT listener unavailable, falling back to QTcpServer";
+        ::close(fd);
+    }
+#endif
+
+    // shard 0 only: the other shards cannot share the port without SO_REUSEPORT
+    if( port != 0 && shard != 0 ) return false;
+    return listen(QHostAddress::Any, port);
 }
 
 QHostAddress TibiReceiver::getIpAddress() {
@@ -35,7 +114,7 @@ QHostAddress TibiReceiver::getIpAddress() {
 
 void TibiReceiver::incomingConnection(qintptr socketDescriptor)
 {
-    qDebug() << "TIBI RECEIVER: A Tibier wants to send something!";
+    qDebug() << "TIBI RECEIVER" << shard << ": A Tibier wants to send something!";
 
     emit newDownloadRequest(socketDescriptor);
 
@@ -45,5 +124,3 @@ void TibiReceiver::closeReceiver() {
     close();
     emit receiverClosed();
 }
-
-
@@ -11,18 +11,42 @@
 #include <QTcpServer>
 #include <QNetworkInterface>
 
+#define RECEIVER_BACKLOG 128
+#define MAX_RECEIVER_BACKLOG 4096
+#define MAX_RECEIVER_SHARDS 4
+
+/**
+ * @brief The TibiReceiver class is one shard of the listener of the incoming transfers. It lives in a thread of the NetworkIOPool.
+ * On Linux all the shards bind the same port with SO_REUSEPORT, so the kernel spreads the incoming connections among them;
+ * elsewhere there is only shard 0. The listen backlog is read from the "receiverBacklog" setting.
+ * newDownloadRequest is emitted in the thread of the shard.
+ */
 class TibiReceiver : public QTcpServer
 {
     Q_OBJECT
 
 public:
-    TibiReceiver() : QTcpServer() {}
+    explicit TibiReceiver(int shard = 0) : QTcpServer(), shard(shard) {}
+
+    /**
+     * @brief shardsCount, the number of listeners to start, read from the "receiverShards" setting
+     * @param poolSize, the number of threads of the NetworkIOPool
+     */
+    static int shardsCount(int poolSize);
 
 protected:
     void incomingConnection(qintptr socketDescriptor) override;
 
 public slots:
+    /**
+     * @brief startReceiver, starts shard 0 on a free port and emits receiverRunningAt
+     */
     void startReceiver();
+
+    /**
+     * @brief startShard, starts an additional shard on the port of shard 0
+     */
+    void startShard(quint16 port);
     void closeReceiver();
 
 signals:
@@ -31,8 +55,17 @@ signals:
     void receiverClosed();
 
 private:
+    int shard;
+
     QHostAddress getIpAddress();
 
+    /**
+     * @brief listenSharded, listens on every interface with the configured backlog, sharing the port with the other shards where supported
+     * @return false if the port could not be bound
+     */
+    bool listenSharded(quint16 port);
+    static int backlog();
+
 };
 
 #endif // TIBIRECEIVER_H
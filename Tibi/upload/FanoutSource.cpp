@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "FanoutSource.h"
+
+FanoutSource::FanoutSource(const QString& itemPath) :
+    itemPath(itemPath)
+{
+}
+
+int FanoutSource::subscribe() {
+    QMutexLocker ml(&source_m);
+    int id = nextId++;
+    cursors.insert(id, 0);
+    return id;
+}
+
+void FanoutSource::unsubscribe(int id) {
+    QMutexLocker ml(&source_m);
+    cursors.remove(id);
+    dropConsumed();
+    changed.wakeAll();
+}
+
+void FanoutSource::scan() {
+    QMutexLocker ml(&source_m);
+    if( scanned ) return;
+
+    QFileInfo info(itemPath);
+    dir = info.isDir();
+    if( dir ) {
+        QDir root(itemPath);
+        size = scanDir(root, itemPath);
+    } else {
+        filePaths.push_back(itemPath);
+        fileSizes.push_back(info.size());
+        size = info.size();
+    }
+
+    // the chunks are numbered across the files
+    qint64 chunks = 0;
+    for( qint64 fileSize : fileSizes ) {
+        firstChunks.push_back(chunks);
+        chunks += (fileSize + FANOUT_CHUNK_SIZE - 1) / FANOUT_CHUNK_SIZE;
+    }
+    scanned = true;
+    qDebug() << "FANOUT: scanned" << itemPath << "-" << filePaths.size() << "files," << chunks << "chunks for" << cursors.size() << "tibiers";
+}
+
+qint64 FanoutSource::scanDir(const QDir& root, const QString& path) {
+    QDir dir(path);
+    qint64 dirSize = 0;
+
+    dir.setFilter(QDir::Files | QDir::Hidden);
+    for( auto file : dir.entryInfoList() ) {
+        filePaths.push_back(file.filePath());
+        fileSizes.push_back(file.size());
+        dirSize += file.size();
+    }
+
+    // as UploadHandler::getDirSize: the leaves are enough to recreate the tree
+    dir.setFilter(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden);
+    if( dir.entryInfoList().isEmpty() && dir != root ) {
+        leaves.push_back(root.relativeFilePath(dir.path()));
+        return dirSize;
+    }
+    for( auto child : dir.entryInfoList() ) {
+        dirSize += scanDir(root, child.filePath());
+    }
+    return dirSize;
+}
+
+bool FanoutSource::isDir() const {
+    QMutexLocker ml(&source_m);
+    return dir;
+}
+
+qint64 FanoutSource::totalSize() const {
+    QMutexLocker ml(&source_m);
+    return size;
+}
+
+const QVector<QString>& FanoutSource::files() const {
+    // immutable once scanned
+    return filePaths;
+}
+
+const QVector<QString>& FanoutSource::dirLeaves() const {
+    return leaves;
+}
+
+qint64 FanoutSource::fileSize(int fileIndex) const {
+    return fileSizes.at(fileIndex);
+}
+
+qint64 FanoutSource::chunkIndex(int fileIndex, qint64 offset) const {
+    return firstChunks.at(fileIndex) + offset / FANOUT_CHUNK_SIZE;
+}
+
+bool FanoutSource::chunk(int id, qint64 index, QByteArray& data) {
+    QMutexLocker ml(&source_m);
+    data.clear();
+    if( !cursors.contains(id) ) return false;
+
+    if( cursors.value(id) != index ) {
+        // everything before index has been consumed by this subscriber
+        cursors[id] = index;
+        dropConsumed();
+        changed.wakeAll();
+    }
+
+    if( window.contains(index) ) {
+        data = window.value(index);
+        return true;
+    }
+
+    if( index < nextChunk ) {
+        // already dropped: it can only be read again from disk
+        cursors.remove(id);
+        dropConsumed();
+        return false;
+    }
+
+    if( reading || index > nextChunk ) {
+        // someone else is reading it (or the chunks before it)
+        changed.wait(&source_m, FANOUT_WAIT_TIME);
+        if( !cursors.contains(id) ) return false;
+        if( window.contains(index) ) data = window.value(index);
+        return true;
+    }
+
+    // this subscriber leads: bounded lag with the slowest one
+    if( nextChunk - minCursor() >= FANOUT_MAX_LAG ) {
+        if( !stalled.isValid() ) stalled.start();
+        if( stalled.elapsed() >= FANOUT_DETACH_TIME ) {
+            detachSlowest();
+        } else {
+            changed.wait(&source_m, FANOUT_WAIT_TIME);
+        }
+        return cursors.contains(id);
+    }
+    stalled.invalidate();
+
+    reading = true;
+    ml.unlock();
+    QByteArray read = readNext();
+    ml.relock();
+    reading = false;
+
+    if( read.isNull() ) {
+        changed.wakeAll();
+        return false;
+    }
+    window.insert(nextChunk, read);
+    nextChunk++;
+    changed.wakeAll();
+    data = read;
+    return true;
+}
+
+QByteArray FanoutSource::readNext() {
+    // only the leader reads, outside the mutex: the file state is not shared
+    // the last file starting at or before the chunk: the empty files, that have no chunks, are skipped
+    int fileIndex = static_cast<int>(std::upper_bound(firstChunks.begin(), firstChunks.end(), nextChunk) - firstChunks.begin()) - 1;
+    if( fileIndex < 0 ) return QByteArray();
+
+    if( fileIndex != readFileIndex ) {
+        readFile.close();
+        readFile.setFileName(filePaths.at(fileIndex));
+        if( !readFile.open(QIODevice::ReadOnly) ) {
+            qDebug() << "FANOUT: impossible to open" << filePaths.at(fileIndex);
+            return QByteArray();
+        }
+        readFileIndex = fileIndex;
+    }
+
+    qint64 offset = (nextChunk - firstChunks.at(fileIndex)) * FANOUT_CHUNK_SIZE;
+    if( readFile.pos() != offset ) readFile.seek(offset);
+    QByteArray read = readFile.read(FANOUT_CHUNK_SIZE);
+    if( read.isEmpty() ) return QByteArray();
+    return read;
+}
+
+qint64 FanoutSource::minCursor() const {
+    qint64 min = nextChunk;
+    for( qint64 cursor : cursors ) {
+        min = qMin(min, cursor);
+    }
+    return min;
+}
+
+void FanoutSource::dropConsumed() {
+    qint64 min = minCursor();
+    while( !window.isEmpty() && window.firstKey() < min ) {
+        window.erase(window.begin());
+    }
+}
+
+void FanoutSource::detachSlowest() {
+    qint64 min = minCursor();
+    for( auto cursor = cursors.begin(); cursor != cursors.end(); ) {
+        if( cursor.value() == min ) {
+            qDebug() << "FANOUT: subscriber" << cursor.key() << "is" << nextChunk - min << "chunks behind, detached";
+            cursor = cursors.erase(cursor);
+        } else {
+            ++cursor;
+        }
+    }
+    stalled.invalidate();
+    dropConsumed();
+    changed.wakeAll();
+}
+
+FanoutSource::~FanoutSource() {
+    readFile.close();
+}
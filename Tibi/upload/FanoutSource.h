@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef FANOUTSOURCE_H
+#define FANOUTSOURCE_H
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QMap>
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QDebug>
+#include <algorithm>
+
+#define FANOUT_CHUNK_SIZE 64*1024
+#define FANOUT_MAX_LAG 256
+#define FANOUT_DETACH_TIME 10*1000
+#define FANOUT_WAIT_TIME 500
+
+/**
+ * @brief The FanoutSource class scans and reads once an item that is sent to several tibiers at the same time.
+ * Each UploadHandler of the group is a subscriber: the item is split in chunks of FANOUT_CHUNK_SIZE bytes (the last chunk
+ * of a file can be shorter), numbered across the files of the item. The first subscriber asking for a chunk not read yet
+ * reads it from disk; the chunk is kept, as an implicitly shared QByteArray, until every subscriber went past it.
+ * The fastest subscriber can be at most FANOUT_MAX_LAG chunks ahead of the slowest one: if the slowest one doesn't move
+ * for FANOUT_DETACH_TIME ms, it is detached and continues reading the item on its own.
+ * It is shared by the handler threads through a QSharedPointer.
+ */
+class FanoutSource
+{
+public:
+    explicit FanoutSource(const QString& itemPath);
+    ~FanoutSource();
+
+    /**
+     * @brief subscribe, to be called for every handler of the group before any of them starts
+     * @return the id of the subscriber
+     */
+    int subscribe();
+
+    /**
+     * @brief unsubscribe, the handler terminated (or doesn't need the chunks anymore)
+     */
+    void unsubscribe(int id);
+
+    /**
+     * @brief scan, the first call walks the item, the others wait for it and share the result
+     */
+    void scan();
+    bool isDir() const;
+    qint64 totalSize() const;
+    const QVector<QString>& files() const;
+    const QVector<QString>& dirLeaves() const;
+    qint64 fileSize(int fileIndex) const;
+
+    /**
+     * @brief chunkIndex, the number of the chunk holding the byte at offset of the file
+     */
+    qint64 chunkIndex(int fileIndex, qint64 offset) const;
+
+    /**
+     * @brief chunk, returns the chunk for the subscriber, reading it if no one did yet.
+     * It waits at most FANOUT_WAIT_TIME ms, so that the caller can check its abort and pause flags: data is empty if the chunk is not ready.
+     * @return false if the subscriber has been detached (or the chunk could not be read): it has to read the item on its own
+     */
+    bool chunk(int id, qint64 index, QByteArray& data);
+
+private:
+    QString itemPath;
+    mutable QMutex source_m;
+    QWaitCondition changed;
+
+    /* -- scan -- */
+    bool scanned = false;
+    bool dir = false;
+    qint64 size = 0;
+    QVector<QString> filePaths;
+    QVector<qint64> fileSizes;
+    QVector<qint64> firstChunks;
+    QVector<QString> leaves;
+
+    /* -- chunks -- */
+    QHash<int, qint64> cursors;
+    int nextId = 0;
+    QMap<qint64, QByteArray> window;
+    qint64 nextChunk = 0;
+    bool reading = false;
+    QFile readFile;
+    int readFileIndex = -1;
+    QElapsedTimer stalled;
+
+    qint64 scanDir(const QDir& root, const QString& path);
+    qint64 minCursor() const;
+    void dropConsumed();
+    void detachSlowest();
+    QByteArray readNext();
+
+};
+
+#endif // FANOUTSOURCE_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "ItemStream.h"
+
+ItemStream::ItemStream(QSharedPointer<FanoutSource> source, const QString& itemPath) :
+    source(source),
+    itemPath(itemPath)
+{
+}
+
+void ItemStream::layout() {
+    QMutexLocker ml(&layout_m);
+    if( laidOut ) return;
+    source->scan();
+    const QVector<QString>& files = source->files();
+
+    // the same bytes of UploadHandler::sendDir and UploadHandler::sendFile
+    if( source->isDir() ) {
+        QByteArray block;
+        QDataStream out(&block, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_5);
+        out << static_cast<qint16>(source->dirLeaves().count());
+        for( const QString& leaf : source->dirLeaves() ) {
+            out << static_cast<quint16>(leaf.size());
+            out << leaf;
+        }
+        out << static_cast<qint16>(files.count());
+        addBytes(block);
+    }
+
+    QDir dir(itemPath);
+    for( int i = 0; i < files.size(); i++ ) {
+        if( source->isDir() ) {
+            QString relativePath = dir.relativeFilePath(files.at(i));
+            QByteArray block;
+            QDataStream out(&block, QIODevice::WriteOnly);
+            out.setVersion(QDataStream::Qt_5_5);
+            out << static_cast<quint16>(relativePath.size());
+            out << relativePath;
+            out << source->fileSize(i);
+            addBytes(block);
+        }
+        if( source->fileSize(i) == 0 ) continue;
+
+        Segment content;
+        content.offset = streamSize;
+        content.size = source->fileSize(i);
+        content.fileIndex = i;
+        segments.push_back(content);
+        streamSize += content.size;
+    }
+    laidOut = true;
+}
+
+void ItemStream::addBytes(const QByteArray& bytes) {
+    Segment segment;
+    segment.offset = streamSize;
+    segment.size = bytes.size();
+    segment.bytes = bytes;
+    segments.push_back(segment);
+    streamSize += segment.size;
+}
+
+qint64 ItemStream::size() const {
+    return streamSize;
+}
+
+bool ItemStream::read(qint64 offset, qint64 size, QByteArray& data) const {
+    data.clear();
+    size = qMin(size, streamSize - offset);
+    if( size <= 0 ) return true;
+
+    // the first segment containing offset
+    auto segment = std::upper_bound(segments.begin(), segments.end(), offset,
+                                    [](qint64 value, const Segment& s) { return value < s.offset; }) - 1;
+    while( size > 0 && segment != segments.end() ) {
+        qint64 from = offset - segment->offset;
+        qint64 length = qMin(size, segment->size - from);
+        if( segment->fileIndex < 0 ) {
+            data.append(segment->bytes.mid(static_cast<int>(from), static_cast<int>(length)));
+        } else {
+            QFile file(source->files().at(segment->fileIndex));
+            if( !file.open(QIODevice::ReadOnly) || !file.seek(from) ) return false;
+            QByteArray read = file.read(length);
+            if( read.size() != length ) return false;
+            data.append(read);
+        }
+        offset += length;
+        size -= length;
+        ++segment;
+    }
+    return true;
+}
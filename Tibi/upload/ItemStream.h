@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef ITEMSTREAM_H
+#define ITEMSTREAM_H
+
+#include <QSharedPointer>
+#include <QDataStream>
+#include "upload/FanoutSource.h"
+
+/**
+ * @brief The ItemStream class gives random access to the bytes that an UploadHandler writes to the socket after the answer
+ * of the receiver: for a file its content, for a dir the leaves, the files counter, and the info and content of each file.
+ * The layout is computed once from the scan of the FanoutSource; the content is read from disk on request.
+ * It is used when the item is not sent on the TLS socket (MulticastSender, SwarmManifest), and it is thread safe once laid out.
+ */
+class ItemStream
+{
+public:
+    ItemStream(QSharedPointer<FanoutSource> source, const QString& itemPath);
+
+    /**
+     * @brief layout, the first call scans the item and computes the segments, the others wait for it
+     */
+    void layout();
+    qint64 size() const;
+
+    /**
+     * @brief read, the bytes of the stream in [offset, offset + size)
+     * @return false if a file cannot be read (it changed after the scan)
+     */
+    bool read(qint64 offset, qint64 size, QByteArray& data) const;
+
+private:
+    class Segment {
+    public:
+        qint64 offset = 0;
+        qint64 size = 0;
+        QByteArray bytes;   // the metadata written by the handler
+        int fileIndex = -1; // or the content of a file
+    };
+
+    QSharedPointer<FanoutSource> source;
+    QString itemPath;
+    QMutex layout_m;
+    bool laidOut = false;
+    qint64 streamSize = 0;
+    QVector<Segment> segments;
+
+    void addBytes(const QByteArray& bytes);
+
+};
+
+#endif // ITEMSTREAM_H
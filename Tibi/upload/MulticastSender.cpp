@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "MulticastSender.h"
+
+MulticastSender::MulticastSender(QSharedPointer<ItemStream> stream, int members) :
+    stream(stream),
+    members(members)
+{
+    // an administratively scoped group (239.255.0.0/16) for each transfer, so that the receivers only get their own packets
+    quint32 group = 0xEFFF0000 | (QRandomGenerator::global()->generate() & 0xFFFF);
+    if( group == 0xEFFFFFFA ) group--; // 239.255.255.250 is used by SSDP
+    groupOffer.group = QHostAddress(group);
+    groupOffer.port = MCAST_DATA_PORT;
+    do {
+        groupOffer.session = QRandomGenerator::global()->generate();
+    } while( groupOffer.session == 0 );
+    groupOffer.key.resize(MCAST_KEY_SIZE);
+    QRandomGenerator::system()->fillRange(reinterpret_cast<quint32*>(groupOffer.key.data()), MCAST_KEY_SIZE / 4);
+}
+
+const MulticastOffer& MulticastSender::offer() const {
+    return groupOffer;
+}
+
+void MulticastSender::start() {
+    socket = new QUdpSocket(this);
+    if( !socket->bind(QHostAddress(QHostAddress::AnyIPv4), 0) ) {
+        qDebug() << "MULTICAST: impossible to bind the sender socket:" << socket->errorString();
+    }
+    socket->setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+    connect(socket, &QUdpSocket::readyRead, this, &MulticastSender::readNacks);
+
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    int rate = qBound(1, settings.value("multicastRate", MCAST_DEFAULT_RATE).toInt(), 10000);
+    bytesPerMsec = rate * 125.0; // Mbit/s
+    history.resize(MCAST_HISTORY);
+
+    tickTimer.setInterval(MCAST_TICK);
+    connect(&tickTimer, &QTimer::timeout, this, &MulticastSender::tick);
+    startTimer.setSingleShot(true);
+    startTimer.setInterval(MCAST_START_WAIT);
+    connect(&startTimer, &QTimer::timeout, this, &MulticastSender::begin);
+    startTimer.start();
+
+    qDebug() << "MULTICAST: session" << groupOffer.session << "on" << groupOffer.group.toString() << "@" << groupOffer.port
+             << "for" << members << "tibiers at" << rate << "Mbit/s";
+}
+
+void MulticastSender::memberAnswered(bool accepted) {
+    answered++;
+    if( accepted ) this->accepted++;
+    else left++;
+
+    if( left >= members ) finish();
+    else if( answered >= members ) begin();
+}
+
+void MulticastSender::memberLeft() {
+    left++;
+    if( left >= members ) finish();
+}
+
+void MulticastSender::begin() {
+    if( started || stopped ) return;
+    startTimer.stop();
+    if( accepted == 0 ) {
+        finish();
+        return;
+    }
+
+    // the members that didn't answer yet will join late: they repair what is still in the history, or go unicast
+    stream->layout();
+    started = true;
+    lastTick.start();
+    lastNack.start();
+    lastProgress.start();
+    tickTimer.start();
+}
+
+void MulticastSender::tick() {
+    // the budget is refilled at the configured rate, without bursts after a busy loop
+    budget = qMin(budget + lastTick.restart() * bytesPerMsec, bytesPerMsec * MCAST_TICK * 4);
+
+    while( budget > 0 && !repairs.isEmpty() ) {
+        quint32 seq = repairs.takeFirst();
+        repairing.remove(seq);
+        sendRepair(seq);
+        budget -= MCAST_HEADER_SIZE + MCAST_PAYLOAD + MCAST_TAG_SIZE;
+    }
+
+    while( budget > 0 && !streamEnded ) {
+        if( !sendNextData() ) break;
+        budget -= MCAST_HEADER_SIZE + MCAST_PAYLOAD + MCAST_TAG_SIZE;
+    }
+
+    if( lastProgress.elapsed() >= MCAST_PROGRESS_INTERVAL ) {
+        emit progress(streamOffset - pending.size());
+        lastProgress.restart();
+    }
+
+    if( !streamEnded ) return;
+    if( !lastEnd.isValid() || lastEnd.elapsed() >= MCAST_END_INTERVAL ) {
+        // a broken stream cannot be completed: every receiver goes unicast, where the handler reports the error
+        MulticastPacket end;
+        end.kind = broken ? MulticastPacket::Gone : MulticastPacket::End;
+        end.session = groupOffer.session;
+        end.seq = nextSeq;
+        sendPacket(end);
+        lastEnd.start();
+    }
+
+    // nobody asked anything for a while: the members still here will go unicast if they need to
+    if( lastNack.elapsed() >= MCAST_LINGER ) finish();
+}
+
+bool MulticastSender::sendNextData() {
+    if( pending.size() < MCAST_PAYLOAD && streamOffset < stream->size() && !broken ) {
+        QByteArray read;
+        if( stream->read(streamOffset, FANOUT_CHUNK_SIZE, read) ) {
+            pending.append(read);
+            streamOffset += read.size();
+        } else {
+            qDebug() << "MULTICAST: impossible to read the item at" << streamOffset;
+            broken = true;
+            pending.clear();
+        }
+    }
+
+    if( pending.isEmpty() ) {
+        streamEnded = true;
+        int inBlock = static_cast<int>(nextSeq % MCAST_FEC_BLOCK);
+        if( inBlock != 0 ) sendParity(nextSeq / MCAST_FEC_BLOCK, inBlock);
+        emit progress(streamOffset);
+        lastNack.restart();
+        qDebug() << "MULTICAST: session" << groupOffer.session << "sent in" << nextSeq << "packets" << (broken ? "(broken)" : "");
+        return false;
+    }
+
+    MulticastPacket packet;
+    packet.kind = MulticastPacket::Data;
+    packet.session = groupOffer.session;
+    packet.seq = nextSeq;
+    packet.payload = pending.left(MCAST_PAYLOAD);
+    packet.length = static_cast<quint16>(packet.payload.size());
+    pending.remove(0, packet.payload.size());
+
+    history[static_cast<int>(nextSeq % MCAST_HISTORY)] = packet.payload;
+    MulticastPacket::xorInto(parity, packet.payload);
+    parityLength ^= packet.length;
+    sendPacket(packet);
+    nextSeq++;
+
+    if( nextSeq % MCAST_FEC_BLOCK == 0 ) sendParity(nextSeq / MCAST_FEC_BLOCK - 1, MCAST_FEC_BLOCK);
+    return true;
+}
+
+void MulticastSender::sendParity(quint32 block, int count) {
+    MulticastPacket packet;
+    packet.kind = MulticastPacket::Parity;
+    packet.session = groupOffer.session;
+    packet.seq = block;
+    packet.length = parityLength;
+    packet.payload.append(static_cast<char>(count));
+    packet.payload.append(parity);
+    sendPacket(packet);
+    parity.clear();
+    parityLength = 0;
+}
+
+void MulticastSender::sendRepair(quint32 seq) {
+    if( seq >= nextSeq ) return;
+
+    MulticastPacket packet;
+    packet.session = groupOffer.session;
+    packet.seq = seq;
+    if( nextSeq - seq > MCAST_HISTORY ) {
+        packet.kind = MulticastPacket::Gone;
+    } else {
+        // sent to the whole group: the other receivers that missed it take it too
+        packet.kind = MulticastPacket::Data;
+        packet.payload = history.at(static_cast<int>(seq % MCAST_HISTORY));
+        packet.length = static_cast<quint16>(packet.payload.size());
+    }
+    sendPacket(packet);
+}
+
+void MulticastSender::sendPacket(const MulticastPacket& packet) {
+    socket->writeDatagram(packet.encode(groupOffer.key), groupOffer.group, groupOffer.port);
+}
+
+void MulticastSender::readNacks() {
+    while( socket->hasPendingDatagrams() ) {
+        QNetworkDatagram datagram = socket->receiveDatagram();
+        MulticastPacket packet;
+        if( !MulticastPacket::decode(datagram.data(), groupOffer.key, packet) ) continue;
+        if( packet.session != groupOffer.session || packet.kind != MulticastPacket::Nack ) continue;
+
+        lastNack.restart();
+        for( quint32 seq : packet.nackedPackets() ) {
+            if( repairing.contains(seq) ) continue;
+            repairing.insert(seq);
+            repairs.append(seq);
+        }
+    }
+}
+
+void MulticastSender::stop() {
+    finish();
+}
+
+void MulticastSender::finish() {
+    if( stopped ) return;
+    stopped = true;
+    tickTimer.stop();
+    startTimer.stop();
+    if( socket != nullptr ) socket->close();
+    qDebug() << "MULTICAST: session" << groupOffer.session << "finished";
+    emit finished();
+}
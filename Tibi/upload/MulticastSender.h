@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef MULTICASTSENDER_H
+#define MULTICASTSENDER_H
+
+#include <QObject>
+#include <QUdpSocket>
+#include <QNetworkDatagram>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QDataStream>
+#include <QRandomGenerator>
+#include <QSharedPointer>
+#include <QList>
+#include <QSet>
+#include "network/MulticastPacket.h"
+#include "upload/ItemStream.h"
+
+#define MCAST_MIN_RECEIVERS 3
+#define MCAST_DEFAULT_RATE 100
+#define MCAST_TICK 5
+#define MCAST_HISTORY 8192
+#define MCAST_START_WAIT 10*1000
+#define MCAST_END_INTERVAL 200
+#define MCAST_LINGER 10*1000
+#define MCAST_PROGRESS_INTERVAL 200
+
+/**
+ * @brief The MulticastSender class sends an item once to the multicast group of a fanout group, instead of once per tibier.
+ * The TLS connections of the handlers stay open as the control channel: the receivers that miss too much ask the rest
+ * of the item through them, and confirm the end of the transfer.
+ * The data packets are paced at "multicastRate" Mbit/s (MCAST_DEFAULT_RATE): the repairs asked by the NACKs go first.
+ * The last MCAST_HISTORY packets can be sent again, the older ones are answered with a Gone packet.
+ * The multicast data are not encrypted: the mode is used only if enabled with the "multicastData" setting. Every packet is tagged
+ * with the key of the offer, that only the members receive on their TLS socket, and the NACKs without a valid tag are ignored.
+ * It runs in its own thread and it is driven by the handlers of the group through queued signals.
+ */
+class MulticastSender : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param stream, the bytes to send, laid out from the scan of the fanout group
+     * @param members, the handlers that offer the multicast group to their receivers
+     */
+    MulticastSender(QSharedPointer<ItemStream> stream, int members);
+
+    /**
+     * @brief offer, the group and the session announced by the handlers. It doesn't change after the construction.
+     */
+    const MulticastOffer& offer() const;
+
+public slots:
+    void start();
+    void stop();
+
+    /**
+     * @brief memberAnswered, the data start once every member answered, or after MCAST_START_WAIT ms
+     */
+    void memberAnswered(bool accepted);
+
+    /**
+     * @brief memberLeft, the receiver completed the item, went unicast or the handler terminated
+     */
+    void memberLeft();
+
+signals:
+    /**
+     * @brief progress, the bytes of the stream sent once to the group
+     */
+    void progress(qint64 bytesSent);
+    void finished();
+
+private:
+    QSharedPointer<ItemStream> stream;
+    MulticastOffer groupOffer;
+    int members = 0;
+    int answered = 0;
+    int accepted = 0;
+    int left = 0;
+    bool started = false;
+    bool stopped = false;
+
+    QUdpSocket* socket = nullptr;
+    QTimer tickTimer;
+    QTimer startTimer;
+    QElapsedTimer lastTick;
+    QElapsedTimer lastEnd;
+    QElapsedTimer lastNack;
+    QElapsedTimer lastProgress;
+    double budget = 0;
+    double bytesPerMsec = 0;
+
+    /* -- the stream -- */
+    QByteArray pending;
+    qint64 streamOffset = 0;
+    bool streamEnded = false;
+    bool broken = false;
+
+    /* -- the packets -- */
+    quint32 nextSeq = 0;
+    QVector<QByteArray> history;
+    QByteArray parity;
+    quint16 parityLength = 0;
+    QList<quint32> repairs;
+    QSet<quint32> repairing;
+
+    void begin();
+    void tick();
+
+    bool sendNextData();
+    void sendRepair(quint32 seq);
+    void sendPacket(const MulticastPacket& packet);
+    void sendParity(quint32 block, int count);
+    void readNacks();
+    void finish();
+
+};
+
+#endif // MULTICASTSENDER_H
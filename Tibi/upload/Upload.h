@@ -22,6 +22,7 @@ public:
     QTime timeStart = QTime(0,0,0);
     qint64 totalSize = 0;
     qint64 totalByteSent = 0;
+    qint64 pausedMsecs = 0;
     Status status;
 
 };
@@ -8,14 +8,20 @@
 #include "UploadHandler.h"
 
 
-UploadHandler::UploadHandler(int code, QSharedPointer<Tibier> tibier, const QString& itemPath, UserHandler* user)
-
+UploadHandler::UploadHandler(int code, QSharedPointer<Tibier> tibier, const QString& itemPath, UserHandler* user,
+                             QSharedPointer<FanoutSource> fanout, int fanoutId, const MulticastOffer& multicastOffer,
+                             const SwarmOffer& swarmOffer) :
+    fanout(fanout),
+    fanoutId(fanoutId),
+    multicastOffer(multicastOffer),
+    swarmOffer(swarmOffer)
 {
     qDebug() << QThread::currentThreadId() << " - TIBI SENDER constructor";
     upload.code = code;
     upload.tibierReceiver = tibier;
     this->itemPath = itemPath;
     this->user = user;
+    blockSize = tibier->link.blockSize(UPLOAD_BLOCK_SIZE);
 
 }
 
@@ -24,35 +30,35 @@ void UploadHandler::initSocket() {
 
     qDebug() << "[SENDER " << upload.code << " - " << QThread::currentThreadId() << " ] New upload request " << itemPath
              << " to " << upload.tibierReceiver->username
-             << " on " << upload.tibierReceiver->address.toString()
+             << " on " << upload.tibierReceiver->addresses.size() << " addresses"
              << "@" << upload.tibierReceiver->port;
 
-    senderSocket = new QSslSocket;
-    setSocketConfig();
-    connectSocket();
-    senderSocket->connectToHostEncrypted(upload.tibierReceiver->address.toString(), upload.tibierReceiver->port);
+    // the tibier may be reachable through several interfaces: the connections are raced
+    connector = new TibiConnector(upload.tibierReceiver, this);
+    connect(connector, &TibiConnector::connectedSocket, this, &UploadHandler::routeReady);
+    connect(connector, &TibiConnector::failed, this, [=](const QString& error) {
+        signalStatusAndTerminate(Status::Error, error);
+    });
+    connector->start();
 
 }
 
 
-void UploadHandler::setSocketConfig() {
-    QSslConfiguration config = senderSocket->sslConfiguration();
-    config.setPeerVerifyMode(QSslSocket::VerifyNone);
-    senderSocket->setSslConfiguration(config);
-    senderSocket->ignoreSslErrors();
-    senderSocket->addCaCertificates(":/certificates/tibi.pem");
+void UploadHandler::routeReady(QSslSocket* socket) {
+    senderSocket = socket;
+    upload.tibierReceiver->address = senderSocket->peerAddress();
+    memoryId = MemoryGovernor::Instance()->join();
+    qDebug() << "\nencrypted? " << senderSocket->isEncrypted()
+             << "\ncipher: " << senderSocket->sessionCipher().name()
+             << "\nprotcol: " << senderSocket->sessionCipher().protocolString();
+    connectSocket();
+    connected();
 }
 
 
 void UploadHandler::connectSocket() {
-    connect(senderSocket, &QSslSocket::connected, this, &UploadHandler::connected);
     connect(senderSocket, &QSslSocket::readyRead, this, &UploadHandler::getAnswer);
     connect(senderSocket, &QSslSocket::disconnected, senderSocket, &QSslSocket::deleteLater);
-    connect(senderSocket, &QSslSocket::encrypted, this, [=]() {
-        qDebug() << "\nencrypted? " << senderSocket->isEncrypted()
-                 << "\ncipher: " << senderSocket->sessionCipher().name()
-                 << "\nprotcol: " << senderSocket->sessionCipher().protocolString();
-    });
     connect(senderSocket, static_cast<void ( QTcpSocket::* )( QAbstractSocket::SocketError )>( &QAbstractSocket::error ), this,
             [=]( QAbstractSocket::SocketError ) {
 
@@ -109,8 +115,18 @@ void UploadHandler::prepareFirstMetadata() {
     itemInfo.setFile(itemPath);
     if( !checkItemExistance() ) return;
     fillItemName();
-    fillItemType();
-    fillItemSize();
+    if( !fanout.isNull() ) {
+        // the item is scanned once for all the handlers of the group
+        fanout->scan();
+        isDir = fanout->isDir() ? Types::Dir : Types::File;
+        dirToSend.setPath(itemPath);
+        upload.totalSize = fanout->totalSize();
+        filePaths = fanout->files();
+        dirLeavesRelativePaths = fanout->dirLeaves();
+    } else {
+        fillItemType();
+        fillItemSize();
+    }
     qDebug() << "item name: " << upload.itemName
              << "\nitem type: " << isDir
              << "\nitem size: " << upload.totalSize;
@@ -201,14 +217,34 @@ void UploadHandler::sendFirstMetadata() {
     QString itemName = upload.itemName;
     quint8 usernameSize = static_cast<quint8>(username.size());
     quint8 itemNameSize = static_cast<quint8>(itemName.size());
-    quint16 metadataSize = static_cast<quint16>(16 + 1 + 1 + 2 + 8 + usernameSize + itemNameSize);
+    // the item count is only understood by the receivers advertising it: the flag in the type byte tells that it follows
+    bool sendItemCount = upload.tibierReceiver->capabilities & TibiBeacon::ItemCount;
+    // the multicast group is offered only to the receivers advertising it (the dispatcher checks the capability)
+    bool sendOffer = multicastOffer.session != 0;
+    QString group = multicastOffer.group.toString();
+    bool sendSwarm = swarmOffer.swarm != 0;
+    quint16 metadataSize = static_cast<quint16>(16 + 1 + 1 + 2 + 8 + usernameSize + itemNameSize + (sendItemCount ? 4 : 0)
+                                                + (sendOffer ? 4 + group.size() * 2 + 2 + 4 + 4 + MCAST_KEY_SIZE : 0)
+                                                + (sendSwarm ? 4 + 2 : 0));
     qDebug() << "metadata size: " << metadataSize;
     *out << metadataSize;
     *out << user->getId();
     *out << username;
-    *out << static_cast<quint8>(isDir ? 1 : 0);
+    *out << static_cast<quint8>((isDir ? 1 : 0) | (sendItemCount ? ITEM_COUNT_FLAG : 0) | (sendOffer ? MULTICAST_FLAG : 0)
+                                | (sendSwarm ? SWARM_FLAG : 0));
     *out << itemName;
     *out << upload.totalSize;
+    if( sendItemCount ) *out << static_cast<qint32>(isDir ? filePaths.size() : 1);
+    if( sendOffer ) {
+        *out << group;
+        *out << multicastOffer.port;
+        *out << multicastOffer.session;
+        *out << multicastOffer.key;
+    }
+    if( sendSwarm ) {
+        *out << swarmOffer.swarm;
+        *out << swarmOffer.port;
+    }
     writeBlock();
 }
 
@@ -236,7 +272,7 @@ void UploadHandler::getAnswer() {
     in.setDevice(senderSocket);
     in.setVersion(QDataStream::Qt_5_5);
 
-    if( senderSocket->bytesAvailable() == sizeof(bool) ) {
+    if( upload.status == Status::WaitingForAnswer && senderSocket->bytesAvailable() >= static_cast<qint64>(sizeof(bool)) ) {
         bool declined;
         in >> declined;
         qDebug() << "Answer: " << (declined ? "refuse" : "accept")
@@ -246,48 +282,154 @@ void UploadHandler::getAnswer() {
 
     }
 
+    // a receiver of the group confirms the end of the item, or asks the rest of it
+    while( groupAnswered && !groupGone && !sending && senderSocket->bytesAvailable() >= 8 ) {
+        qint64 offset;
+        in >> offset;
+        groupReply(offset);
+    }
+
 }
 
 
 void UploadHandler::refused() {
     upload.status = Status::Declined;
+    leaveFanout();
+    leaveGroup();
 }
 
 
 void UploadHandler::accepted() {
     upload.status = Status::Accepted;
     upload.timeStart.start();
+    if( multicastOffer.session != 0 ) {
+        // the item goes to the group: the receiver reads it from there, this handler waits for its reply
+        leaveFanout();
+        groupAnswered = true;
+        emit multicastAnswer(true);
+        emit updateUpload(QSharedPointer<Upload>(new Upload(upload)));
+        return;
+    }
+    if( swarmOffer.swarm != 0 ) {
+        // the receiver pulls the chunks from the swarm: it gets the manifest to verify them, then this handler waits for its reply
+        leaveFanout();
+        QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>(this);
+        connect(watcher, &QFutureWatcher<bool>::finished, this, [=]() {
+            sendManifest(watcher->result());
+            watcher->deleteLater();
+        });
+        watcher->setFuture(swarmOffer.built);
+        return;
+    }
+    sendItem();
+}
+
+
+void UploadHandler::sendManifest(bool built) {
+    // the upload may have been aborted or closed while the manifest was being built
+    if( checkAbort() || upload.status != Status::Accepted ) return;
+    if( !built ) {
+        signalStatusAndTerminate(Status::Error, "The item cannot be read");
+        return;
+    }
+    groupAnswered = true;
+    *out << swarmOffer.manifest->encode();
+    writeBlock();
+    emit updateUpload(QSharedPointer<Upload>(new Upload(upload)));
+}
+
+
+void UploadHandler::sendItem() {
+    sending = true;
+    QElapsedTimer sendTime;
+    sendTime.start();
+    qint64 writtenBefore = bytesWritten;
+    qint64 pausedBefore = upload.pausedMsecs;
     isDir == Types::Dir ? sendDir() : sendFile(itemPath);
+    sending = false;
+    leaveFanout();
     if( checkAbort() ) return;
     qDebug() << "All bytes are sent. Wait for the receiver to disconnect";
+    // the throughput reached is a sample of the link to the receiver: the bytes it already got from the group never went on the socket
+    if( upload.status == Status::Accepted ) {
+        user->recordThroughput(upload.tibierReceiver->id, bytesWritten - writtenBefore, sendTime.elapsed() - (upload.pausedMsecs - pausedBefore));
+    }
     upload.status = Status::Completed;
     emit updateUpload(QSharedPointer<Upload>(new Upload(upload)));
 }
 
 
-void UploadHandler::sendFile(const QString& absolutePath) {
+void UploadHandler::groupReply(qint64 offset) {
+    leaveGroup();
+    if( offset < 0 ) {
+        qDebug() << "[SENDER " << upload.code << " ] the receiver got the whole item from the group";
+        upload.totalByteSent = upload.totalSize;
+        upload.status = Status::Completed;
+        emit updateUpload(QSharedPointer<Upload>(new Upload(upload)));
+        return;
+    }
+
+    qDebug() << "[SENDER " << upload.code << " ] the receiver asks the rest of the item from byte " << offset;
+    skipBytes = offset;
+    upload.totalByteSent = 0;
+    sendItem();
+}
+
+
+void UploadHandler::multicastProgress(qint64 bytesSent) {
+    if( !groupAnswered || groupGone || upload.status != Status::Accepted ) return;
+    upload.totalByteSent = qMin(bytesSent, upload.totalSize);
+    emit updateUpload(QSharedPointer<Upload>(new Upload(upload)));
+}
+
+
+void UploadHandler::leaveGroup() {
+    if( (multicastOffer.session == 0 && swarmOffer.swarm == 0) || groupGone ) return;
+    if( multicastOffer.session != 0 ) {
+        if( !groupAnswered ) {
+            // never joined: the sender doesn't wait for this receiver to start
+            emit multicastAnswer(false);
+        } else {
+            emit multicastLeft();
+        }
+    }
+    groupAnswered = true;
+    groupGone = true;
+}
+
+
+void UploadHandler::sendFile(const QString& absolutePath, int fileIndex) {
     if( checkAbort() ) return;
     QFile file(absolutePath);
     if( !openFile(file) ) return;
-    if( isDir ) sendFileInfo(absolutePath, file);
+    // with a fanout source, the sizes are the ones scanned (and announced) for the whole group
+    qint64 fileSize = fanout.isNull() ? file.size() : fanout->fileSize(fileIndex);
+    if( isDir ) sendFileInfo(absolutePath, fileSize);
 
     qDebug() << "File absolute path " << absolutePath;
 
-    currentFilebytesLeft = file.size();
-    qint64 sizeToRead = 12288;
+    currentFilebytesLeft = fileSize;
+    if( skipBytes > 0 ) {
+        // already received from the group
+        qint64 skipped = qMin(skipBytes, currentFilebytesLeft);
+        skipBytes -= skipped;
+        currentFilebytesLeft -= skipped;
+        upload.totalByteSent += skipped;
+    }
     while (currentFilebytesLeft > 0 && !checkAbort()) {
-        if( currentFilebytesLeft < 12288 ) sizeToRead = currentFilebytesLeft;
-        qDebug() << "size to read: " << sizeToRead;
-        outBlock.insert(0, file.read(sizeToRead));
-        qint64 x = sizeToRead;
-        while( x > 0 ) {
-            x -= senderSocket->write(outBlock);
-            qDebug() << "byteLeft: " << x << "/" << sizeToRead;
+        if( !waitIfPaused() ) return;
+        QByteArray block;
+        if( !readBlock(file, fileIndex, fileSize - currentFilebytesLeft, block) ) {
+            signalStatusAndTerminate(Status::Error, "Impossible to read the file");
+            return;
         }
-        currentFilebytesLeft -= sizeToRead;
-        upload.totalByteSent += sizeToRead;
+        if( block.isEmpty() ) continue;
+        if( block.size() > currentFilebytesLeft ) block.truncate(static_cast<int>(currentFilebytesLeft));
+        if( !writeData(block) ) return;
+        currentFilebytesLeft -= block.size();
+        upload.totalByteSent += block.size();
+        bytesWritten += block.size();
         // at each iteration, a copy of the current status is shared with the DownloadDispatcher
-        outBlock.clear();
         emit updateUpload(QSharedPointer<Upload>(new Upload(upload)));
     }
 
@@ -295,15 +437,47 @@ void UploadHandler::sendFile(const QString& absolutePath) {
 
 }
 
-void UploadHandler::sendFileInfo(const QString &absolutePath, const QFile &file) {
+bool UploadHandler::readBlock(QFile& file, int fileIndex, qint64 offset, QByteArray& block) {
+    if( fanoutId >= 0 ) {
+        if( fanout->chunk(fanoutId, fanout->chunkIndex(fileIndex, offset), block) ) return true;
+        qDebug() << "[SENDER " << upload.code << " ] detached from the fanout, reading on its own";
+        fanoutId = -1;
+    }
+
+    if( file.pos() != offset && !file.seek(offset) ) return false;
+    block = file.read(qMin<qint64>(blockSize, currentFilebytesLeft));
+    return !block.isEmpty();
+}
+
+bool UploadHandler::writeData(const QByteArray& block) {
+    // the socket buffers everything it is given: the block is written only once the receiver caught up
+    MemoryGovernor* governor = MemoryGovernor::Instance();
+    governor->update(memoryId, senderSocket->bytesToWrite());
+    while( !governor->admits(memoryId, block.size()) ) {
+        if( checkAbort() ) return false;
+        if( !senderSocket->waitForBytesWritten(PAUSE_CHECK_TIME) && senderSocket->state() != QAbstractSocket::ConnectedState ) return false;
+        governor->update(memoryId, senderSocket->bytesToWrite());
+    }
+
+    qint64 written = 0;
+    while( written < block.size() ) {
+        qint64 x = senderSocket->write(block.constData() + written, block.size() - written);
+        if( x < 0 ) return false;
+        written += x;
+    }
+    governor->update(memoryId, senderSocket->bytesToWrite());
+    return true;
+}
+
+void UploadHandler::sendFileInfo(const QString &absolutePath, qint64 fileSize) {
 
     QString relativePath = dirToSend.relativeFilePath(absolutePath);
     qDebug() << "File relative path: " << relativePath;
     qDebug() << "sent path size: " << relativePath.size();
-    qDebug() << "file size: " << file.size();
+    qDebug() << "file size: " << fileSize;
     *out << static_cast<quint16>(relativePath.size());
     *out << relativePath;
-    *out << file.size();
+    *out << fileSize;
     writeBlock();
 }
 
@@ -330,8 +504,8 @@ void UploadHandler::sendDir() {
     qDebug() << "files counter: " << filePaths.count();
 
     // 3. send each file
-    for( const QString& filePath : filePaths ) {
-        sendFile(filePath);
+    for( int i = 0; i < filePaths.size(); i++ ) {
+        sendFile(filePaths.at(i), i);
     }
 
 
@@ -353,8 +527,15 @@ void UploadHandler::sendSubDirs() {
 
 void UploadHandler::writeBlock() {
     out->device()->seek(0);
-    senderSocket->write(outBlock);
-    senderSocket->waitForBytesWritten();
+    if( skipBytes > 0 ) {
+        int skipped = static_cast<int>(qMin<qint64>(skipBytes, outBlock.size()));
+        outBlock.remove(0, skipped);
+        skipBytes -= skipped;
+    }
+    if( !outBlock.isEmpty() ) {
+        senderSocket->write(outBlock);
+        senderSocket->waitForBytesWritten();
+    }
     outBlock.clear();
 }
 
@@ -364,23 +545,73 @@ void UploadHandler::signalAbort() {
     abort = true;
 }
 
+void UploadHandler::signalPause(bool pause) {
+    QMutexLocker ml(&pause_m);
+    paused = pause;
+    if( !paused ) resume_c.wakeAll();
+}
+
+bool UploadHandler::waitIfPaused() {
+    QMutexLocker ml(&pause_m);
+    if( !paused ) return true;
+
+    qDebug() << "[SENDER " << upload.code << " ] upload paused";
+    upload.status = Status::Paused;
+    emit updateUpload(QSharedPointer<Upload>(new Upload(upload)));
+    QTime pauseTime;
+    pauseTime.start();
+
+    while( paused ) {
+        ml.unlock();
+        if( checkAbort() ) return false;
+        if( senderSocket->state() != QAbstractSocket::ConnectedState ) return false;
+        // nothing new is read from disk, the socket keeps draining the bytes already written
+        bool draining = senderSocket->bytesToWrite() > 0;
+        if( draining ) senderSocket->waitForBytesWritten(PAUSE_CHECK_TIME);
+        ml.relock();
+        if( paused && !draining ) resume_c.wait(&pause_m, PAUSE_CHECK_TIME);
+    }
+
+    qDebug() << "[SENDER " << upload.code << " ] upload resumed";
+    upload.pausedMsecs += pauseTime.elapsed();
+    upload.status = Status::Accepted;
+    emit updateUpload(QSharedPointer<Upload>(new Upload(upload)));
+    return true;
+}
+
 void UploadHandler::abortConnection() {
     if( abortAlreadyCalled ) return;
     qDebug() << QThread::currentThreadId() <<
                 " ] The user aborted";
-    senderSocket->abort();
+    if( connector != nullptr ) connector->abort();
+    if( senderSocket != nullptr ) senderSocket->abort();
     signalStatusAndTerminate(Status::Aborted, "Abort requested from user");
 }
 
+void UploadHandler::leaveFanout() {
+    if( fanoutId < 0 ) return;
+    fanout->unsubscribe(fanoutId);
+    fanoutId = -1;
+}
+
+void UploadHandler::leaveGovernor() {
+    if( memoryId < 0 ) return;
+    MemoryGovernor::Instance()->leave(memoryId);
+    memoryId = -1;
+}
+
 void UploadHandler::signalStatusAndTerminate(Status status, const QString& message) {
-    senderSocket->disconnect();
+    if( senderSocket != nullptr ) senderSocket->disconnect();
+    leaveFanout();
+    leaveGroup();
+    leaveGovernor();
     qDebug() << "NEW UPLOAD STATUS " << upload.code << " - " << status << " : " << message;
 
     if( status == Status::Failed ) {
         abort = true;
     }
 
-    else if( senderSocket->state() != QAbstractSocket::UnconnectedState && senderSocket->state() !=  QAbstractSocket::ClosingState ) {
+    else if( senderSocket != nullptr && senderSocket->state() != QAbstractSocket::UnconnectedState && senderSocket->state() !=  QAbstractSocket::ClosingState ) {
         senderSocket->disconnectFromHost();
     }
 
@@ -401,4 +632,5 @@ void UploadHandler::signalStatusAndTerminate(Status status, const QString& messa
 
 UploadHandler::~UploadHandler() {
     qDebug() << "Destroying sender associated with " << itemPath;
+    leaveGovernor();
 }
@@ -13,12 +13,23 @@
 #include <QDir>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QWaitCondition>
 #include <QThread>
 #include <QSslSocket>
 #include <QDataStream>
 #include <QSslConfiguration>
+#include <QFutureWatcher>
 #include "upload/Upload.h"
 #include "user/UserHandler.h"
+#include "network/TibiConnector.h"
+#include "network/TibiBeacon.h"
+#include "upload/FanoutSource.h"
+#include "network/MulticastPacket.h"
+#include "network/SwarmManifest.h"
+#include "network/MemoryGovernor.h"
+
+#define PAUSE_CHECK_TIME 500
+#define UPLOAD_BLOCK_SIZE 12288
 
 
 class UploadHandler : public QObject
@@ -34,8 +45,14 @@ public:
      * @param itemPath: the path of the file or directory selected by the user
      * @param user: the UserHandler instance, used to send the sender information (id, username)
      * and methods calls
+     * @param fanout: when the same item is sent to several tibiers, the source shared by their handlers (null otherwise)
+     * @param fanoutId: the subscriber id of this handler in the fanout source
+     * @param multicastOffer: the group of the MulticastSender offered to the receiver (a null session for a unicast upload)
+     * @param swarmOffer: the swarm offered to the receiver (a null swarm for a unicast upload)
      */
-    UploadHandler(int code, QSharedPointer<Tibier> tibier, const QString& filePath, UserHandler* user);
+    UploadHandler(int code, QSharedPointer<Tibier> tibier, const QString& filePath, UserHandler* user,
+                  QSharedPointer<FanoutSource> fanout = QSharedPointer<FanoutSource>(), int fanoutId = -1,
+                  const MulticastOffer& multicastOffer = MulticastOffer(), const SwarmOffer& swarmOffer = SwarmOffer());
     ~UploadHandler();
 
 
@@ -50,11 +67,27 @@ public slots:
     void initSocket();
     void signalAbort();
 
+    /**
+     * @brief signalPause, the handler thread is busy in the sending loop, so the pause is signaled through a flag
+     * protected by a mutex (as for the abort). It is read before reading a new block from disk.
+     * @param pause, true to pause the upload, false to resume it
+     */
+    void signalPause(bool pause);
+
+    /**
+     * @brief multicastProgress, the bytes of the item sent to the multicast group
+     */
+    void multicastProgress(qint64 bytesSent);
+
 signals:
     /* -- to quit my thread --*/
     void terminationRequest();
     void updateUpload(QSharedPointer<Upload> upload);
 
+    /* -- to the MulticastSender of the group -- */
+    void multicastAnswer(bool accepted);
+    void multicastLeft();
+
 private:
     UserHandler* user = nullptr;
 
@@ -85,19 +118,67 @@ private:
      */
     QString itemPath;
 
+    /**
+     * @brief fanout, the item is scanned and read once for all the handlers of the group.
+     * fanoutId is set to -1 when this handler has been detached (or terminated): it then reads the item on its own
+     */
+    QSharedPointer<FanoutSource> fanout;
+    int fanoutId = -1;
+    void leaveFanout();
+
+    /**
+     * @brief multicastOffer, the item is sent once to the group by the MulticastSender: the socket only carries the control messages,
+     * and the rest of the item if the receiver asks it (from the offset it read from the group)
+     */
+    MulticastOffer multicastOffer;
+
+    /**
+     * @brief swarmOffer, the receiver pulls the chunks from the other receivers and from the SwarmServer: the socket carries
+     * the manifest of the chunks, then the rest of the item if the receiver asks it
+     */
+    SwarmOffer swarmOffer;
+
+    /* -- a receiver of a group (multicast or swarm) -- */
+    bool groupAnswered = false;
+    bool groupGone = false;
+    void leaveGroup();
+
+    /**
+     * @brief groupReply, the receiver completed the item (offset -1) or asks the rest of it on the socket
+     */
+    void groupReply(qint64 offset);
+
+    /**
+     * @brief sendManifest, sends the manifest of the swarm to the receiver, once it is built on the thread pool
+     * @param built: false if the item could not be read
+     */
+    void sendManifest(bool built);
+
+    /**
+     * @brief skipBytes, the bytes of the stream already received from the group: they are not written again
+     */
+    qint64 skipBytes = 0;
+
+    /**
+     * @brief bytesWritten, the bytes of the files actually written to the socket: unlike upload.totalByteSent, it doesn't count
+     * the bytes skipped, and it is the one sampled by LinkStats
+     */
+    qint64 bytesWritten = 0;
+    bool sending = false;
+
+    /**
+     * @brief blockSize, the bytes read from disk and written at once, sized on the LinkStats of the receiver (at least UPLOAD_BLOCK_SIZE)
+     */
+    int blockSize = UPLOAD_BLOCK_SIZE;
+
     /* -- network -- */
+    TibiConnector* connector = nullptr;
     QSslSocket* senderSocket = nullptr;
     QByteArray outBlock;
     QDataStream* out = nullptr;
 
 
 
-    /**
-     * @brief UploadHandler::setSocketConfig, configures the ssl connection by specyfying to don't
-     * verify the peer identity and ignoring any ssl error related to the handshake
-     */
-    void setSocketConfig();
-
     /**
      * @brief UploadHandler::connectSocket, register all the events related to the socket.
      */
@@ -203,6 +284,11 @@ private:
      */
     void accepted();
 
+    /**
+     * @brief sendItem, sends the dir or the file and waits the receiver to disconnect
+     */
+    void sendItem();
+
     /**
      * @brief UploadHandler::refused, set the status to declined, waiting for the receiver to disconnect.
      */
@@ -228,9 +314,32 @@ private:
 
     /**
      * @brief UploadHandler::sendFile opens the file and send the fileInfo before uploading the content max 3 memory blocks at the time.
+     * The bytes left in the socket buffer are bounded by the MemoryGovernor, so that a slow receiver slows down the reads.
      * @param absolutePath of the file to send
+     * @param fileIndex, the index of the file in filePaths (0 for a single file)
+     */
+    void sendFile(const QString& absolutelPath, int fileIndex = 0);
+
+    /**
+     * @brief readBlock, reads the next block of the file: the chunk shared by the fanout source, or a block read on its own
+     * @param offset, the bytes of the file already sent
+     * @param block, empty if the shared chunk is not ready yet
+     * @return false if the file cannot be read
      */
-    void sendFile(const QString& absolutelPath);
+    bool readBlock(QFile& file, int fileIndex, qint64 offset, QByteArray& block);
+
+    /**
+     * @brief memoryId, the id of the upload in the MemoryGovernor
+     */
+    int memoryId = -1;
+    void leaveGovernor();
+
+    /**
+     * @brief writeData, writes the block to the socket once it fits in the memory share of the upload (and in the budget of all the transfers),
+     * waiting for the receiver to drain the buffer
+     * @return false if the connection dropped
+     */
+    bool writeData(const QByteArray& block);
 
     /**
      * @brief sendFileInfo:
@@ -238,9 +347,9 @@ private:
      * FILE PATH        variable: file path size * sizeof(QChar)
      * FILE SIZE        qint64 - 8 bytes - 64-bit
      * @param absolutePath to compute the relative path
-     * @param file to compute the file size
+     * @param fileSize, the size announced to the receiver
      */
-    void sendFileInfo(const QString& absolutePath, const QFile& file);
+    void sendFileInfo(const QString& absolutePath, qint64 fileSize);
 
     /**
      * @brief UploadHandler::openFile, tries to open the file, terminating if not possibile
@@ -255,6 +364,18 @@ private:
     bool abortAlreadyCalled = false;
     bool checkAbort();
 
+    /* -- pause operations --*/
+    QMutex pause_m;
+    QWaitCondition resume_c;
+    bool paused = false;
+
+    /**
+     * @brief waitIfPaused, while the upload is paused no more blocks are read from disk. The bytes already
+     * written are drained by the socket, without tearing down the TLS session, so that the upload continues in place once resumed.
+     * @return false if the upload has been aborted or the connection dropped while paused, true otherwise
+     */
+    bool waitIfPaused();
+
     void signalStatusAndTerminate(Status status, const QString& message);
 
     /**
@@ -265,6 +386,12 @@ private:
 
 private slots:
 
+    /**
+     * @brief UploadHandler::routeReady, the TibiConnector completed the TLS handshake on one of the addresses of the receiver:
+     * the socket is adopted and the upload starts
+     */
+    void routeReady(QSslSocket* socket);
+
     /**
      * @brief UploadHandler::connected, when the socket is connected the UploadHandler prepares and
      * sends the first metadata, updates the ViewUD and starts waiting for the receiver answer
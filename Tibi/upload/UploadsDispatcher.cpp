@@ -9,6 +9,7 @@
 
 void UploadsDispatcher::setUserInfo(UserHandler* user) {
     this->user = user;
+    restoreQueue();
 }
 
 void UploadsDispatcher::newFileSelection(const QVector<QString>& filePaths) {
@@ -30,32 +31,207 @@ void UploadsDispatcher::tibiersSelectionReady(const QVector<QString>& selectedId
         return;
     }//request cancelled
 
-    QSharedPointer<QVector<Tibier>> selectedTibiers = user->getTibiersFromId(selectedId);
+    // the uploads to a recently seen tibier wait in the queue until it is back online
+    QSharedPointer<QVector<Tibier>> selectedTibiers = user->getTibiersFromId(selectedId, true);
     if( selectedTibiers->isEmpty() ) {
         clearSelectionSession();
         return;
-    }//no selected tibiers online anymore
+    }//no selected tibiers seen anymore
 
-    qDebug() << QThread::currentThreadId() << "Creating uploads handlers..";
+    qDebug() << QThread::currentThreadId() << "Queueing uploads..";
+
+    int firstCode = uploadCode;
+
+    // an item sent to several tibiers is read once for all of them
+    QMap<QString, int> groups;
+    if( selectedTibiers->size() > 1 ) {
+        for( const QString& filePath : selectedFilePathsAndNames.keys() ) {
+            groups.insert(filePath, fanoutGroup);
+            fanoutGroup++;
+        }
+    }
 
     for( Tibier tibier : *selectedTibiers ) {
         QMap<QString, QString>::iterator fileName;
         for (fileName = selectedFilePathsAndNames.begin(); fileName != selectedFilePathsAndNames.end(); ++fileName) {
 
             emit addUploadToView(true, uploadCode, tibier.username, fileName.value());
-            createUploadHandler(uploadCode, tibier, fileName.key());
+            QueuedUpload request;
+            request.code = uploadCode;
+            request.tibierId = tibier.id;
+            request.tibierName = tibier.username;
+            request.itemPath = fileName.key();
+            request.fanoutGroup = groups.value(fileName.key(), -1);
+            queue.enqueue(request);
             uploadCode++;
         }
     }
 
     clearSelectionSession();
+    startQueuedUploads();
+
+    // the requests that didn't get a slot are shown as queued
+    for( int i = 0; i < queue.size(); i++ ) {
+        if( queue.at(i).code >= firstCode ) notifyQueued(queue.at(i));
+    }
+
+}
+
+void UploadsDispatcher::startQueuedUploads() {
+    if( user == nullptr ) return;
+
+    int i = 0;
+    while( activeSlots() < MAX_ACTIVE_UPLOADS && i < queue.size() ) {
+        const QueuedUpload& next = queue.at(i);
+        if( next.paused ) {
+            i++;
+            continue;
+        }
+
+        QSharedPointer<QVector<Tibier>> tibier = user->getTibiersFromId(QVector<QString>{ next.tibierId.toString() });
+        if( tibier->isEmpty() ) {
+            i++;
+            continue;
+        }//the tibier is not online (yet)
+
+        QueuedUpload started = queue.takeAt(i);
+        if( started.fanoutGroup >= 0 ) {
+            startFanoutGroup(started, (*tibier)[0]);
+            continue;
+        }
+        active.insert(started.code, started);
+        createUploadHandler(started.code, (*tibier)[0], started.itemPath);
+    }
+
+}
+
+void UploadsDispatcher::startFanoutGroup(const QueuedUpload& first, Tibier& tibier) {
+    QVector<QueuedUpload> members{ first };
+    QVector<Tibier> tibiers{ tibier };
+
+    // the paused uploads and the offline tibiers of the group will be started later, on their own
+    int i = 0;
+    while( i < queue.size() ) {
+        const QueuedUpload& other = queue.at(i);
+        if( other.fanoutGroup != first.fanoutGroup || other.paused ) {
+            i++;
+            continue;
+        }
+        QSharedPointer<QVector<Tibier>> online = user->getTibiersFromId(QVector<QString>{ other.tibierId.toString() });
+        if( online->isEmpty() ) {
+            i++;
+            continue;
+        }
+        members.push_back(queue.takeAt(i));
+        tibiers.push_back((*online)[0]);
+    }
+
+    // all the subscribers are registered before any handler starts reading
+    QSharedPointer<FanoutSource> source;
+    QVector<int> ids;
+    if( members.size() > 1 ) source = QSharedPointer<FanoutSource>(new FanoutSource(first.itemPath));
+    for( int m = 0; m < members.size(); m++ ) {
+        ids.push_back(source.isNull() ? -1 : source->subscribe());
+    }
+
+    // with enough receivers on the LAN, the item is sent once to a multicast group
+    QSet<int> multicastMembers;
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    if( settings.value("multicastData", false).toBool() ) {
+        for( int m = 0; m < members.size(); m++ ) {
+            if( tibiers.at(m).capabilities & TibiBeacon::Multicast ) multicastMembers.insert(m);
+        }
+        if( multicastMembers.size() < MCAST_MIN_RECEIVERS ) multicastMembers.clear();
+    }
+    MulticastSender* multicast = nullptr;
+    if( !multicastMembers.isEmpty() ) {
+        multicast = createMulticastSender(QSharedPointer<ItemStream>(new ItemStream(source, first.itemPath)), multicastMembers.size());
+    }
 
+    // otherwise the receivers pull the chunks from each other, and from this tibier only what none of them has
+    QSet<int> swarmMembers;
+    SwarmOffer swarm;
+    if( multicastMembers.isEmpty() && settings.value("swarmData", false).toBool() ) {
+        for( int m = 0; m < members.size(); m++ ) {
+            if( tibiers.at(m).capabilities & TibiBeacon::Swarm ) swarmMembers.insert(m);
+        }
+        if( swarmMembers.size() >= SWARM_MIN_RECEIVERS ) swarm = createSwarm(QSharedPointer<ItemStream>(new ItemStream(source, first.itemPath)));
+        if( swarm.swarm == 0 ) swarmMembers.clear();
+    }
+
+    qDebug() << "Starting " << first.itemPath << " for " << members.size() << " tibiers, " << multicastMembers.size() << " through multicast, "
+             << swarmMembers.size() << " through the swarm";
+    for( int m = 0; m < members.size(); m++ ) {
+        active.insert(members.at(m).code, members.at(m));
+        createUploadHandler(members.at(m).code, tibiers[m], members.at(m).itemPath, source, ids.at(m),
+                            multicastMembers.contains(m) ? multicast : nullptr,
+                            swarmMembers.contains(m) ? swarm : SwarmOffer());
+    }
 }
 
-void UploadsDispatcher::createUploadHandler(int code, Tibier& tibier, const QString& filePath) {
+SwarmOffer UploadsDispatcher::createSwarm(QSharedPointer<ItemStream> stream) {
+    SwarmOffer swarm;
+    swarm.port = SwarmServer::Instance()->serverPort();
+    if( swarm.port == 0 ) return SwarmOffer();
+
+    std::mt19937 random(std::random_device{}());
+    while( swarm.swarm == 0 ) {
+        swarm.swarm = static_cast<quint32>(random());
+    }
+    QSharedPointer<SwarmManifest> manifest(new SwarmManifest(stream));
+    swarm.manifest = manifest;
+    // the item is read and hashed on the thread pool while the receivers answer: the handlers send the manifest once it is built
+    swarm.built = QtConcurrent::run([manifest]() { return manifest->build(); });
+    SwarmServer::Instance()->addSeed(swarm.swarm, swarm.manifest);
+    return swarm;
+}
+
+MulticastSender* UploadsDispatcher::createMulticastSender(QSharedPointer<ItemStream> stream, int members) {
+    QThread* multicastThread = new QThread;
+    MulticastSender* multicast = new MulticastSender(stream, members);
+    multicast->moveToThread(multicastThread);
+
+    connect(multicastThread, &QThread::started, multicast, &MulticastSender::start);
+    connect(multicast, &MulticastSender::finished, multicastThread, &QThread::quit);
+    connect(multicast, &MulticastSender::finished, multicast, &MulticastSender::deleteLater);
+    connect(multicastThread, &QThread::finished, multicastThread, &QObject::deleteLater);
+    connect(this, &UploadsDispatcher::cleanUp, multicast, &MulticastSender::stop);
+
+    multicastThread->start();
+    return multicast;
+}
+
+int UploadsDispatcher::activeSlots() const {
+    QSet<int> groups;
+    int used = 0;
+    for( const QueuedUpload& running : active ) {
+        if( running.fanoutGroup < 0 ) {
+            used++;
+        } else if( !groups.contains(running.fanoutGroup) ) {
+            groups.insert(running.fanoutGroup);
+            used++;
+        }
+    }
+    return used;
+}
+
+void UploadsDispatcher::notifyQueued(const QueuedUpload& upload) {
+    emit updateRowUpload(true, upload.code, 0, QTime(0,0,0), upload.paused ? "PAUSED" : "QUEUED");
+}
+
+void UploadsDispatcher::createUploadHandler(int code, Tibier& tibier, const QString& filePath,
+                                            QSharedPointer<FanoutSource> fanout, int fanoutId, MulticastSender* multicast,
+                                            const SwarmOffer& swarm) {
     QSharedPointer<Tibier> selectedTibier = QSharedPointer<Tibier>(new Tibier(tibier));
     QThread *uploadThread = new QThread;
-    UploadHandler* handler = new UploadHandler(code, selectedTibier, filePath, user);
+    UploadHandler* handler = new UploadHandler(code, selectedTibier, filePath, user, fanout, fanoutId,
+                                               multicast != nullptr ? multicast->offer() : MulticastOffer(), swarm);
+
+    if( multicast != nullptr ) {
+        connect(handler, &UploadHandler::multicastAnswer, multicast, &MulticastSender::memberAnswered);
+        connect(handler, &UploadHandler::multicastLeft, multicast, &MulticastSender::memberLeft);
+        connect(multicast, &MulticastSender::progress, handler, &UploadHandler::multicastProgress);
+    }
 
     handler->moveToThread(uploadThread);
     uploads.insert(code, handler);
@@ -83,6 +259,12 @@ void UploadsDispatcher::connectUploadHandler(UploadHandler* handler) {
 }
 
 void UploadsDispatcher::abortFromView(int uploadCode) {
+    if( queue.remove(uploadCode) ) {
+        emit updateRowUpload(true, uploadCode, 100, QTime(0,0,0), "ABORTED");
+        return;
+    }//never started, nothing to abort
+
+    if( !uploads.contains(uploadCode) ) return;
     UploadHandler* handler = uploads.value(uploadCode);
     handler->signalAbort();
     connect(this, &UploadsDispatcher::abortUpload, handler, &UploadHandler::abortConnection, Qt::QueuedConnection);
@@ -91,6 +273,34 @@ void UploadsDispatcher::abortFromView(int uploadCode) {
 
 }
 
+void UploadsDispatcher::pauseFromView(int uploadCode, bool pause) {
+    if( queue.setPaused(uploadCode, pause) ) {
+        notifyQueued(queue.at(queue.indexOf(uploadCode)));
+        if( !pause ) startQueuedUploads();
+        return;
+    }
+
+    if( !uploads.contains(uploadCode) ) return;
+    active[uploadCode].paused = pause;
+    uploads.value(uploadCode)->signalPause(pause);
+}
+
+void UploadsDispatcher::prioritizeFromView(int uploadCode) {
+    if( !queue.prioritize(uploadCode) ) return;
+    startQueuedUploads();
+}
+
+void UploadsDispatcher::setPriorityFromView(int uploadCode, int priority) {
+    if( queue.setPriority(uploadCode, priority) ) {
+        startQueuedUploads();
+    } else if( active.contains(uploadCode) ) {
+        active[uploadCode].priority = priority;
+    } else {
+        return;
+    }
+    saveQueue();
+}
+
 
 void UploadsDispatcher::computeFileNames(QVector<QString>& fileNames) {
 
@@ -113,6 +323,11 @@ void UploadsDispatcher::updateUpload(QSharedPointer<Upload> upload) {
         emit removeUploadFromTray();
     }
 
+    else if( upload->status == Status::Paused ) {
+        info = "PAUSED";
+        perc = upload->totalSize == 0 ? 0 : static_cast<int>(upload->totalByteSent*100/upload->totalSize);
+    }
+
     else if( upload->status == Status::WaitingForAnswer) {
         perc = 0;
         info = "WAITING";
@@ -139,10 +354,18 @@ void UploadsDispatcher::updateUpload(QSharedPointer<Upload> upload) {
     }
 
     else if( upload->status == Status::Accepted ) {
+        if( upload->totalByteSent == 0 ) return;
         perc =  static_cast<int>(upload->totalByteSent*100/upload->totalSize);
         qint64 byteLeft = upload->totalSize - upload->totalByteSent;
-        qint64 elapsedTime = upload->timeStart.elapsed();
-        qint64 uploadTimeMsecs = (byteLeft * elapsedTime) / upload->totalByteSent;
+        qint64 elapsedTime = upload->timeStart.elapsed() - upload->pausedMsecs;
+        double rate = elapsedTime > 0 ? upload->totalByteSent * 1000.0 / elapsedTime : 0;   // bytes/s
+        // at the beginning the rate of the upload says little: the speed reached on the same link by the past uploads counts more
+        qint64 expected = upload->tibierReceiver.isNull() ? 0 : upload->tibierReceiver->link.expectedSpeed();
+        if( expected > 0 && elapsedTime < ETA_WARMUP_TIME ) {
+            double weight = static_cast<double>(qMax<qint64>(0, elapsedTime)) / ETA_WARMUP_TIME;
+            rate = weight * rate + (1 - weight) * expected;
+        }
+        qint64 uploadTimeMsecs = rate > 0 ? static_cast<qint64>(byteLeft * 1000.0 / rate) : 0;
         t = t.addMSecs(uploadTimeMsecs);
     }
 
@@ -151,6 +374,13 @@ void UploadsDispatcher::updateUpload(QSharedPointer<Upload> upload) {
              << "\ninfo: " << info;*/
     emit updateRowUpload(true, upload->code, perc, t, info);
 
+    if( upload->status != Status::Accepted && upload->status != Status::Paused && upload->status != Status::WaitingForAnswer ) {
+        // terminated: the slot is free for the next queued upload
+        active.remove(upload->code);
+        uploads.remove(upload->code);
+        startQueuedUploads();
+    }
+
 }
 
 
@@ -162,7 +392,49 @@ void UploadsDispatcher::clearSelectionSession() {
 
 
 
+void UploadsDispatcher::saveQueue() {
+    // the running uploads cannot continue in place after a restart: they are queued again and restart from the beginning
+    UploadsQueue pending;
+    for( const QueuedUpload& running : active ) {
+        pending.enqueue(running);
+    }
+    for( int i = 0; i < queue.size(); i++ ) {
+        pending.enqueue(queue.at(i));
+    }
+
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    pending.save(settings);
+}
+
+void UploadsDispatcher::restoreQueue() {
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    UploadsQueue restored;
+    restored.restore(settings);
+    // the groups get new numbers, as the codes
+    QMap<int, int> restoredGroups;
+
+    for( int i = 0; i < restored.size(); i++ ) {
+        QueuedUpload pending = restored.at(i);
+        if( !QFileInfo::exists(pending.itemPath) ) continue;
+        pending.code = uploadCode;
+        uploadCode++;
+        if( pending.fanoutGroup >= 0 ) {
+            if( !restoredGroups.contains(pending.fanoutGroup) ) {
+                restoredGroups.insert(pending.fanoutGroup, fanoutGroup);
+                fanoutGroup++;
+            }
+            pending.fanoutGroup = restoredGroups.value(pending.fanoutGroup);
+        }
+        queue.enqueue(pending);
+        emit addUploadToView(true, pending.code, pending.tibierName, QFileInfo(pending.itemPath).fileName());
+        notifyQueued(pending);
+    }
+
+    qDebug() << "Restored " << queue.size() << " queued uploads";
+}
+
 UploadsDispatcher::~UploadsDispatcher() {
+    saveQueue();
     emit cleanUp();
     qDebug() << "Uploads mediator clean";
 }
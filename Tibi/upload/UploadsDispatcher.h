@@ -9,7 +9,26 @@
 #define UPLOADSMEDIATOR_H
 
 #include "UploadHandler.h"
+#include "UploadsQueue.h"
+#include "MulticastSender.h"
+#include "network/SwarmServer.h"
+#include <QSet>
+#include <QtConcurrent>
 
+#define MAX_ACTIVE_UPLOADS 4
+#define ETA_WARMUP_TIME 5000
+
+/**
+ * @brief The UploadsDispatcher class creates an UploadHandler for each (tibier, item) pair selected by the user.
+ * The requests go through a priority queue: at most MAX_ACTIVE_UPLOADS items are sent at the same time and a request
+ * is started only when its tibier is online. The uploads of the same item to several tibiers form a fanout group:
+ * the ones that can start together share a FanoutSource and take a single slot. If the "multicastData" setting is enabled
+ * and at least MCAST_MIN_RECEIVERS of them advertise the Multicast capability, the item is sent once to a multicast group
+ * by a MulticastSender, and the handlers of those receivers only keep the TLS connection as the control channel. The queue (and the uploads still running) is saved on exit and restored
+ * at the next launch.
+ * The time left of an upload is computed on its rate so far, blended during the first ETA_WARMUP_TIME ms with the speed
+ * the past uploads reached on the same link (LinkStats).
+ */
 class UploadsDispatcher : public QObject
 {
     Q_OBJECT
@@ -25,6 +44,29 @@ public slots:
     void updateUpload(QSharedPointer<Upload> upload);
     void abortFromView(int uploadCode);
 
+    /**
+     * @brief pauseFromView, pauses or resumes an upload. A queued upload is kept in the queue but not started,
+     * a running one stops reading from disk and continues in place once resumed.
+     */
+    void pauseFromView(int uploadCode, bool pause);
+
+    /**
+     * @brief prioritizeFromView, moves a queued upload to the head of the queue
+     */
+    void prioritizeFromView(int uploadCode);
+
+    /**
+     * @brief setPriorityFromView, sets the priority of a queued or running upload (PRIORITY_LOW, PRIORITY_NORMAL, PRIORITY_HIGH).
+     * It is saved with the queue: a running upload keeps it when it is queued again after a restart.
+     */
+    void setPriorityFromView(int uploadCode, int priority);
+
+    /**
+     * @brief startQueuedUploads, starts the queued uploads whose tibier is online, as long as there are free slots.
+     * It is called each time an upload terminates and each time the connected tibiers change.
+     */
+    void startQueuedUploads();
+
 signals:
     void showConnectedTibiers(const QVector<QString>& filePaths);
     void endSelectionSession();
@@ -40,7 +82,39 @@ signals:
     int uploadCode = 0;
     QMap<int, UploadHandler*> uploads;
     QMap<QString, QString> selectedFilePathsAndNames;
-    void createUploadHandler(int code, Tibier& tibier, const QString& filePath);
+
+    /* -- queue -- */
+    UploadsQueue queue;
+    QMap<int, QueuedUpload> active;
+    int fanoutGroup = 0;
+
+    /**
+     * @brief activeSlots, the running uploads, counting a fanout group once
+     */
+    int activeSlots() const;
+
+    /**
+     * @brief startFanoutGroup, starts the upload together with the other queued uploads of its group that can start now
+     */
+    void startFanoutGroup(const QueuedUpload& first, Tibier& tibier);
+    void notifyQueued(const QueuedUpload& upload);
+    void saveQueue();
+    void restoreQueue();
+
+    void createUploadHandler(int code, Tibier& tibier, const QString& filePath,
+                             QSharedPointer<FanoutSource> fanout = QSharedPointer<FanoutSource>(), int fanoutId = -1,
+                             MulticastSender* multicast = nullptr, const SwarmOffer& swarm = SwarmOffer());
+
+    /**
+     * @brief createMulticastSender, starts the MulticastSender of a fanout group in its own thread
+     */
+    MulticastSender* createMulticastSender(QSharedPointer<ItemStream> stream, int members);
+
+    /**
+     * @brief createSwarm, the chunks of the item are served by the SwarmServer (as long as the handlers of the group exist)
+     * @return a null offer if the SwarmServer is not listening
+     */
+    SwarmOffer createSwarm(QSharedPointer<ItemStream> stream);
     void connectUploadHandler(UploadHandler* handler);
     void clearSelectionSession();
     void computeFileNames(QVector<QString>& fileNames);
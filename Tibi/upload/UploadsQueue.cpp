@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "UploadsQueue.h"
+
+void UploadsQueue::enqueue(const QueuedUpload& upload) {
+    int position = queue.size();
+    while( position > 0 && queue.at(position-1).priority < upload.priority ) {
+        position--;
+    }
+    queue.insert(position, upload);
+}
+
+int UploadsQueue::size() const {
+    return queue.size();
+}
+
+const QueuedUpload& UploadsQueue::at(int i) const {
+    return queue.at(i);
+}
+
+QueuedUpload UploadsQueue::takeAt(int i) {
+    return queue.takeAt(i);
+}
+
+int UploadsQueue::indexOf(int code) const {
+    for( int i = 0; i < queue.size(); i++ ) {
+        if( queue.at(i).code == code ) return i;
+    }
+    return -1;
+}
+
+bool UploadsQueue::contains(int code) const {
+    return indexOf(code) >= 0;
+}
+
+bool UploadsQueue::remove(int code) {
+    int i = indexOf(code);
+    if( i < 0 ) return false;
+    queue.removeAt(i);
+    return true;
+}
+
+bool UploadsQueue::setPaused(int code, bool paused) {
+    int i = indexOf(code);
+    if( i < 0 ) return false;
+    queue[i].paused = paused;
+    return true;
+}
+
+bool UploadsQueue::setPriority(int code, int priority) {
+    int i = indexOf(code);
+    if( i < 0 ) return false;
+    QueuedUpload upload = queue.takeAt(i);
+    upload.priority = priority;
+    enqueue(upload);
+    return true;
+}
+
+bool UploadsQueue::prioritize(int code) {
+    int i = indexOf(code);
+    if( i < 0 ) return false;
+    QueuedUpload upload = queue.takeAt(i);
+    if( !queue.isEmpty() && queue.first().priority >= upload.priority ) {
+        upload.priority = queue.first().priority + 1;
+    }
+    queue.prepend(upload);
+    return true;
+}
+
+void UploadsQueue::save(QSettings& settings) const {
+    settings.remove("uploadsQueue");
+    settings.beginWriteArray("uploadsQueue", queue.size());
+    for( int i = 0; i < queue.size(); i++ ) {
+        settings.setArrayIndex(i);
+        settings.setValue("tibierId", queue.at(i).tibierId.toString());
+        settings.setValue("tibierName", queue.at(i).tibierName);
+        settings.setValue("itemPath", queue.at(i).itemPath);
+        settings.setValue("priority", queue.at(i).priority);
+        settings.setValue("paused", queue.at(i).paused);
+        settings.setValue("fanoutGroup", queue.at(i).fanoutGroup);
+    }
+    settings.endArray();
+}
+
+void UploadsQueue::restore(QSettings& settings) {
+    int size = settings.beginReadArray("uploadsQueue");
+    for( int i = 0; i < size; i++ ) {
+        settings.setArrayIndex(i);
+        QueuedUpload upload;
+        upload.tibierId = QUuid(settings.value("tibierId").toString());
+        upload.tibierName = settings.value("tibierName").toString();
+        upload.itemPath = settings.value("itemPath").toString();
+        upload.priority = settings.value("priority", 0).toInt();
+        upload.paused = settings.value("paused", false).toBool();
+        upload.fanoutGroup = settings.value("fanoutGroup", -1).toInt();
+        if( upload.tibierId.isNull() || upload.itemPath.isEmpty() ) continue;
+        enqueue(upload);
+    }
+    settings.endArray();
+}
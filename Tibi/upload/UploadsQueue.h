@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef UPLOADSQUEUE_H
+#define UPLOADSQUEUE_H
+
+#include <QList>
+#include <QUuid>
+#include <QString>
+#include <QSettings>
+
+#define PRIORITY_LOW -1
+#define PRIORITY_NORMAL 0
+#define PRIORITY_HIGH 1
+
+/**
+ * @brief The QueuedUpload class, an upload request waiting in the UploadsQueue for a free slot
+ * (or for its tibier to come online). It holds just what is needed to create the UploadHandler later
+ * and to persist the request in the settings.
+ */
+class QueuedUpload {
+public:
+    QueuedUpload() {}
+    int code = 0;
+    QUuid tibierId;
+    QString tibierName;
+    QString itemPath;
+    int priority = 0;
+    bool paused = false;
+
+    /**
+     * @brief fanoutGroup, the uploads of the same item selected for several tibiers at once share the group:
+     * the ones started together read the item once (-1 if not part of a group)
+     */
+    int fanoutGroup = -1;
+};
+
+/**
+ * @brief The UploadsQueue class keeps the pending uploads ordered by priority. Uploads with the
+ * same priority are kept in FIFO order. The queue can be saved in and restored from the settings,
+ * so that the pending uploads survive an application restart.
+ */
+class UploadsQueue
+{
+public:
+    UploadsQueue() {}
+
+    /**
+     * @brief enqueue, inserts the upload after the last one with a greater or equal priority
+     */
+    void enqueue(const QueuedUpload& upload);
+
+    int size() const;
+    const QueuedUpload& at(int i) const;
+    QueuedUpload takeAt(int i);
+    int indexOf(int code) const;
+    bool contains(int code) const;
+
+    /**
+     * @brief remove, removes the upload with the given code
+     * @return true if the upload was queued, false otherwise
+     */
+    bool remove(int code);
+
+    /**
+     * @brief setPaused, a paused upload keeps its position but it is skipped when looking for the next upload to start
+     * @return true if the upload was queued, false otherwise
+     */
+    bool setPaused(int code, bool paused);
+
+    /**
+     * @brief setPriority, moves the upload after the last one with a greater or equal priority
+     * @return true if the upload was queued, false otherwise
+     */
+    bool setPriority(int code, int priority);
+
+    /**
+     * @brief prioritize, moves the upload to the head of the queue by giving it a priority higher than the current head
+     * @return true if the upload was queued, false otherwise
+     */
+    bool prioritize(int code);
+
+    /**
+     * @brief save and restore the queue in the "uploadsQueue" array of the settings.
+     * The upload codes are not persisted, the dispatcher assigns new ones at restore time.
+     */
+    void save(QSettings& settings) const;
+    void restore(QSettings& settings);
+
+private:
+    QList<QueuedUpload> queue;
+
+};
+
+#endif // UPLOADSQUEUE_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef LINKSTATS_H
+#define LINKSTATS_H
+
+#include <QString>
+#include <QtGlobal>
+
+#define LINK_EWMA_WEIGHT 0.3
+#define LINK_MIN_SAMPLE_BYTES 1024*1024
+#define LINK_MIN_SAMPLE_TIME 500            // ms
+#define LINK_MAX_BLOCK_SIZE 256*1024
+
+/**
+ * @brief The LinkStats class, what is known of the path to a tibier: the round trip time measured by TibiLinkProber,
+ * the throughput reached by the uploads to it, both as exponentially weighted moving averages (LINK_EWMA_WEIGHT
+ * for the new sample), and the kind of local interface the path goes through.
+ * An upload is a sample only if it sent at least LINK_MIN_SAMPLE_BYTES in LINK_MIN_SAMPLE_TIME ms: a smaller one only measures the latency.
+ */
+class LinkStats {
+
+public:
+    enum Medium : quint8 {
+        Routed = 0,     // no local interface is on the subnet of the tibier
+        Wired = 1,
+        Wireless = 2,
+        Virtual = 3,    // VPN, tunnel or bridge
+        Local = 4       // the same machine
+    };
+
+    double rtt = 0;             // ms, 0 if never measured
+    double throughput = 0;      // bytes/s, 0 if never measured
+    quint8 medium = Routed;
+    qint64 probed = 0;          // s since epoch of the last probe
+
+    /**
+     * @param ms, negative if the probe failed: only the time of the probe is recorded
+     */
+    void addRtt(double ms, quint8 medium, qint64 now) {
+        probed = now;
+        if( ms < 0 ) return;
+        rtt = rtt == 0 ? ms : (1 - LINK_EWMA_WEIGHT) * rtt + LINK_EWMA_WEIGHT * ms;
+        this->medium = medium;
+    }
+
+    /**
+     * @return false if the upload is too small to be a sample
+     */
+    bool addThroughput(qint64 bytes, qint64 msecs) {
+        if( bytes < LINK_MIN_SAMPLE_BYTES || msecs < LINK_MIN_SAMPLE_TIME ) return false;
+        double sample = bytes * 1000.0 / msecs;
+        throughput = throughput == 0 ? sample : (1 - LINK_EWMA_WEIGHT) * throughput + LINK_EWMA_WEIGHT * sample;
+        return true;
+    }
+
+    /**
+     * @brief expectedSpeed, in bytes/s, 0 if unknown
+     */
+    qint64 expectedSpeed() const {
+        return static_cast<qint64>(throughput);
+    }
+
+    /**
+     * @brief blockSize, the bytes read and written at once by an upload: a quarter of the bandwidth-delay product,
+     * so that a fast or long path is kept full with few writes, between minimum and LINK_MAX_BLOCK_SIZE
+     */
+    int blockSize(int minimum) const {
+        if( throughput == 0 || rtt == 0 ) return minimum;
+        qint64 bdp = static_cast<qint64>(throughput * rtt / 1000);
+        qint64 blocks = qMax<qint64>(1, bdp / 4 / minimum);
+        return static_cast<int>(qMin<qint64>(blocks * minimum, LINK_MAX_BLOCK_SIZE));
+    }
+
+    /**
+     * @brief text, the expected speed (or the round trip time, if no upload measured it yet) and the medium, empty if nothing is known
+     */
+    QString text() const {
+        static const char* const media[] = { "", "ethernet", "wi-fi", "vpn", "local" };
+        QString measure;
+        if( throughput > 0 ) {
+            measure = throughput >= 1024*1024 ? QString::number(throughput / (1024*1024), 'f', 1) + " MB/s"
+                                              : QString::number(qMax(1.0, throughput / 1024), 'f', 0) + " KB/s";
+        } else if( rtt > 0 ) {
+            measure = QString::number(qMax(1.0, rtt), 'f', 0) + " ms";
+        }
+        if( measure.isEmpty() ) return "";
+        QString mediumText = medium <= Local ? media[medium] : "";
+        return mediumText.isEmpty() ? measure : measure + " - " + mediumText;
+    }
+
+};
+
+#endif // LINKSTATS_H
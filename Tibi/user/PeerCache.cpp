@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "PeerCache.h"
+
+QVector<Tibier> PeerCache::load() {
+    QVector<Tibier> tibiers;
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    int size = settings.beginReadArray("peerCache");
+    for( int i = 0; i < size; i++ ) {
+        settings.setArrayIndex(i);
+        Tibier tibier;
+        tibier.id = QUuid(settings.value("id").toString());
+        tibier.username = settings.value("username").toString();
+        for( const QString& address : settings.value("addresses").toStringList() ) {
+            tibier.addresses.push_back(QHostAddress(address));
+        }
+        tibier.address = tibier.addresses.isEmpty() ? QHostAddress() : tibier.addresses.first();
+        tibier.port = settings.value("port", 0).toInt();
+        tibier.profilePort = settings.value("profilePort", 0).toInt();
+        tibier.capabilities = static_cast<quint16>(settings.value("capabilities", 0).toUInt());
+        tibier.nameHash = settings.value("nameHash", 0).toUInt();
+        tibier.avatarHash = settings.value("avatarHash", 0).toUInt();
+        tibier.avatarCode = tibier.avatarHash == 0 ? 0 : 1;
+        tibier.pingInterval = settings.value("pingInterval", 5).toInt();
+        tibier.lastPing = settings.value("lastSeen", 0).toLongLong();
+        tibier.link.rtt = settings.value("rtt", 0).toDouble();
+        tibier.link.throughput = settings.value("throughput", 0).toDouble();
+        tibier.link.medium = static_cast<quint8>(settings.value("medium", LinkStats::Routed).toUInt());
+        tibier.online = false;
+        tibier.updateAvatarPath();
+        if( tibier.id.isNull() || tibier.username.isEmpty() || expired(tibier) ) continue;
+        tibiers.push_back(tibier);
+    }
+    settings.endArray();
+    qDebug() << "PEER CACHE:" << tibiers.size() << "tibiers restored";
+    return tibiers;
+}
+
+void PeerCache::save(QVector<Tibier> tibiers) {
+    // the most recent first
+    std::sort(tibiers.begin(), tibiers.end(), [](const Tibier& a, const Tibier& b) { return a.lastPing > b.lastPing; });
+    QVector<Tibier> kept;
+    for( const Tibier& tibier : tibiers ) {
+        if( kept.size() >= PEER_CACHE_MAX ) break;
+        if( tibier.username.isEmpty() || expired(tibier) ) continue;
+        kept.push_back(tibier);
+    }
+
+    QSettings settings("valentina-di-vincenzo, Tibi");
+    settings.remove("peerCache");
+    settings.beginWriteArray("peerCache", kept.size());
+    for( int i = 0; i < kept.size(); i++ ) {
+        const Tibier& tibier = kept.at(i);
+        settings.setArrayIndex(i);
+        QStringList addresses;
+        for( const QHostAddress& address : tibier.addresses ) {
+            addresses.push_back(address.toString());
+        }
+        settings.setValue("id", tibier.id.toString());
+        settings.setValue("username", tibier.username);
+        settings.setValue("addresses", addresses);
+        settings.setValue("port", tibier.port);
+        settings.setValue("profilePort", tibier.profilePort);
+        settings.setValue("capabilities", tibier.capabilities);
+        settings.setValue("nameHash", tibier.nameHash);
+        settings.setValue("avatarHash", tibier.avatarHash);
+        settings.setValue("pingInterval", tibier.pingInterval);
+        settings.setValue("lastSeen", tibier.lastPing);
+        settings.setValue("rtt", tibier.link.rtt);
+        settings.setValue("throughput", tibier.link.throughput);
+        settings.setValue("medium", tibier.link.medium);
+    }
+    settings.endArray();
+
+    prune(kept);
+}
+
+void PeerCache::prune(const QVector<Tibier>& tibiers) {
+    QSet<QString> used;
+    for( const Tibier& tibier : tibiers ) {
+        if( tibier.avatarHash != 0 ) used.insert(QFileInfo(tibier.avatarPath).fileName());
+    }
+
+    QDir avatarsDir(QFileInfo(Tibier::avatarPathFor(0)).absolutePath());
+    for( const QString& avatar : avatarsDir.entryList(QDir::Files) ) {
+        if( !used.contains(avatar) ) avatarsDir.remove(avatar);
+    }
+}
+
+bool PeerCache::expired(const Tibier& tibier) {
+    return QDateTime::currentSecsSinceEpoch() - tibier.lastPing > PEER_CACHE_MAX_AGE;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef PEERCACHE_H
+#define PEERCACHE_H
+
+#include <QVector>
+#include <QSet>
+#include <QSettings>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <algorithm>
+#include "user/tibier.h"
+
+#define PEER_CACHE_MAX_AGE RECENTLY_SEEN_TIME
+#define PEER_CACHE_MAX 256
+
+/**
+ * @brief The PeerCache class keeps the known tibiers between launches, in the "peerCache" setting: the last addresses,
+ * capabilities, username, avatar hash and LinkStats of each one, so that at the next start they are shown as recently seen before
+ * any beacon arrives, and their username and avatar are not fetched again.
+ * Only the PEER_CACHE_MAX tibiers seen most recently, in the last PEER_CACHE_MAX_AGE s, are kept: the registry forgets
+ * the older ones (see UserHandler::purgeTibiers), so a longer age would keep tibiers the running application already dropped.
+ * The avatars are stored by hash (see Tibier::avatarPathFor): the ones no cached tibier uses anymore are removed with prune.
+ */
+class PeerCache
+{
+public:
+    /**
+     * @brief load, the cached tibiers, all offline
+     */
+    static QVector<Tibier> load();
+    static void save(QVector<Tibier> tibiers);
+
+    /**
+     * @brief prune, removes the avatars not used by the tibiers
+     */
+    static void prune(const QVector<Tibier>& tibiers);
+
+private:
+    static bool expired(const Tibier& tibier);
+
+};
+
+#endif // PEERCACHE_H
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TibiersRegistry.h"
+
+TibiersRegistry::TibiersRegistry() :
+    snapshot(std::make_shared<const QVector<Tibier>>()),
+    dirty(false)
+{}
+
+TibiersRegistry::Shard& TibiersRegistry::shardOf(const QUuid& id) {
+    return shards[qHash(id) % REGISTRY_SHARDS];
+}
+
+const TibiersRegistry::Shard& TibiersRegistry::shardOf(const QUuid& id) const {
+    return shards[qHash(id) % REGISTRY_SHARDS];
+}
+
+bool TibiersRegistry::lookup(const QUuid& id, Tibier& tibier) const {
+    const Shard& shard = shardOf(id);
+    QReadLocker rl(&shard.lock);
+    QSharedPointer<Entry> entry = shard.entries.value(id);
+    if( entry.isNull() ) return false;
+    tibier = entry->tibier;
+    tibier.lastPing = entry->lastPing.load();
+    return true;
+}
+
+bool TibiersRegistry::touch(const QUuid& id, qint64 lastPing) {
+    const Shard& shard = shardOf(id);
+    QReadLocker rl(&shard.lock);
+    QSharedPointer<Entry> entry = shard.entries.value(id);
+    if( entry.isNull() || !entry->tibier.online ) return false;
+    entry->lastPing.store(lastPing);
+    return true;
+}
+
+bool TibiersRegistry::upsert(const Tibier& tibier) {
+    Shard& shard = shardOf(tibier.id);
+    QWriteLocker wl(&shard.lock);
+    QSharedPointer<Entry> entry = shard.entries.value(tibier.id);
+    bool wasOnline = !entry.isNull() && entry->tibier.online;
+    if( entry.isNull() ) {
+        entry = QSharedPointer<Entry>(new Entry);
+        shard.entries.insert(tibier.id, entry);
+        entry->tibier.link = tibier.link;
+    }
+    LinkStats link = entry->tibier.link;
+    entry->tibier = tibier;
+    entry->tibier.link = link;
+    entry->lastPing.store(tibier.lastPing);
+    dirty.store(true);
+    return wasOnline;
+}
+
+bool TibiersRegistry::expireIfSilent(const QUuid& id, qint64 now, Tibier& expired, qint64& deadline) {
+    Shard& shard = shardOf(id);
+    QWriteLocker wl(&shard.lock);
+    deadline = -1;
+    QSharedPointer<Entry> entry = shard.entries.value(id);
+    if( entry.isNull() || !entry->tibier.online ) return false;
+
+    if( entry->vouched.load() ) entry->lastPing.store(now);
+    if( entry->lastPing.load() + entry->tibier.maxSilence() >= now ) {
+        deadline = entry->lastPing.load() + entry->tibier.maxSilence();
+        return false;
+    }
+
+    entry->tibier.online = false;
+    expired = entry->tibier;
+    expired.lastPing = entry->lastPing.load();
+    dirty.store(true);
+    return true;
+}
+
+bool TibiersRegistry::vouch(const QUuid& id, bool vouched) {
+    const Shard& shard = shardOf(id);
+    QReadLocker rl(&shard.lock);
+    QSharedPointer<Entry> entry = shard.entries.value(id);
+    if( entry.isNull() ) return false;
+    entry->vouched.store(vouched);
+    return true;
+}
+
+QSharedPointer<QReadWriteLock> TibiersRegistry::avatarLock(const QUuid& id) const {
+    const Shard& shard = shardOf(id);
+    QReadLocker rl(&shard.lock);
+    QSharedPointer<Entry> entry = shard.entries.value(id);
+    if( entry.isNull() ) return nullptr;
+    return entry->tibier.avatar_m;
+}
+
+QVector<Tibier> TibiersRegistry::purge() {
+    QVector<Tibier> purged;
+    for( Shard& shard : shards ) {
+        QWriteLocker wl(&shard.lock);
+        for( auto entry = shard.entries.begin(); entry != shard.entries.end(); ) {
+            Tibier tibier = (*entry)->tibier;
+            tibier.lastPing = (*entry)->lastPing.load();
+            if( tibier.recentlySeen() ) {
+                ++entry;
+                continue;
+            }
+            purged.push_back(tibier);
+            entry = shard.entries.erase(entry);
+        }
+    }
+    return purged;
+}
+
+bool TibiersRegistry::updateLink(const QUuid& id, const std::function<void(LinkStats&)>& update, Tibier& updated) {
+    Shard& shard = shardOf(id);
+    QWriteLocker wl(&shard.lock);
+    QSharedPointer<Entry> entry = shard.entries.value(id);
+    if( entry.isNull() ) return false;
+    update(entry->tibier.link);
+    updated = entry->tibier;
+    updated.lastPing = entry->lastPing.load();
+    if( entry->tibier.online ) dirty.store(true);
+    return true;
+}
+
+std::shared_ptr<const QVector<Tibier>> TibiersRegistry::online() const {
+    if( !dirty.load() ) return std::atomic_load(&snapshot);
+
+    QMutexLocker ml(&rebuild_m);
+    // another reader may have rebuilt it while this one was waiting
+    if( !dirty.exchange(false) ) return std::atomic_load(&snapshot);
+
+    auto rebuilt = std::make_shared<QVector<Tibier>>();
+    for( const Shard& shard : shards ) {
+        QReadLocker rl(&shard.lock);
+        for( const QSharedPointer<Entry>& entry : shard.entries ) {
+            if( !entry->tibier.online ) continue;
+            rebuilt->push_back(entry->tibier);
+            rebuilt->last().lastPing = entry->lastPing.load();
+        }
+    }
+    std::shared_ptr<const QVector<Tibier>> published = rebuilt;
+    std::atomic_store(&snapshot, published);
+    return published;
+}
+
+QVector<Tibier> TibiersRegistry::all() const {
+    QVector<Tibier> tibiers;
+    for( const Shard& shard : shards ) {
+        QReadLocker rl(&shard.lock);
+        for( const QSharedPointer<Entry>& entry : shard.entries ) {
+            tibiers.push_back(entry->tibier);
+            tibiers.last().lastPing = entry->lastPing.load();
+        }
+    }
+    return tibiers;
+}
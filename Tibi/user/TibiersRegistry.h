@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIBIERSREGISTRY_H
+#define TIBIERSREGISTRY_H
+
+#include <QHash>
+#include <QVector>
+#include <QUuid>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include "user/tibier.h"
+
+#define REGISTRY_SHARDS 16
+
+/**
+ * @brief The TibiersRegistry class, the table of the known tibiers, built for many readers and many pings.
+ * - the tibiers are split in REGISTRY_SHARDS shards by id, each with its own lock, so a ping only locks the shard of its tibier;
+ * - the time of the last ping is atomic, so a ping that doesn't change anything only takes the read lock;
+ * - the online tibiers are published as an immutable snapshot, rebuilt only after a change, so the views and the dispatchers
+ *   read them without taking any lock.
+ */
+class TibiersRegistry
+{
+public:
+    TibiersRegistry();
+
+    /**
+     * @brief lookup, copies the tibier with the given id
+     * @return false if the tibier is unknown
+     */
+    bool lookup(const QUuid& id, Tibier& tibier) const;
+
+    /**
+     * @brief touch, records a ping that didn't change the tibier
+     * @return false if the tibier is unknown or offline
+     */
+    bool touch(const QUuid& id, qint64 lastPing);
+
+    /**
+     * @brief upsert, inserts the tibier or replaces the stored one, except its link stats
+     * @return true if the stored tibier was online: read under the same lock, so an expiry that ran meanwhile is never missed
+     */
+    bool upsert(const Tibier& tibier);
+
+    /**
+     * @brief expireIfSilent, sets the tibier offline if it hasn't pinged for more than its Tibier::maxSilence. A vouched tibier
+     * is never silent: its ping is recorded here.
+     * @param now, in s since epoch
+     * @param expired, the tibier set offline
+     * @param deadline, when the tibier will expire if it is still online (in s since epoch), -1 if it is unknown or already offline
+     * @return true if the tibier has been set offline
+     */
+    bool expireIfSilent(const QUuid& id, qint64 now, Tibier& expired, qint64& deadline);
+
+    /**
+     * @brief vouch, a vouched tibier is kept online without pings (see expireIfSilent), until vouch is called again with false
+     * @return false if the tibier is unknown
+     */
+    bool vouch(const QUuid& id, bool vouched);
+
+    QSharedPointer<QReadWriteLock> avatarLock(const QUuid& id) const;
+
+    /**
+     * @brief purge, removes the offline tibiers that are not recently seen anymore (see Tibier::recentlySeen)
+     * @return the removed tibiers
+     */
+    QVector<Tibier> purge();
+
+    /**
+     * @brief updateLink, applies update to the link stats of the tibier
+     * @param updated, the tibier after the update
+     * @return false if the tibier is unknown
+     */
+    bool updateLink(const QUuid& id, const std::function<void(LinkStats&)>& update, Tibier& updated);
+
+    /**
+     * @brief online, the snapshot of the online tibiers. It is lock-free unless the registry changed since the last call.
+     */
+    std::shared_ptr<const QVector<Tibier>> online() const;
+
+    /**
+     * @brief all, copies every known tibier, online or not
+     */
+    QVector<Tibier> all() const;
+
+private:
+    class Entry {
+    public:
+        Tibier tibier;
+        std::atomic<qint64> lastPing;
+        std::atomic<bool> vouched { false };
+    };
+
+    class Shard {
+    public:
+        mutable QReadWriteLock lock;
+        QHash<QUuid, QSharedPointer<Entry>> entries;
+    };
+
+    Shard shards[REGISTRY_SHARDS];
+    mutable std::shared_ptr<const QVector<Tibier>> snapshot;
+    mutable std::atomic<bool> dirty;
+    mutable QMutex rebuild_m;
+
+    Shard& shardOf(const QUuid& id);
+    const Shard& shardOf(const QUuid& id) const;
+
+};
+
+#endif // TIBIERSREGISTRY_H
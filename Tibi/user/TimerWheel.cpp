@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel() : slots(WHEEL_SLOTS) {}
+
+void TimerWheel::schedule(const QUuid& id, qint64 deadline) {
+    QMutexLocker ml(&wheel_m);
+    // an empty wheel is not advanced, so it restarts from now
+    if( count == 0 ) lastTick = QDateTime::currentMSecsSinceEpoch();
+
+    qint64 ticks = (deadline - lastTick + WHEEL_TICK - 1) / WHEEL_TICK;
+    if( ticks < 1 ) ticks = 1;
+
+    Timer timer;
+    timer.id = id;
+    timer.rounds = static_cast<int>((ticks-1) / WHEEL_SLOTS);
+    slots[(current + ticks) % WHEEL_SLOTS].push_back(timer);
+    count++;
+}
+
+QVector<QUuid> TimerWheel::advance(qint64 now) {
+    QMutexLocker ml(&wheel_m);
+    QVector<QUuid> expired;
+
+    while( count > 0 && lastTick + WHEEL_TICK <= now ) {
+        lastTick += WHEEL_TICK;
+        current = (current + 1) % WHEEL_SLOTS;
+
+        QVector<Timer>& slot = slots[current];
+        int kept = 0;
+        for( int i = 0; i < slot.size(); i++ ) {
+            if( slot.at(i).rounds == 0 ) {
+                expired.push_back(slot.at(i).id);
+                count--;
+            } else {
+                slot[i].rounds--;
+                slot[kept++] = slot.at(i);
+            }
+        }
+        slot.resize(kept);
+    }
+
+    if( count == 0 ) lastTick = now;
+    return expired;
+}
+
+bool TimerWheel::isEmpty() {
+    QMutexLocker ml(&wheel_m);
+    return count == 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QVector>
+#include <QUuid>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDateTime>
+
+#define WHEEL_SLOTS 64
+#define WHEEL_TICK 1000
+
+/**
+ * @brief The TimerWheel class, a hashed timer wheel of WHEEL_SLOTS slots advanced every WHEEL_TICK ms.
+ * A timer is put in the slot of its deadline, with the number of whole rounds of the wheel to wait before it expires,
+ * so scheduling is O(1) and each tick only looks at the timers of one slot, whatever the number of timers.
+ * Schedule and advance can be called from different threads.
+ */
+class TimerWheel
+{
+public:
+    TimerWheel();
+
+    /**
+     * @brief schedule, the timer of id expires the first tick after deadline
+     * @param deadline, in ms since epoch
+     */
+    void schedule(const QUuid& id, qint64 deadline);
+
+    /**
+     * @brief advance, moves the wheel up to now
+     * @return the ids whose timer expired
+     */
+    QVector<QUuid> advance(qint64 now);
+    bool isEmpty();
+
+private:
+    class Timer {
+    public:
+        QUuid id;
+        int rounds;
+    };
+
+    QMutex wheel_m;
+    QVector<QVector<Timer>> slots;
+    int current = 0;
+    qint64 lastTick = 0;
+    int count = 0;
+
+};
+
+#endif // TIMERWHEEL_H
@@ -27,42 +27,56 @@ void UserHandler::createUser() {
     //.jpg
     connect(&disconnectedTimer, &QTimer::timeout, this, &UserHandler::checkDisconnected);
     connect(this, &UserHandler::startToCheckDisconnected, this, &UserHandler::checkDisconnected, Qt::QueuedConnection);
+    connect(&purgeTimer, &QTimer::timeout, this, &UserHandler::purgeTibiers);
+    purgeTimer.start(REGISTRY_PURGE_TIME);
 }
 
 
-bool UserHandler::checkIfNewAvatarTibier(const QUuid& id, int newAvatarCode) {
-    QReadLocker rl(&connected_m);
-    if( !tibiers.contains(id) ) return true; //new tibier
-    if( tibiers.value(id)->avatarCode != newAvatarCode) return true; //old tibier but new avatar
-    return false;
+bool UserHandler::lookupTibier(const QUuid& id, Tibier& tibier) {
+    return registry.lookup(id, tibier);
+}
+
+bool UserHandler::touchTibier(const QUuid& id, qint64 lastPing) {
+    return registry.touch(id, lastPing);
+}
+
+bool UserHandler::vouchTibier(const QUuid& id, bool vouched) {
+    return registry.vouch(id, vouched);
 }
 
 
 void UserHandler::checkDisconnected() {
-    if( !disconnectedTimer.isActive() ) disconnectedTimer.start(DISCONNECTED_CHECK_TIME);
-    QWriteLocker ml(&connected_m);
+    if( !disconnectedTimer.isActive() ) disconnectedTimer.start(WHEEL_TICK);
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
     bool somethingChanged = false;
-    bool tibiersOnline = false;
-    //qDebug() << "Registred tibier: " << tibiers.size();
-    for( auto t : tibiers ) {
-        //qDebug() << "tibier online? " << t->online;
-        if ( !t->online ) continue;
-        qint64 diff = QDateTime::currentSecsSinceEpoch() - t->lastPing;
-        //qDebug() << "user handler: diff between last ping " << diff;
-        if( diff > MAX_TIME_BETWEEN_PING) {
+
+    for( const QUuid& id : expiry.advance(now) ) {
+        Tibier expired;
+        qint64 deadline;
+        if( registry.expireIfSilent(id, now/1000, expired, deadline) ) {
             somethingChanged = true;
-            t->online = false;
-            //qDebug() << "user handler: removing tibier " << t->username;
-            emit removeTibierFromSelected(t->id.toString());
-        } else {
-            tibiersOnline = true;
+            //qDebug() << "user handler: removing tibier " << expired.username;
+            emit removeTibierFromSelected(expired.id.toString());
+            emit tibierChanged(expired);
+        } else if( deadline >= 0 ) {
+            // it pinged in the meantime
+            expiry.schedule(id, deadline * 1000 + WHEEL_TICK);
         }
     }
 
     if( somethingChanged ) {
         emit updateConnectedTibiers();
     }
-    if( !tibiersOnline ) disconnectedTimer.stop();
+    if( expiry.isEmpty() ) disconnectedTimer.stop();
+}
+
+
+
+void UserHandler::purgeTibiers() {
+    // offline, so the views remove them
+    for( const Tibier& purged : registry.purge() ) {
+        emit tibierChanged(purged);
+    }
 }
 
 
@@ -84,7 +98,7 @@ const QUuid& UserHandler::getId() {
 }
 
 
-const QString& UserHandler::getDownloadPath() {
+QString UserHandler::getDownloadPath() {
     QReadLocker rl(&downloadPath_m);
     return downloadPath;
 }
@@ -102,7 +116,14 @@ QString UserHandler::getUsername() {
 
 void UserHandler::setUsername(const QString &newUsername) {
     QWriteLocker wl(&username_m);
+    if( user.username == newUsername ) return;
     user.username = newUsername;
+    wl.unlock();
+    emit usernameChanged();
+}
+
+int UserHandler::countOnlineTibiers() {
+    return registry.online()->size();
 }
 
 
@@ -153,38 +174,33 @@ void UserHandler::updateUserAvatar(qint8 avatarCode) {
 }
 
 QSharedPointer<QReadWriteLock> UserHandler::getLockFromId(const QUuid& id) {
-    QWriteLocker wl(&connected_m);
-    if( tibiers.contains(id)) {
-        return tibiers.value(id)->avatar_m;
-    }
-    else return nullptr;
+    return registry.avatarLock(id);
 }
 
 
 QSharedPointer<QVector<Tibier>> UserHandler::readCurrentlyConnectedTibiers() {
-    qDebug() << "read currently connected tibiers called";
-    QReadLocker rl(&connected_m);
-    QSharedPointer<QVector<Tibier>> connectedTibier = QSharedPointer<QVector<Tibier>>(new QVector<Tibier>);
-    for( auto t : tibiers ) {
-        qDebug() << "handler get tibier: " << t->username
-                 << "\tonline? " << t->online;
-        if( t->online )
-            connectedTibier->push_back(*t);
-    }
-    return connectedTibier;
+    std::shared_ptr<const QVector<Tibier>> online = registry.online();
+    return QSharedPointer<QVector<Tibier>>(new QVector<Tibier>(*online));
 }
 
 
 
-QSharedPointer<QVector<Tibier>> UserHandler::getTibiersFromId(const QVector<QString>& selectedId) {
-    QReadLocker rl(&connected_m);
+QSharedPointer<QVector<Tibier>> UserHandler::readRecentlySeenTibiers() {
+    QSharedPointer<QVector<Tibier>> recent = QSharedPointer<QVector<Tibier>>(new QVector<Tibier>);
+    for( const Tibier& tibier : registry.all() ) {
+        if( !tibier.online && tibier.recentlySeen() ) recent->push_back(tibier);
+    }
+    return recent;
+}
+
+
+QSharedPointer<QVector<Tibier>> UserHandler::getTibiersFromId(const QVector<QString>& selectedId, bool includeOffline) {
     QSharedPointer<QVector<Tibier>> selectedTibiers = QSharedPointer<QVector<Tibier>>(new QVector<Tibier>);
     for( auto idString : selectedId ) {
         qDebug() << "handler get tibier - id: " << idString;
-        QUuid id(idString);
-        if( !tibiers.contains(id) ) continue;
-        Tibier selected = *tibiers.value(id);
-        if ( !selected.online ) continue;
+        Tibier selected;
+        if( !registry.lookup(QUuid(idString), selected) ) continue;
+        if ( !selected.online && !(includeOffline && selected.recentlySeen()) ) continue;
         selectedTibiers->push_back(selected);
         qDebug() << "handler get tibier - username: " << selected.username;
 
@@ -193,77 +209,73 @@ QSharedPointer<QVector<Tibier>> UserHandler::getTibiersFromId(const QVector<QStr
 }
 
 
-void UserHandler::newPing(QSharedPointer<Tibier> tibierPing, QSharedPointer<QByteArray> avatarArrayPing) {
+void UserHandler::newPing(QSharedPointer<Tibier> tibierPing) {
 
     if( !disconnectedTimer.isActive() ) emit startToCheckDisconnected();
-    QWriteLocker wl(&connected_m);
 
-    newTibierPing = tibierPing;
-    this->avatarArrayPing = avatarArrayPing;
-    if( !tibiers.contains(newTibierPing->id) ) {
-        saveNewTibier();
+    Tibier known;
+    if( !registry.lookup(tibierPing->id, known) ) {
+        saveNewTibier(tibierPing);
         return;
     }
 
-    updateOldTibier();
+    if( known.username == tibierPing->username && known.avatarHash == tibierPing->avatarHash && known.online == tibierPing->online
+            && known.address == tibierPing->address && known.addresses == tibierPing->addresses && known.port == tibierPing->port && known.profilePort == tibierPing->profilePort
+            && known.pingInterval == tibierPing->pingInterval ) {
+        // the common case: only the time of the last ping changes, no write lock is taken
+        if( registry.touch(tibierPing->id, tibierPing->lastPing) ) return;
+        // expired since the lookup: it comes back online
+    }
+
+    updateOldTibier(known, tibierPing);
 }
 
 
-void UserHandler::saveNewTibier() {
-    qDebug() << QThread::currentThreadId() << " - USER HANDLER: New Tibier Connected" << newTibierPing->username;
-    tibiers.insert(newTibierPing->id, newTibierPing);
-    saveNewTibierAvatar(newTibierPing->avatarPath, avatarArrayPing);
+void UserHandler::saveNewTibier(QSharedPointer<Tibier> tibierPing) {
+    qDebug() << QThread::currentThreadId() << " - USER HANDLER: New Tibier Connected" << tibierPing->username;
+    bool wasOnline = registry.upsert(*tibierPing);
+    if( tibierPing->online && !wasOnline ) expiry.schedule(tibierPing->id, (tibierPing->lastPing + tibierPing->maxSilence()) * 1000 + WHEEL_TICK);
+    emit tibierChanged(*tibierPing);
     emit updateConnectedTibiers();
 }
 
-void UserHandler::updateOldTibier() {
-    tibierToUpdate = tibiers.value(newTibierPing->id);
-    tibierToUpdate->lastPing = newTibierPing->lastPing;
-    if( newUsername() || newAvatar() || newState() ) {
-        emit updateConnectedTibiers();
-    }
+void UserHandler::updateOldTibier(const Tibier& known, QSharedPointer<Tibier> tibierPing) {
+    // the stored tibier keeps its avatar lock
+    Tibier updated = *tibierPing;
+    updated.avatar_m = known.avatar_m;
+    bool wasOnline = registry.upsert(updated);
 
-}
-
-bool UserHandler::newUsername() {
-    if( tibierToUpdate->username != newTibierPing->username ) {
-        tibierToUpdate->username = newTibierPing->username;
-        return true;
-    }
+    // back online after being expired, possibly by an expiry that ran after the lookup
+    if( !wasOnline && updated.online ) expiry.schedule(updated.id, (updated.lastPing + updated.maxSilence()) * 1000 + WHEEL_TICK);
 
-    return false;
+    emit tibierChanged(updated);
+    emit updateConnectedTibiers();
 }
 
-bool UserHandler::newAvatar() {
-    if( tibierToUpdate->avatarCode != newTibierPing->avatarCode) {
-        tibierToUpdate->avatarCode = newTibierPing->avatarCode;
-        if( tibierToUpdate->avatarCode != 0 ) {
-            QWriteLocker wl(tibierToUpdate->avatar_m.data());
-            saveNewTibierAvatar(tibierToUpdate->avatarPath, avatarArrayPing);
-        }
-        return true;
-    }
-    return false;
-}
+void UserHandler::saveNewTibierAvatar(const QUuid& id, const QString& avatarPath, QSharedPointer<QByteArray> avatarArrayPing) {
+    if( avatarArrayPing.isNull() || QFile::exists(avatarPath) ) return;
+    QSaveFile avatarFile(avatarPath);
+    if( !avatarFile.open(QIODevice::WriteOnly) ) return;
+    avatarFile.write(*avatarArrayPing);
+    if( !avatarFile.commit() ) return;
 
-bool UserHandler::newState() {
-    if( tibierToUpdate->online != newTibierPing->online ) {
-        tibierToUpdate->online = newTibierPing->online;
-        return true;
-    }
-    return false;
+    Tibier known;
+    if( registry.lookup(id, known) && known.avatarPath == avatarPath ) emit tibierChanged(known);
 }
 
-void UserHandler::saveNewTibierAvatar(const QString& avatarPath, QSharedPointer<QByteArray> avatarArrayPing) {
-    QFile avatarFile(avatarPath);
-    if(avatarFile.open(QIODevice::WriteOnly)) {
 
-        qint64 written = 0;
-        while( written < avatarArrayPing->size() ) {
-            written += avatarFile.write(*avatarArrayPing);
-        }
-    }
+void UserHandler::recordRtt(const QUuid& id, double rttMsecs, quint8 medium) {
+    Tibier updated;
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+    if( !registry.updateLink(id, [=](LinkStats& link) { link.addRtt(rttMsecs, medium, now); }, updated) ) return;
+    if( rttMsecs >= 0 ) emit tibierChanged(updated);
+}
 
+void UserHandler::recordThroughput(const QUuid& id, qint64 bytes, qint64 msecs) {
+    Tibier updated;
+    bool sample = false;
+    if( !registry.updateLink(id, [&](LinkStats& link) { sample = link.addThroughput(bytes, msecs); }, updated) ) return;
+    if( sample ) emit tibierChanged(updated);
 }
 
 
@@ -279,7 +291,16 @@ void UserHandler::restoreSettings() {
         firstSettings(std::move(settings));
     }
     fillSettings(std::move(settings));
-    user.id = QUuid::createUuid();
+
+    // the id is kept between launches, so that the other tibiers (and their queued uploads) can recognise us after a restart
+    QSettings idSettings("valentina-di-vincenzo, Tibi");
+    user.id = QUuid(idSettings.value("id").toString());
+    if( user.id.isNull() ) {
+        user.id = QUuid::createUuid();
+        idSettings.setValue("id", user.id.toString());
+    }
+
+    restorePeerCache();
 
     qDebug() << user.username
              << downloadPath
@@ -290,6 +311,13 @@ void UserHandler::restoreSettings() {
 
 }
 
+void UserHandler::restorePeerCache() {
+    for( const Tibier& tibier : PeerCache::load() ) {
+        if( tibier.id == user.id ) continue;
+        registry.upsert(tibier);
+    }
+}
+
 void UserHandler::firstSettings(QSettings&& settings) {
     settings.setValue("firstSetting", "no");
     QString username = qgetenv("USER");
@@ -317,8 +345,8 @@ void UserHandler::fillSettings(QSettings&& settings) {
 
 void UserHandler::saveSettings() {
 
-    QDir avatarsDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/avatars");
-    avatarsDir.removeRecursively();
+    // the known tibiers and their avatars are kept for the next launch
+    PeerCache::save(registry.all());
 
     QSettings settings("valentina-di-vincenzo, Tibi");
     settings.setValue("name", user.username);
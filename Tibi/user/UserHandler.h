@@ -18,10 +18,13 @@
 #include <QTimer>
 #include <QSharedPointer>
 #include <QStandardPaths>
+#include <QSaveFile>
 #include "user/tibier.h"
+#include "user/TibiersRegistry.h"
+#include "user/TimerWheel.h"
+#include "user/PeerCache.h"
 
-#define DISCONNECTED_CHECK_TIME 10*1000
-#define MAX_TIME_BETWEEN_PING 12
+#define REGISTRY_PURGE_TIME 60*60*1000
 
 
 class UserHandler : public QObject
@@ -41,6 +44,11 @@ public:
     QString getUsername();
     void setUsername(const QString& newUsername);
 
+    /**
+     * @brief countOnlineTibiers, lock-free unless the online tibiers changed since the last read
+     */
+    int countOnlineTibiers();
+
     /**
      * @brief Thread-safe getter for avatarcode
      */
@@ -68,9 +76,9 @@ public:
 
     /**
      * @brief Thread-safe set and get downloadPath
-     * @return const ref to download path
+     * @return a copy of the download path, taken under the lock: it is read by the handlers on the I/O threads
      */
-    const QString& getDownloadPath();
+    QString getDownloadPath();
     void setDownloadPath(const QString& newPath);
 
     const QHostAddress& getAddress();
@@ -92,34 +100,58 @@ public:
     */
     QSharedPointer<QVector<Tibier>> readCurrentlyConnectedTibiers();
 
+    /**
+     * @brief readRecentlySeenTibiers, the offline tibiers seen in the last RECENTLY_SEEN_TIME s, in this session or in a previous one
+     */
+    QSharedPointer<QVector<Tibier>> readRecentlySeenTibiers();
+
     /**
       * @brief given a vector of ids, returns the corresponding tibiers, if online. Used by UploadDispatcher.
       * @param const QVector<QString>& - the vector of selected string id
+      * @param includeOffline - the recently seen tibiers are returned too
       * @return QSharedPointer<QVector<Tibier>> - a shared pointer to the vector of tibiers
     */
-    QSharedPointer<QVector<Tibier>> getTibiersFromId(const QVector<QString>& selectedId);
+    QSharedPointer<QVector<Tibier>> getTibiersFromId(const QVector<QString>& selectedId, bool includeOffline = false);
 
     /**
-     * @brief checkIfNewAvatarTibier, check if the avatar code is different from the one stored or if it is new
-     * @param id
-     * @param avatarCode
-     * @return true if TibiDiscovery has to save the avatar, false otherwise
+     * @brief lookupTibier, copies the known tibier with the given id, online or not
+     * @return false if the tibier is unknown
      */
-    bool checkIfNewAvatarTibier(const QUuid& id, int avatarCode);
+    bool lookupTibier(const QUuid& id, Tibier& tibier);
+
+    /**
+     * @brief touchTibier, records a ping identical to the previous one of the same tibier, without copying it
+     * @return false if the tibier is unknown or offline: the ping must go through newPing
+     */
+    bool touchTibier(const QUuid& id, qint64 lastPing);
+
+    /**
+     * @brief vouchTibier, the tibier is kept online while a TibiDirectory vouches for it, see TibiersRegistry::vouch
+     * @return false if the tibier is unknown
+     */
+    bool vouchTibier(const QUuid& id, bool vouched);
 
     /**
      * @brief newPing, analyse a new ping, probabily updating the field of the tibier
-     * @param tibier, the object where the new info are stored
-     * @param avatarArrayPing, the avatarArray downloaded and to be saved, if necessary
+     * @param tibier, the object where the new info are stored, its avatar (if any) already saved in the avatars directory
      */
-    void newPing(QSharedPointer<Tibier> tibier, QSharedPointer<QByteArray> avatarArrayPing = nullptr);
+    void newPing(QSharedPointer<Tibier> tibier);
 
     /**
-     * @brief saveNewTibierAvatar thread-safe way to save the new avatar ping related to a connected tibier
+     * @brief saveNewTibierAvatar thread-safe way to save an avatar received from a tibier: it is written aside and renamed,
+     * so a reader never sees a partial file. The tibier, if known, is notified with tibierChanged: its avatar file may have been missing.
+     * @param id, the tibier the avatar was fetched from
      * @param avatarPath
      * @param avatarArrayPing
      */
-    void saveNewTibierAvatar(const QString& avatarPath, QSharedPointer<QByteArray> avatarArrayPing);
+    void saveNewTibierAvatar(const QUuid& id, const QString& avatarPath, QSharedPointer<QByteArray> avatarArrayPing);
+
+    /**
+     * @brief recordRtt and recordThroughput, thread-safe: add a sample to the LinkStats of the tibier (a negative rtt for a failed probe).
+     * The views are notified with tibierChanged.
+     */
+    void recordRtt(const QUuid& id, double rttMsecs, quint8 medium);
+    void recordThroughput(const QUuid& id, qint64 bytes, qint64 msecs);
 
 
 public slots:
@@ -128,8 +160,15 @@ public slots:
 signals:
     void userReady();
     void updateConnectedTibiers();
+
+    /**
+     * @brief tibierChanged, emitted with a copy of the tibier each time it connects, disconnects (online is false) or changes its username or avatar.
+     * It allows the views to apply keyed incremental updates instead of reading all the connected tibiers again.
+     */
+    void tibierChanged(const Tibier& tibier);
     void removeTibierFromSelected(QString id);
     bool updateAvatarPing(qint8 avatarCode);
+    void usernameChanged();
     void updateStatus(bool online);
 
 private:
@@ -145,33 +184,43 @@ private:
 
     /* -- tibier connected --*/
     QTimer disconnectedTimer;
-    QReadWriteLock connected_m;
-    QMap<QUuid, QSharedPointer<Tibier>> tibiers;
+    QTimer purgeTimer;
+    TibiersRegistry registry;
+    TimerWheel expiry;
 
     /* -- new ping -- */
-    QSharedPointer<Tibier> newTibierPing;
-    QSharedPointer<Tibier> tibierToUpdate;
-    QSharedPointer<QByteArray> avatarArrayPing;
-    bool newTibier();
-    void saveNewTibier();
-    void updateOldTibier();
-    bool newUsername();
-    bool newAvatar();
-    bool newState();
+    void saveNewTibier(QSharedPointer<Tibier> tibierPing);
+    void updateOldTibier(const Tibier& known, QSharedPointer<Tibier> tibierPing);
 
 
     /**
      * @brief restoreSettings, restores the setting and creates the avatar direcotry using QStandsPaths::AppDataLocation
      */
     void restoreSettings();
+
+    /**
+     * @brief restorePeerCache, adds the tibiers known in the previous sessions to the registry, offline
+     */
+    void restorePeerCache();
     void firstSettings(QSettings&& settings);
     void fillSettings(QSettings&& settings);
 
     void saveSettings();
 
 private slots:
+    /**
+     * @brief checkDisconnected, advances the expiry wheel every WHEEL_TICK ms: the tibiers whose timer expired are set offline
+     * if they haven't pinged for Tibier::maxSilence s, otherwise their timer is moved to the new deadline.
+     * A ping never touches the wheel, only a tibier that comes online is scheduled.
+     */
     void checkDisconnected();
 
+    /**
+     * @brief purgeTibiers, every REGISTRY_PURGE_TIME ms the tibiers offline for longer than RECENTLY_SEEN_TIME are forgotten,
+     * so that the registry doesn't grow with every tibier ever seen
+     */
+    void purgeTibiers();
+
 signals:
     void startToCheckDisconnected();
 
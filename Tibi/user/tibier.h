@@ -9,11 +9,18 @@
 #define TIBIER_H
 #include <QUuid>
 #include <QHostAddress>
+#include <QList>
 #include <QString>
 #include <QDir>
 #include <QReadWriteLock>
 #include <QStandardPaths>
 #include <QSharedPointer>
+#include <QDateTime>
+#include "user/LinkStats.h"
+
+#define MAX_TIME_BETWEEN_PING 12
+#define PINGS_BEFORE_DISCONNECTED 3
+#define RECENTLY_SEEN_TIME 7*24*3600    // s
 
 class Tibier {
 
@@ -24,16 +31,44 @@ public:
 
     QUuid id;
     QHostAddress address;
-    bool online;
+    QList<QHostAddress> addresses;  // every address advertised by the tibier
+    bool online = false;
     int port = 0;
     QString username;
     qint64 lastPing = 0;
     qint8 avatarCode = 0;
-    QString avatarPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/avatars/" + id.toString() + ".jpg";
+    int profilePort = 0;
+    quint16 capabilities = 0;
+    quint32 nameHash = 0;
+    quint32 avatarHash = 0;     // 0 for the default avatar
+    int pingInterval = 5;       // s, advertised by the tibier
+    QString avatarPath = avatarPathFor(0);
+    LinkStats link;             // measured by this tibier, kept when the tibier pings again
     bool operator ==(const Tibier& t);
     QSharedPointer<QReadWriteLock> avatar_m;
+
+    /**
+     * @brief avatarPathFor, the avatars are stored by content: tibiers with the same avatar share the file, and a file never changes
+     */
+    static QString avatarPathFor(quint32 avatarHash) {
+        static const QString avatarsDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/avatars/";
+        return avatarsDir + QString::number(avatarHash, 16).rightJustified(8, '0') + ".jpg";
+    }
+    /**
+     * @brief maxSilence, the seconds without pings after which the tibier is considered disconnected:
+     * it follows the interval the tibier advertises, but never less than MAX_TIME_BETWEEN_PING
+     */
+    qint64 maxSilence() const {
+        return qMax<qint64>(MAX_TIME_BETWEEN_PING, pingInterval * PINGS_BEFORE_DISCONNECTED);
+    }
+    /**
+     * @brief recentlySeen, an offline tibier seen in the last RECENTLY_SEEN_TIME s is still shown, and the uploads to it are queued
+     */
+    bool recentlySeen() const {
+        return online || QDateTime::currentSecsSinceEpoch() - lastPing <= RECENTLY_SEEN_TIME;
+    }
     void updateAvatarPath() {
-        avatarPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/avatars/" + id.toString() + ".jpg";
+        avatarPath = avatarPathFor(avatarHash);
     }
 
 
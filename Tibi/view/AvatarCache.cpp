@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "AvatarCache.h"
+
+AvatarCache::AvatarCache() {
+    cache.setMaxCost(MAX_CACHED_AVATARS);
+}
+
+QPixmap AvatarCache::avatar(qint8 avatarCode, const QString& avatarPath, QSharedPointer<QReadWriteLock> avatar_m) {
+    if( avatarCode == 0 ) return QPixmap();
+
+    if( QPixmap* cached = cache.object(avatarPath) ) return *cached;
+
+    QPixmap pixmap;
+    {
+        QReadLocker rl(avatar_m.data());
+        pixmap.load(avatarPath);
+    }
+    if( pixmap.isNull() ) {
+        cache.insert(avatarPath, new QPixmap());
+        return pixmap;
+    }
+
+    pixmap = pixmap.scaled(AVATAR_SIZE, AVATAR_SIZE, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+    cache.insert(avatarPath, new QPixmap(pixmap));
+    return pixmap;
+}
+
+void AvatarCache::forgetMiss(const QString& avatarPath) {
+    QPixmap* cached = cache.object(avatarPath);
+    if( cached != nullptr && cached->isNull() ) cache.remove(avatarPath);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef AVATARCACHE_H
+#define AVATARCACHE_H
+
+#include <QCache>
+#include <QPixmap>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+
+#define AVATAR_SIZE 70
+#define MAX_CACHED_AVATARS 500
+
+/**
+ * @brief The AvatarCache class keeps the decoded avatars of the tibiers, keyed by their path.
+ * The avatars are stored by content hash, so the path changes every time a tibier changes its avatar and an entry never
+ * needs to be invalidated: the old one simply stops being requested and is evicted when the cache is full.
+ * A file that can't be read (not fetched yet, or pruned) is cached as a null pixmap too, so that it is not read again at each paint:
+ * the miss is forgotten with forgetMiss when the tibier changes, e.g. when its avatar arrives.
+ */
+class AvatarCache
+{
+public:
+    AvatarCache();
+
+    /**
+     * @brief avatar, returns the avatar scaled to AVATAR_SIZE, decoding the file only the first time it is requested.
+     * @return a null pixmap if the tibier has no avatar (avatarCode 0) or the file can't be read
+     */
+    QPixmap avatar(qint8 avatarCode, const QString& avatarPath, QSharedPointer<QReadWriteLock> avatar_m);
+
+    /**
+     * @brief forgetMiss, the avatar is read again at the next request, if its file couldn't be read before
+     */
+    void forgetMiss(const QString& avatarPath);
+
+private:
+    QCache<QString, QPixmap> cache;
+
+};
+
+#endif // AVATARCACHE_H
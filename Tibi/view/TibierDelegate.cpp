@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TibierDelegate.h"
+
+void TibierDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    QPixmap avatar = index.data(Qt::DecorationRole).value<QPixmap>();
+    bool selected = index.data(TibiersModel::SelectedRole).toBool();
+    bool online = index.data(TibiersModel::OnlineRole).toBool();
+    QRectF avatarRect(option.rect.center().x() - 35, option.rect.y() + 12, 70, 70);
+
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    // a recently seen tibier is dimmed until its next beacon
+    if( !online ) painter->setOpacity(0.4);
+
+    if( selected ) {
+        QLinearGradient ring(avatarRect.topLeft(), avatarRect.bottomRight());
+        ring.setColorAt(0, "#FF2F92");
+        ring.setColorAt(1, "#00FDFF");
+        painter->setPen(QPen(QBrush(ring), 3));
+        painter->setBrush(Qt::NoBrush);
+        painter->drawEllipse(avatarRect.adjusted(-8, -8, 8, 8));
+    }
+
+    painter->setPen(Qt::NoPen);
+    if( avatar.isNull() ) {
+        QLinearGradient gradient(avatarRect.topLeft(), avatarRect.bottomRight());
+        gradient.setColorAt(0, "#00FDFF");
+        gradient.setColorAt(1, "#FF2F92");
+        painter->setBrush(gradient);
+        painter->drawEllipse(avatarRect);
+    } else {
+        QPainterPath clip;
+        clip.addEllipse(avatarRect);
+        painter->setClipPath(clip);
+        painter->drawPixmap(avatarRect.toRect(), avatar);
+        painter->setClipping(false);
+    }
+
+    QRect nameRect(option.rect.x(), option.rect.y() + 95, option.rect.width(), option.rect.height() - 95);
+    QString name = option.fontMetrics.elidedText(index.data(Qt::DisplayRole).toString().toUpper(), Qt::ElideRight, nameRect.width() - 10);
+    painter->setPen(Qt::white);
+    painter->drawText(nameRect, Qt::AlignHCenter | Qt::AlignTop, name);
+
+    QString link = index.data(TibiersModel::LinkRole).toString();
+    if( !link.isEmpty() ) {
+        QFont font = option.font;
+        font.setPointSize(8);
+        QRect linkRect = nameRect.adjusted(0, option.fontMetrics.height() + 2, 0, 0);
+        painter->setFont(font);
+        painter->setPen(QColor("#C0C0C0"));
+        painter->drawText(linkRect, Qt::AlignHCenter | Qt::AlignTop, QFontMetrics(font).elidedText(link, Qt::ElideRight, linkRect.width() - 10));
+    }
+    painter->restore();
+}
+
+QSize TibierDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    Q_UNUSED(option);
+    Q_UNUSED(index);
+    return QSize(145, 140);
+}
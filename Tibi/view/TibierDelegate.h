@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIBIERDELEGATE_H
+#define TIBIERDELEGATE_H
+
+#include <QStyledItemDelegate>
+#include <QPainter>
+#include <QPainterPath>
+#include <QLinearGradient>
+#include "view/TibiersModel.h"
+
+/**
+ * @brief The TibierDelegate class paints a tibier of the TibiersModel as ClickableLabel does:
+ * the rounded avatar (or the default gradient), the selection ring and the username.
+ */
+class TibierDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit TibierDelegate(QObject* parent = nullptr) : QStyledItemDelegate(parent) {}
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+};
+
+#endif // TIBIERDELEGATE_H
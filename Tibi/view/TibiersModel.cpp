@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TibiersModel.h"
+
+TibiersModel::TibiersModel(QObject* parent) : QAbstractListModel(parent) {}
+
+int TibiersModel::rowCount(const QModelIndex& parent) const {
+    if( parent.isValid() ) return 0;
+    return tibiers.size();
+}
+
+QVariant TibiersModel::data(const QModelIndex& index, int role) const {
+    if( !index.isValid() || index.row() >= tibiers.size() ) return QVariant();
+    const Tibier& t = tibiers.at(index.row());
+
+    switch( role ) {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        return t.username;
+    case Qt::DecorationRole:
+        // decoded only when the row is painted, then served from the cache
+        return avatars.avatar(t.avatarCode, t.avatarPath, t.avatar_m);
+    case IdRole:
+        return t.id.toString();
+    case SelectedRole:
+        return selected.contains(t.id);
+    case OnlineRole:
+        return t.online;
+    case LinkRole:
+        return t.link.text();
+    default:
+        return QVariant();
+    }
+}
+
+void TibiersModel::reset(const QVector<Tibier>& newTibiers) {
+    beginResetModel();
+    tibiers.clear();
+    rowOfId.clear();
+    QSet<QUuid> stillSelected;
+    for( const Tibier& t : newTibiers ) {
+        if( !t.recentlySeen() ) continue;
+        rowOfId.insert(t.id, tibiers.size());
+        tibiers.push_back(t);
+        if( selected.contains(t.id) ) stillSelected.insert(t.id);
+    }
+    selected = stillSelected;
+    endResetModel();
+}
+
+void TibiersModel::upsertTibier(const Tibier& tibier) {
+    if( !tibier.recentlySeen() ) {
+        removeTibier(tibier.id);
+        return;
+    }
+
+    // the avatar may have just been fetched
+    avatars.forgetMiss(tibier.avatarPath);
+
+    if( rowOfId.contains(tibier.id) ) {
+        int row = rowOfId.value(tibier.id);
+        tibiers[row] = tibier;
+        emit dataChanged(index(row), index(row));
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), tibiers.size(), tibiers.size());
+    rowOfId.insert(tibier.id, tibiers.size());
+    tibiers.push_back(tibier);
+    endInsertRows();
+}
+
+void TibiersModel::removeTibier(const QUuid& id) {
+    if( !rowOfId.contains(id) ) return;
+    int row = rowOfId.value(id);
+
+    beginRemoveRows(QModelIndex(), row, row);
+    rowOfId.remove(id);
+    selected.remove(id);
+    tibiers.remove(row);
+    reindex(row);
+    endRemoveRows();
+}
+
+void TibiersModel::toggleSelected(int row) {
+    if( row < 0 || row >= tibiers.size() ) return;
+    setSelected(tibiers.at(row).id, !selected.contains(tibiers.at(row).id));
+}
+
+void TibiersModel::setSelected(const QUuid& id, bool select) {
+    if( !rowOfId.contains(id) ) {
+        selected.remove(id);
+        return;
+    }
+    if( select ) selected.insert(id);
+    else selected.remove(id);
+    int row = rowOfId.value(id);
+    emit dataChanged(index(row), index(row), {SelectedRole});
+}
+
+QVector<QString> TibiersModel::selectedIds() const {
+    QVector<QString> ids;
+    for( const QUuid& id : selected ) {
+        ids.push_back(id.toString());
+    }
+    return ids;
+}
+
+void TibiersModel::clearSelection() {
+    QSet<QUuid> wasSelected = selected;
+    selected.clear();
+    for( const QUuid& id : wasSelected ) {
+        if( !rowOfId.contains(id) ) continue;
+        int row = rowOfId.value(id);
+        emit dataChanged(index(row), index(row), {SelectedRole});
+    }
+}
+
+void TibiersModel::reindex(int from) {
+    for( int i = from; i < tibiers.size(); i++ ) {
+        rowOfId[tibiers.at(i).id] = i;
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TIBIERSMODEL_H
+#define TIBIERSMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include "user/tibier.h"
+#include "view/AvatarCache.h"
+
+/**
+ * @brief The TibiersModel class holds the tibiers shown in ViewConnectedTibiers: the online ones and the recently seen ones
+ * (see Tibier::recentlySeen), which are shown dimmed and can be selected, their uploads wait in the queue until they are back.
+ * It is updated one tibier at a time (insert, update or remove keyed by id), so a ping that changes
+ * a single tibier never touches the other rows. The selection of the user is part of the model.
+ */
+class TibiersModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Role {
+        IdRole = Qt::UserRole + 1,  // QString: the id of the tibier
+        SelectedRole,               // bool: the tibier is selected
+        OnlineRole,                 // bool: the tibier is online, otherwise only recently seen
+        LinkRole                    // QString: the expected speed of the link to the tibier (LinkStats::text), empty if unknown
+    };
+
+    explicit TibiersModel(QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    /**
+     * @brief reset, replaces all the rows with the online and recently seen tibiers in the vector, keeping the selection of the ones still shown
+     */
+    void reset(const QVector<Tibier>& tibiers);
+
+    /**
+     * @brief upsertTibier, inserts or updates the row of the tibier, or removes it if the tibier is offline and not recently seen
+     */
+    void upsertTibier(const Tibier& tibier);
+    void removeTibier(const QUuid& id);
+
+    void toggleSelected(int row);
+    void setSelected(const QUuid& id, bool selected);
+    QVector<QString> selectedIds() const;
+    void clearSelection();
+
+private:
+    QVector<Tibier> tibiers;
+    QHash<QUuid, int> rowOfId;
+    QSet<QUuid> selected;
+    mutable AvatarCache avatars;
+
+    void reindex(int from);
+
+};
+
+#endif // TIBIERSMODEL_H
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TransferDelegate.h"
+
+void TransferDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    switch( index.column() ) {
+    case TransfersModel::ProgressColumn:
+        paintProgress(painter, option, index.data(TransfersModel::ProgressRole).toInt());
+        break;
+    case TransfersModel::PauseColumn:
+    case TransfersModel::ActionColumn:
+    case TransfersModel::TopColumn:
+        paintButton(painter, option, index.data(TransfersModel::ButtonRole).toString());
+        break;
+    default:
+        paintText(painter, option, index);
+    }
+}
+
+QSize TransferDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    Q_UNUSED(option);
+    Q_UNUSED(index);
+    return QSize(80, 40);
+}
+
+void TransferDelegate::paintText(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    QColor color = Qt::white;
+    if( index.column() == TransfersModel::StatusColumn ) color = index.data(TransfersModel::StatusColorRole).value<QColor>();
+    QString text = option.fontMetrics.elidedText(index.data(Qt::DisplayRole).toString(), Qt::ElideMiddle, option.rect.width() - 10);
+
+    painter->save();
+    painter->setPen(color);
+    painter->drawText(option.rect.adjusted(5, 0, -5, 0), Qt::AlignLeft | Qt::AlignVCenter, text);
+    painter->restore();
+}
+
+void TransferDelegate::paintProgress(QPainter* painter, const QStyleOptionViewItem& option, int progress) const {
+    if( progress == TransfersModel::NO_PROGRESS ) return;
+
+    QRectF track(option.rect.x() + 5, option.rect.center().y() - 6, option.rect.width() - 10, 13);
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setPen(Qt::NoPen);
+
+    if( progress == TransfersModel::BUSY_PROGRESS ) {
+        // waiting for the other tibier or aborting
+        painter->setBrush(QColor("#212121"));
+        painter->drawRoundedRect(track, 6, 6);
+        painter->restore();
+        return;
+    }
+
+    painter->setBrush(QColor("#C0C0C0"));
+    painter->drawRoundedRect(track, 6, 6);
+    if( progress > 0 ) {
+        QRectF chunk = track;
+        chunk.setWidth(track.width() * qMin(progress, 100) / 100.0);
+        QLinearGradient gradient(track.topLeft(), track.topRight());
+        gradient.setColorAt(0, "#00FDFF");
+        gradient.setColorAt(0.9, "#FF2F92");
+        painter->setBrush(gradient);
+        painter->drawRoundedRect(chunk, 6, 6);
+    }
+    painter->restore();
+}
+
+void TransferDelegate::paintButton(QPainter* painter, const QStyleOptionViewItem& option, const QString& text) const {
+    if( text.isEmpty() ) return;
+
+    QRectF button(option.rect.x() + 5, option.rect.center().y() - 12, option.rect.width() - 10, 25);
+    QFont font = option.font;
+    font.setPointSize(8);
+    font.setBold(true);
+
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(QColor("#C0C0C0"));
+    painter->drawRoundedRect(button, 10, 10);
+    painter->setPen(QColor("#212121"));
+    painter->setFont(font);
+    painter->drawText(button, Qt::AlignCenter, text.toUpper());
+    painter->restore();
+}
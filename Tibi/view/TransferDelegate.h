@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TRANSFERDELEGATE_H
+#define TRANSFERDELEGATE_H
+
+#include <QStyledItemDelegate>
+#include <QPainter>
+#include <QPainterPath>
+#include <QLinearGradient>
+#include "view/TransfersModel.h"
+
+/**
+ * @brief The TransferDelegate class paints the cells of a TransfersModel row: the progress bar and the buttons
+ * are painted (there are no widgets per row), and the clicks on the buttons are handled by ViewUD through the clicked signal of the view.
+ */
+class TransferDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit TransferDelegate(QObject* parent = nullptr) : QStyledItemDelegate(parent) {}
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+private:
+    void paintText(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const;
+    void paintProgress(QPainter* painter, const QStyleOptionViewItem& option, int progress) const;
+    void paintButton(QPainter* painter, const QStyleOptionViewItem& option, const QString& text) const;
+
+};
+
+#endif // TRANSFERDELEGATE_H
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include "TransfersModel.h"
+
+TransfersModel::TransfersModel(bool upload, QObject* parent) :
+    QAbstractTableModel(parent),
+    upload(upload)
+{
+    updateTimer.setSingleShot(true);
+    updateTimer.setInterval(UPDATE_BATCH_TIME);
+    connect(&updateTimer, &QTimer::timeout, this, &TransfersModel::flushUpdates);
+}
+
+int TransfersModel::rowCount(const QModelIndex& parent) const {
+    if( parent.isValid() ) return 0;
+    return rows.size();
+}
+
+int TransfersModel::columnCount(const QModelIndex& parent) const {
+    if( parent.isValid() ) return 0;
+    return ColumnCount;
+}
+
+QVariant TransfersModel::data(const QModelIndex& index, int role) const {
+    if( !index.isValid() || index.row() >= rows.size() ) return QVariant();
+    const TransferRow& row = rows.at(index.row());
+
+    if( role == Qt::DisplayRole ) {
+        switch( index.column() ) {
+        case TibierColumn: return row.tibierName;
+        case ItemColumn: return row.itemName;
+        case StatusColumn: return statusText(row);
+        default: return QVariant();
+        }
+    }
+
+    if( role == Qt::ToolTipRole && index.column() == ItemColumn ) return row.itemName;
+    if( role == ProgressRole ) return progress(row);
+    if( role == ButtonRole ) return buttonText(row, index.column());
+    if( role == StatusColorRole ) return statusColor(row);
+
+    return QVariant();
+}
+
+void TransfersModel::addTransfer(int code, const QString& tibierName, const QString& itemName) {
+    TransferRow row;
+    row.code = code;
+    row.tibierName = tibierName;
+    row.itemName = itemName;
+
+    beginInsertRows(QModelIndex(), rows.size(), rows.size());
+    rowOfCode.insert(code, rows.size());
+    rows.push_back(row);
+    endInsertRows();
+}
+
+void TransfersModel::updateTransfer(int code, int perc, const QTime& time, const QString& info, const QString& path) {
+    if( !rowOfCode.contains(code) ) {
+        qDebug() << "There is no corresponding code!";
+        return;
+    }
+
+    int i = rowOfCode.value(code);
+    TransferRow& row = rows[i];
+    row.perc = perc;
+    row.info = info;
+    row.time = info == "" ? time : QTime(0,0,0);
+    if( !path.isNull() ) row.path = path;
+    if( info == "PAUSED" ) row.paused = true;
+    else if( info == "" ) row.paused = false;
+
+    if( perc >= 100 && !row.finished ) {
+        row.finished = true;
+        row.aborting = false;
+        finishedCount++;
+    }
+
+    markDirty(i);
+}
+
+void TransfersModel::renameTransfer(int code, const QString& newName) {
+    if( !rowOfCode.contains(code) ) return;
+    int i = rowOfCode.value(code);
+    rows[i].itemName = newName;
+    markDirty(i);
+}
+
+const TransferRow& TransfersModel::rowAt(int row) const {
+    return rows.at(row);
+}
+
+void TransfersModel::setAborting(int row) {
+    rows[row].aborting = true;
+    rows[row].info = "ABORTING..";
+    rows[row].time = QTime(0,0,0);
+    markDirty(row);
+}
+
+bool TransfersModel::togglePaused(int row) {
+    rows[row].paused = !rows[row].paused;
+    markDirty(row);
+    return rows[row].paused;
+}
+
+void TransfersModel::removeFinished(int row) {
+    if( !rows.at(row).finished ) return;
+    finishedCount--;
+    removeRowAt(row);
+}
+
+void TransfersModel::markDirty(int row) {
+    dirtyRows.insert(row);
+    if( !updateTimer.isActive() ) updateTimer.start();
+}
+
+void TransfersModel::flushUpdates() {
+    QList<int> changed = dirtyRows.values();
+    dirtyRows.clear();
+    std::sort(changed.begin(), changed.end());
+
+    // one dataChanged for each range of contiguous rows
+    int i = 0;
+    while( i < changed.size() ) {
+        int first = changed.at(i);
+        int last = first;
+        while( i+1 < changed.size() && changed.at(i+1) == last+1 ) {
+            i++;
+            last++;
+        }
+        if( last < rows.size() ) emit dataChanged(index(first, 0), index(last, ColumnCount-1));
+        i++;
+    }
+
+    if( finishedCount > MAX_FINISHED_ROWS ) removeOldestFinished();
+}
+
+void TransfersModel::removeOldestFinished() {
+    int i = 0;
+    while( finishedCount > MAX_FINISHED_ROWS && i < rows.size() ) {
+        if( rows.at(i).finished ) {
+            removeFinished(i);
+        } else {
+            i++;
+        }
+    }
+}
+
+void TransfersModel::removeRowAt(int row) {
+    beginRemoveRows(QModelIndex(), row, row);
+    rowOfCode.remove(rows.at(row).code);
+    rows.remove(row);
+    reindex(row);
+    endRemoveRows();
+
+    // the dirty rows after the removed one moved up by one
+    QSet<int> shifted;
+    for( int dirty : dirtyRows ) {
+        if( dirty < row ) shifted.insert(dirty);
+        else if( dirty > row ) shifted.insert(dirty-1);
+    }
+    dirtyRows = shifted;
+}
+
+void TransfersModel::reindex(int from) {
+    for( int i = from; i < rows.size(); i++ ) {
+        rowOfCode[rows.at(i).code] = i;
+    }
+}
+
+QString TransfersModel::statusText(const TransferRow& row) const {
+    if( row.info != "" ) return row.info;
+    return "- "
+            + (row.time.hour() < 10 ? "0" + QString::number(row.time.hour()) :  QString::number(row.time.hour())) + " h "
+            + (row.time.minute() < 10 ? "0" + QString::number(row.time.minute()) :  QString::number(row.time.minute())) + " m "
+            + (row.time.second() < 10 ? "0" + QString::number(row.time.second()) :  QString::number(row.time.second())) + " s";
+}
+
+QString TransfersModel::buttonText(const TransferRow& row, int column) const {
+    if( row.aborting ) return "";
+
+    if( column == PauseColumn ) {
+        if( row.finished ) return !upload && row.info == "COMPLETED" ? "open" : "";
+        return row.paused ? "resume" : "pause";
+    }
+
+    if( column == ActionColumn ) {
+        return row.finished ? "remove" : "abort";
+    }
+
+    if( column == TopColumn ) {
+        // only a queued upload can be moved to the head of the queue
+        return upload && row.info == "QUEUED" ? "top" : "";
+    }
+
+    return "";
+}
+
+int TransfersModel::progress(const TransferRow& row) const {
+    if( row.finished ) return NO_PROGRESS;
+    if( row.aborting ) return BUSY_PROGRESS;
+    if( row.perc == 0 && row.info != "QUEUED" && row.info != "PAUSED" ) return BUSY_PROGRESS;
+    return row.perc;
+}
+
+QColor TransfersModel::statusColor(const TransferRow& row) const {
+    if( row.info == "" || row.info == "WAITING" || row.info == "QUEUED" || row.info == "PAUSED" || row.aborting ) return QColor(Qt::white);
+    if( upload && row.info == "COMPLETED" ) return QColor("#00FDFF");
+    return QColor("#FF2F92");
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#ifndef TRANSFERSMODEL_H
+#define TRANSFERSMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QTime>
+#include <QTimer>
+#include <QColor>
+#include <QDebug>
+#include <algorithm>
+
+#define UPDATE_BATCH_TIME 200
+#define MAX_FINISHED_ROWS 100
+
+/**
+ * @brief The TransferRow class, the state of a single upload or download shown in ViewUD
+ */
+class TransferRow {
+public:
+    TransferRow() {}
+    int code = 0;
+    QString tibierName;
+    QString itemName;
+    QString info = "elaborating..";
+    QTime time = QTime(0,0,0);
+    int perc = 0;
+    QString path;
+    bool paused = false;
+    bool aborting = false;
+    bool finished = false;
+};
+
+/**
+ * @brief The TransfersModel class holds the uploads (or the downloads) shown in ViewUD.
+ * The updates coming from the dispatchers are applied immediately to the rows, but the view is notified
+ * every UPDATE_BATCH_TIME ms with a dataChanged for each range of contiguous rows that changed in the meantime.
+ * When more than MAX_FINISHED_ROWS transfers are finished, the oldest ones are removed, so that
+ * the model only holds the active and the recent transfers.
+ */
+class TransfersModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        TibierColumn = 0,
+        ItemColumn = 1,
+        StatusColumn = 2,
+        ProgressColumn = 3,
+        PauseColumn = 4,
+        ActionColumn = 5,
+        TopColumn = 6,
+        ColumnCount = 7
+    };
+
+    enum Role {
+        ProgressRole = Qt::UserRole + 1,    // int: the percentage, BUSY_PROGRESS or NO_PROGRESS
+        ButtonRole,                         // QString: the label of the button painted in the cell, empty if none
+        StatusColorRole                     // QColor: the color of the status text
+    };
+
+    static const int BUSY_PROGRESS = -1;
+    static const int NO_PROGRESS = -2;
+
+    explicit TransfersModel(bool upload, QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    void addTransfer(int code, const QString& tibierName, const QString& itemName);
+
+    /**
+     * @brief updateTransfer, applies the update to the row with the given code. The view is notified with the next batch.
+     */
+    void updateTransfer(int code, int perc, const QTime& time, const QString& info, const QString& path);
+    void renameTransfer(int code, const QString& newName);
+
+    const TransferRow& rowAt(int row) const;
+    void setAborting(int row);
+
+    /**
+     * @brief togglePaused, switches the pause state of the row
+     * @return the new pause state
+     */
+    bool togglePaused(int row);
+
+    /**
+     * @brief removeFinished, removes a finished row from the model
+     */
+    void removeFinished(int row);
+
+private slots:
+    void flushUpdates();
+
+private:
+    bool upload;
+    QVector<TransferRow> rows;
+    QHash<int, int> rowOfCode;
+    QSet<int> dirtyRows;
+    QTimer updateTimer;
+    int finishedCount = 0;
+
+    void markDirty(int row);
+    void removeOldestFinished();
+    void removeRowAt(int row);
+    void reindex(int from);
+    QString statusText(const TransferRow& row) const;
+    QString buttonText(const TransferRow& row, int column) const;
+    int progress(const TransferRow& row) const;
+    QColor statusColor(const TransferRow& row) const;
+
+};
+
+#endif // TRANSFERSMODEL_H
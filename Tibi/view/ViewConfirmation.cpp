@@ -17,7 +17,7 @@ ViewConfirmation::ViewConfirmation(const Download& download) : download(download
 
 }
 
-void ViewConfirmation::showConfirmation(QSharedPointer<QReadWriteLock> avatar_m) {
+void ViewConfirmation::showConfirmation(QSharedPointer<QReadWriteLock> avatar_m, const QString& avatarPath) {
     qDebug() << "Confirmation View called";
     QString titleText = download.usernameSender + "\nwants to send you a " + (download.type == Types::Dir? "folder" : "file") + "!";
     if( avatar_m.isNull() ) titleText.append("\nCAREFUL: this tibier is in hidden mode!");
@@ -32,8 +32,8 @@ void ViewConfirmation::showConfirmation(QSharedPointer<QReadWriteLock> avatar_m)
     QLabel* info = new QLabel(infoText);
     info->setFixedWidth(300);
     info->setWordWrap(true);
-    if( !avatar_m.isNull() ) avatar_m.data()->lockForWrite();
-    ClickableLabel *avatar = new ClickableLabel(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/avatars/" + download.idSender.toString() + ".jpg", true, true);
+    if( !avatar_m.isNull() ) avatar_m.data()->lockForRead();
+    ClickableLabel *avatar = new ClickableLabel(avatarPath, true, true);
     if( !avatar_m.isNull() ) avatar_m.data()->unlock();
 
     QPushButton* acceptButton = new QPushButton("accept");
@@ -18,7 +18,7 @@ class ViewConfirmation : public QWidget
 public:
 
     ViewConfirmation(const Download& download);
-    void showConfirmation(QSharedPointer<QReadWriteLock> avatar_m);
+    void showConfirmation(QSharedPointer<QReadWriteLock> avatar_m, const QString& avatarPath);
     int code = -1;
 
 signals:
@@ -20,6 +20,9 @@ ViewConnectedTibiers::ViewConnectedTibiers()
 
 void ViewConnectedTibiers::setUserInfo(UserHandler* user) {
     this->user = user;
+    // the tibiers of the previous sessions are shown at once, before their first beacon
+    QVector<Tibier> tibiers = *user->readCurrentlyConnectedTibiers() + *user->readRecentlySeenTibiers();
+    model.reset(tibiers);
 }
 
 void ViewConnectedTibiers::closeEvent(QCloseEvent *event)
@@ -47,65 +50,24 @@ void ViewConnectedTibiers::showConnectedTibiers(const QVector<QString>& fileName
     infoText.setMaximumWidth(width()-20);
     infoText.setWordWrap(true);
     active = true;
-    update();
+    search.clear();
+    list.scrollToTop();
 
     this->show();
     this->raise();
 }
 
-void ViewConnectedTibiers::update() {
-    if( !active ) return;
-    QSharedPointer<QVector<Tibier>> currentlyConnected = user->readCurrentlyConnectedTibiers();
-
-    initCentralWidget();
-
-    for( Tibier t : *currentlyConnected ) {
-        qDebug() << "VIEW CONNECTED: analizzo tibier: " << t.username;
-        if(!t.online) continue;
-        QLabel* username = new QLabel(t.username);
-        username->setAlignment(Qt::AlignCenter);
-        username->setStyleSheet("text-transform: uppercase;");
-        QString avatarPath;
-        t.avatarCode == 0 ? avatarPath = "" : avatarPath = t.avatarPath;
-        bool alreadySelected = false;
-        if( selected.contains(t.id.toString())) alreadySelected = true;
-        QReadLocker rl(t.avatar_m.data());
-        ClickableLabel *avatar = new ClickableLabel(avatarPath, alreadySelected);
-        rl.unlock();
-        avatar->setObjectName(t.id.toString());
-        avatar->setAlignment(Qt::AlignCenter);
-        connect(avatar, &ClickableLabel::clicked, this, &ViewConnectedTibiers::addSelected);
-        connect(avatar, &ClickableLabel::unclicked, this, &ViewConnectedTibiers::removeSelected);
-        QGridLayout* tibier = new QGridLayout;
-        tibier->addWidget(avatar, 0, 0);
-        tibier->addWidget(username, 1, 0);
-        tibier->setRowMinimumHeight(0, 93);
-        if(column == 3) {
-            row++;
-            column = 0;
-        }
-
-        tibiersConnected->addLayout(tibier, row, column, Qt::AlignCenter);
-        column++;
-
-    }
-
+void ViewConnectedTibiers::updateTibier(const Tibier& tibier) {
+    // the model is kept updated even when the dialog is hidden, so that it is ready when it is shown
+    model.upsertTibier(tibier);
 }
 
 void ViewConnectedTibiers::removeTibierFromSelected(const QString& id) {
-    if( !active ) return;
-    if( selected.contains(id) ) {
-        selected.removeOne(id);
-    }
+    model.setSelected(QUuid(id), false);
 }
 
-
-void ViewConnectedTibiers::addSelected(QString id) {
-    selected.push_back(id);
-}
-
-void ViewConnectedTibiers::removeSelected(QString id) {
-    selected.removeOne(id);
+void ViewConnectedTibiers::tibierClicked(const QModelIndex& index) {
+    model.toggleSelected(filter.mapToSource(index).row());
 }
 
 
@@ -116,6 +78,31 @@ void ViewConnectedTibiers::createDialog() {
 
     infoText.setAlignment(Qt::AlignCenter);
 
+    search.setPlaceholderText("search..");
+    search.setClearButtonEnabled(true);
+    search.setFixedWidth(450);
+
+    filter.setSourceModel(&model);
+    filter.setFilterCaseSensitivity(Qt::CaseInsensitive);
+    filter.setSortCaseSensitivity(Qt::CaseInsensitive);
+    filter.setDynamicSortFilter(true);
+    filter.sort(0);
+    connect(&search, &QLineEdit::textChanged, &filter, &QSortFilterProxyModel::setFilterFixedString);
+
+    list.setModel(&filter);
+    list.setItemDelegate(&delegate);
+    list.setViewMode(QListView::IconMode);
+    list.setFlow(QListView::LeftToRight);
+    list.setWrapping(true);
+    list.setResizeMode(QListView::Adjust);
+    list.setMovement(QListView::Static);
+    list.setUniformItemSizes(true);
+    list.setSelectionMode(QAbstractItemView::NoSelection);
+    list.setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    list.setFixedWidth(450);
+    list.setStyleSheet("border: 0; background: transparent;");
+    connect(&list, &QListView::clicked, this, &ViewConnectedTibiers::tibierClicked);
+
     sendButton.setText("SEND");
     sendButton.setObjectName("send-button");
     sendButton.setFixedWidth(110);
@@ -134,6 +121,8 @@ void ViewConnectedTibiers::createDialog() {
 
     verticalLayout.addWidget(&title);
     verticalLayout.addWidget(&infoText);
+    verticalLayout.addWidget(&search, 0, Qt::AlignCenter);
+    verticalLayout.addWidget(&list, 1, Qt::AlignCenter);
     verticalLayout.addLayout(&buttonsLayout);
     verticalLayout.setSpacing(13);
     verticalLayout.addSpacing(15);
@@ -143,63 +132,24 @@ void ViewConnectedTibiers::createDialog() {
 
 void ViewConnectedTibiers::endSelection() {
 
+    QVector<QString> selected = model.selectedIds();
     if(selected.isEmpty())  {
         int ret = QMessageBox::question(nullptr, "TIBIERS SELECTION EMPTY", "You haven't selected any tibiers. Do you want to cancel the request?");
         if ( ret == QMessageBox::No ) return;
     }
 
-    hide();
+    endRequest();
     emit selectionReady(selected);
-    selected.clear();
-    active = false;
 
 }
 
 void ViewConnectedTibiers::cancelSelectionRequest() {
-    hide();
-    selected.clear();
-    emit selectionReady(selected);
-    active = false;
+    endRequest();
+    emit selectionReady(QVector<QString>());
 }
 
-
-void ViewConnectedTibiers::initCentralWidget() {
-
-    row = 0;
-    column = 0;
-
-    if(scroll != nullptr) {
-        delete scroll;
-    }
-
-    centralWidget = new QWidget;
-    tibiersConnected = new QGridLayout;
-    tibiersConnected->setVerticalSpacing(20);
-
-    centralWidget->setFixedWidth(450);
-    centralWidget->setLayout(tibiersConnected);
-
-    column1 = new QLabel;
-    column2 = new QLabel;
-    column3 = new QLabel;
-    column1->setFixedWidth(centralWidget->width()/3);
-    column2->setFixedWidth(centralWidget->width()/3);
-    column3->setFixedWidth(centralWidget->width()/3);
-    tibiersConnected->addWidget(column1, 1, 0);
-    tibiersConnected->addWidget(column2, 1, 1);
-    tibiersConnected->addWidget(column3, 1, 2);
-
-    scroll = new QScrollArea;
-    scroll->setWidget(centralWidget);
-    scroll->setWidgetResizable(true);
-    scroll->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    scroll->setStyleSheet("border: 0;");
-
-    verticalLayout.insertWidget(2, scroll);
-
+void ViewConnectedTibiers::endRequest() {
+    hide();
+    model.clearSelection();
+    active = false;
 }
-
-
-
-
-
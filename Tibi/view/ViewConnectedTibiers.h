@@ -1,17 +1,24 @@
 #ifndef VIEWSELECTOR_H
 #define VIEWSELECTOR_H
 
-#include "clickablelabel.h"
 #include <QWidget>
-#include <QGridLayout>
+#include <QVBoxLayout>
 #include <QLabel>
 #include <QPushButton>
-#include <QScrollArea>
+#include <QLineEdit>
+#include <QListView>
+#include <QSortFilterProxyModel>
 #include <QCloseEvent>
-#include <QReadWriteLock>
 #include <QMessageBox>
 #include "user/UserHandler.h"
+#include "view/TibiersModel.h"
+#include "view/TibierDelegate.h"
 
+/**
+ * @brief The ViewConnectedTibiers class, the dialog where the user picks the tibiers to share with.
+ * The online tibiers are kept in a TibiersModel updated one tibier at a time through UserHandler::tibierChanged,
+ * and shown in a QListView filtered by the search field.
+ */
 class ViewConnectedTibiers : public QWidget
 {
     Q_OBJECT
@@ -24,7 +31,7 @@ signals:
     void selectionReady(const QVector<QString>& selected);
 
 public slots:
-    void update();
+    void updateTibier(const Tibier& tibier);
     void showConnectedTibiers(const QVector<QString>& filePaths);
     void removeTibierFromSelected(const QString& id);
 
@@ -32,28 +39,23 @@ private:
     /* -- UTILITIES --*/
     UserHandler* user = nullptr;
     bool active = false;
-    QVector<QString> selected;
     QVector<QString> filePaths;
     QVBoxLayout verticalLayout;
-    QGridLayout* tibiersConnected;
-    int column = 0;
-    int row = 0;
-    QWidget* centralWidget = nullptr;
-    QLabel *column1;
-    QLabel *column2;
-    QLabel *column3;
-    QScrollArea* scroll = nullptr;
+    TibiersModel model;
+    QSortFilterProxyModel filter;
+    TibierDelegate delegate;
+    QListView list;
+    QLineEdit search;
     QHBoxLayout buttonsLayout;
     QPushButton sendButton;
     QPushButton cancelButton;
     QLabel title;
     QLabel infoText;
     void createDialog();
-    void initCentralWidget();
+    void endRequest();
 
 private slots:
-    void addSelected(QString id);
-    void removeSelected(QString id);
+    void tibierClicked(const QModelIndex& index);
     void endSelection();
     void cancelSelectionRequest();
 
@@ -127,6 +127,12 @@ void ViewTray::notifyUserDownloadStatus(QSharedPointer<Download> download) {
     else if( download->status == Status::Aborted ) {
         msg += " aborted by tibier " + download->usernameSender;
     }
+    else if( download->status == Status::Skipped ) {
+        msg += " skipped: it already exists.";
+    }
+    else if( download->status == Status::NoSpace ) {
+        msg += " declined: not enough space in " + download->downloadsPath + ".";
+    }
 
     showMessage("TIBI NOTIFICATION", msg, icon);
 }
@@ -10,10 +10,9 @@
 ViewUD::ViewUD()
 {
 
-    uploadsLayout = new QGridLayout;
-    downloadsLayout = new QGridLayout;
-    uploadRows = new QMap<int, UDRow*>;
-    downloadRows = new QMap<int, UDRow*>;
+    uploadsModel = new TransfersModel(true, this);
+    downloadsModel = new TransfersModel(false, this);
+    delegate = new TransferDelegate(this);
     createSendingWindow();
 
 }
@@ -25,8 +24,8 @@ void ViewUD::createSendingWindow() {
     setMinimumWidth(900);
     setWindowTitle("Tibi is sharing..");
 
-    QVBoxLayout* upLayout = createCentralLayout("uploads", "T O", uploadsLayout);
-    QVBoxLayout* downLayout = createCentralLayout("downloads", "F R O M", downloadsLayout);
+    QVBoxLayout* upLayout = createCentralLayout("uploads", "T O", createTable(true, uploadsModel));
+    QVBoxLayout* downLayout = createCentralLayout("downloads", "F R O M", createTable(false, downloadsModel));
     QVBoxLayout* centralLayout = new QVBoxLayout;
     centralLayout->addLayout(upLayout);
     centralLayout->addSpacing(30);
@@ -39,12 +38,11 @@ void ViewUD::createSendingWindow() {
 
 }
 
-QVBoxLayout* ViewUD::createCentralLayout(const QString& title, const QString& toOrFrom, QGridLayout* layout) {
+QVBoxLayout* ViewUD::createCentralLayout(const QString& title, const QString& toOrFrom, QTableView* table) {
 
     QHBoxLayout* titleLayout = createTitleLayout(title);
     QHBoxLayout* infoLayout = createInfoLayout(toOrFrom);
     QLabel* separatorLine = createSeparator();
-    QScrollArea* scroll = createScrollArea(layout);
     QVBoxLayout *centralLayout = new QVBoxLayout;
     centralLayout->addLayout(titleLayout);
     centralLayout->setAlignment(titleLayout, Qt::AlignLeft);
@@ -53,7 +51,7 @@ QVBoxLayout* ViewUD::createCentralLayout(const QString& title, const QString& to
     centralLayout->setAlignment(infoLayout, Qt::AlignLeft);
     centralLayout->addWidget(separatorLine);
     centralLayout->setAlignment(separatorLine, Qt::AlignLeft);
-    centralLayout->addWidget(scroll);
+    centralLayout->addWidget(table);
     centralLayout->setSpacing(20);
 
     return centralLayout;
@@ -114,150 +112,109 @@ QLabel* ViewUD::createSeparator() {
     return lineLabel;
 }
 
-QScrollArea* ViewUD::createScrollArea(QGridLayout *layout) {
-    layout->setAlignment(Qt::AlignTop);
-    QWidget* wrapperWidget = new QWidget;
-    wrapperWidget->setObjectName("uploads");
-    wrapperWidget->setLayout(layout);
-    QScrollArea* scroll = new QScrollArea;
-    scroll = new QScrollArea;
-    scroll->setWidgetResizable(true);
-    scroll->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    scroll->setStyleSheet("border: 0;");
-    scroll->setWidget(wrapperWidget);
-    return scroll;
+QTableView* ViewUD::createTable(bool upload, TransfersModel* model) {
+    QTableView* table = new QTableView;
+    table->setObjectName("uploads");
+    table->viewport()->setObjectName("uploads");
+    table->setModel(model);
+    table->setItemDelegate(delegate);
+    table->setShowGrid(false);
+    table->setSelectionMode(QAbstractItemView::NoSelection);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setFocusPolicy(Qt::NoFocus);
+    table->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    table->setStyleSheet("border: 0;");
+
+    // fixed row height: the view never asks the delegate for the size of rows that are not visible
+    table->verticalHeader()->setVisible(false);
+    table->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    table->verticalHeader()->setDefaultSectionSize(40);
+
+    table->horizontalHeader()->setVisible(false);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    table->horizontalHeader()->setSectionResizeMode(TransfersModel::ItemColumn, QHeaderView::Stretch);
+    table->setColumnWidth(TransfersModel::TibierColumn, 150);
+    table->setColumnWidth(TransfersModel::StatusColumn, 150);
+    table->setColumnWidth(TransfersModel::ProgressColumn, 220);
+    table->setColumnWidth(TransfersModel::PauseColumn, 80);
+    table->setColumnWidth(TransfersModel::ActionColumn, 80);
+    table->setColumnWidth(TransfersModel::TopColumn, 60);
+
+    connect(table, &QTableView::clicked, this, [=](const QModelIndex& index) {
+        transferClicked(upload, index);
+    });
+    if( upload ) {
+        table->setContextMenuPolicy(Qt::CustomContextMenu);
+        connect(table, &QTableView::customContextMenuRequested, this, [=](const QPoint& pos) {
+            showPriorityMenu(table, pos);
+        });
+    }
+
+    return table;
 }
 
 void ViewUD::addUD(bool upload, int code, const QString& tibierName, const QString& fileName) {
     qDebug() << "add UD";
-    QGridLayout* layout = uploadsLayout;
-    QMap<int, UDRow*>* map = uploadRows;
-    if( ! upload ) {
-        layout = downloadsLayout;
-        map = downloadRows;
-    }
-
-    UDRow* row = new UDRow(code, tibierName, fileName);
-    map->insert(code, row);
-    int rowCount = layout->rowCount()+1;
-    layout->addWidget(row->to, rowCount, 0);
-    layout->addWidget(row->name, rowCount, 1);
-    layout->addWidget(row->time, rowCount, 2);
-    layout->addWidget(row->bar, rowCount, 3);
-    layout->addWidget(row->abort, rowCount, 4);
-    connect(row->abort, &QPushButton::clicked, this, [=]() {
-        upload?
-                    emit signalUploadAbort(row->code) : emit signalDownloadAbort(row->code);
-        row->time->setText("ABORTING..");
-        row->lastTime = QTime(0,0,0);
-        row->bar->setRange(0,0);
-        row->bar->update();
-        row->abort->setVisible(false);
-    });
-
+    upload ? uploadsModel->addTransfer(code, tibierName, fileName) : downloadsModel->addTransfer(code, tibierName, fileName);
     raiseView();
 
 }
 
-
-
 void ViewUD::updateUD(bool upload, int code, int perc, const QTime& time, const QString& info, const QString& path) {
-    QGridLayout* layout = uploadsLayout;
-    QMap<int, UDRow*>* map = uploadRows;
-    if( ! upload ) {
-        layout = downloadsLayout;
-        map = downloadRows;
-    }
-
     //qDebug() << "[ VIEW ] NEW UPDATE " << perc << "%";
+    TransfersModel* model = upload ? uploadsModel : downloadsModel;
+    model->updateTransfer(code, perc, time, info, path);
+}
 
+void ViewUD::updateDownloadName(int code, const QString& newName) {
+    downloadsModel->renameTransfer(code, newName);
+}
 
-    if( !map->contains(code)) {
-        qDebug() << "There is no corresponding code!";
-        return;
-    }
-    UDRow* row = map->value(code);
-    row->bar->setValue(perc);
-    row->bar->setRange(0,100);
-
-    if(info == "") {
-        row->lastTime = time;
-        row->time->setText( "- "
-                            + (time.hour() < 10 ? "0" + QString::number(time.hour()) :  QString::number(time.hour())) + " h "
-                            + (time.minute() < 10 ? "0" + QString::number(time.minute()) :  QString::number(time.minute())) + " m "
-                            + (time.second() < 10 ? "0" + QString::number(time.second()) :  QString::number(time.second())) + " s");
-    }
-
-    else {
-        row->lastTime = QTime(0,0,0);
-        row->time->setText(info);
-        if( info != "WAITING" ) row->time->setStyleSheet("color: #FF2F92");
-    }
-
-    if(perc == 0) {
-        row->bar->setRange(0,0);
-        row->bar->setStyleSheet("background-color: #212121;");
+void ViewUD::transferClicked(bool upload, const QModelIndex& index) {
+    TransfersModel* model = upload ? uploadsModel : downloadsModel;
+    QString button = index.data(TransfersModel::ButtonRole).toString();
+    if( button.isEmpty() ) return;
+    int code = model->rowAt(index.row()).code;
 
+    if( button == "abort" ) {
+        model->setAborting(index.row());
+        upload ? emit signalUploadAbort(code) : emit signalDownloadAbort(code);
     }
 
-    if(perc >= 100) {
-        completed(map, layout, row);
-        if( info == "COMPLETED") {
-            if( upload ) {
-                row->time->setStyleSheet("color: #00FDFF");
-            }
-
-            else {
-                row->open = new QPushButton("open");
-                row->open->setFixedWidth(70);
-                connect(row->open, &QPushButton::clicked, this, [=]() {
-                    QDesktopServices::openUrl(QUrl::fromLocalFile(path));
-                    layout->invalidate();
-                });
-                int rowIndex;
-                int columnIndex;
-                int spanRow;
-                int spanColumn;
-                layout->getItemPosition(layout->indexOf(row->time), &rowIndex, &columnIndex, &spanRow, &spanColumn);
-                layout->addWidget(row->open, rowIndex, columnIndex);
-                layout->setAlignment(row->open, Qt::AlignLeft);
-                row->time->setVisible(false);
-            }
+    else if( button == "pause" || button == "resume" ) {
+        if( upload ) {
+            emit signalUploadPause(code, model->togglePaused(index.row()));
+        } else {
+            // a download can be paused only once it is receiving: the row follows the status sent back by its handler
+            emit signalDownloadPause(code, !model->rowAt(index.row()).paused);
         }
     }
 
-    row->bar->update();
-
+    else if( button == "top" ) {
+        emit signalUploadPrioritize(code);
+    }
 
-}
+    else if( button == "open" ) {
+        QDesktopServices::openUrl(QUrl::fromLocalFile(model->rowAt(index.row()).path));
+    }
 
-void ViewUD::updateDownloadName(int code, const QString& newName) {
-    if( downloadRows->contains(code)) {
-        UDRow* row = downloadRows->value(code);
-        row->name->setText(newName);
-        downloadsLayout->invalidate();
+    else if( button == "remove" ) {
+        model->removeFinished(index.row());
     }
 }
 
-void ViewUD::completed(QMap<int, UDRow*>* map, QGridLayout* layout, UDRow* row) {
+void ViewUD::showPriorityMenu(QTableView* table, const QPoint& pos) {
+    QModelIndex index = table->indexAt(pos);
+    if( !index.isValid() ) return;
+    const TransferRow& row = uploadsModel->rowAt(index.row());
+    if( row.finished || row.aborting ) return;
+    int code = row.code;
 
-    row->bar->setStyleSheet("background-color: #212121;");
-    row->bar->setRange(0,100);
-    row->bar->setValue(0);
-    row->abort->setText("remove");
-    row->abort->disconnect();
-    connect(row->abort, &QPushButton::clicked, this, [=]() {
-        removeItem(map, layout, row);
-    });
-    row->abort->setVisible(true);
-
-
-}
-
-void ViewUD::removeItem(QMap<int, UDRow*>* map, QGridLayout* layout, UDRow* row) {
-    map->remove(row->code);
-    layout->invalidate();
-    delete row;
+    QMenu menu;
+    menu.addAction("High priority", this, [=]() { emit signalUploadPriority(code, PRIORITY_HIGH); });
+    menu.addAction("Normal priority", this, [=]() { emit signalUploadPriority(code, PRIORITY_NORMAL); });
+    menu.addAction("Low priority", this, [=]() { emit signalUploadPriority(code, PRIORITY_LOW); });
+    menu.exec(table->viewport()->mapToGlobal(pos));
 }
 
 
@@ -269,13 +226,4 @@ void ViewUD::raiseView() {
 
 ViewUD::~ViewUD() {
 
-    for( UDRow* row : *uploadRows ) {
-        if( row != nullptr ) delete row;
-    }
-    delete uploadRows;
-
-    for( UDRow* row : *downloadRows ) {
-        if( row != nullptr ) delete row;
-    }
-    delete downloadRows;
 }
@@ -17,8 +17,20 @@
 #include <QUrl>
 #include <QScreen>
 #include <QDesktopServices>
-#include "view/UDRow.h"
+#include <QLabel>
+#include <QBoxLayout>
+#include <QTableView>
+#include <QHeaderView>
+#include <QMenu>
+#include "view/TransfersModel.h"
+#include "view/TransferDelegate.h"
+#include "upload/UploadsQueue.h"
 
+/**
+ * @brief The ViewUD class shows the uploads and the downloads. Each list is a TransfersModel shown by a QTableView:
+ * only the visible rows are painted by the TransferDelegate and the clicks on the painted buttons are mapped to the
+ * abort, pause, prioritize, open and remove actions. The context menu of an upload that is not finished sets its priority.
+ */
 class ViewUD : public QMainWindow
 {
     Q_OBJECT
@@ -36,24 +48,34 @@ public slots:
 signals:
     void signalUploadAbort(int code);
     void signalDownloadAbort(int code);
+    void signalUploadPause(int code, bool pause);
+    void signalDownloadPause(int code, bool pause);
+    void signalUploadPrioritize(int code);
+    void signalUploadPriority(int code, int priority);
 
 private:
-    QGridLayout* uploadsLayout;
-    QGridLayout* downloadsLayout;
-    QMap<int, UDRow*>* uploadRows;
-    QMap<int, UDRow*>* downloadRows;
+    TransfersModel* uploadsModel;
+    TransfersModel* downloadsModel;
+    TransferDelegate* delegate;
     void createSendingWindow();
-    void removeItem(QMap<int, UDRow*>* map, QGridLayout* layout, UDRow *row);
-    void completed( QMap<int, UDRow*>* map, QGridLayout* layout, UDRow* row);
-    void abortingState(int code);
+
+    /**
+     * @brief transferClicked, maps the click on a painted button to the corresponding action
+     */
+    void transferClicked(bool upload, const QModelIndex& index);
+
+    /**
+     * @brief showPriorityMenu, the menu with the priorities of the upload under pos
+     */
+    void showPriorityMenu(QTableView* table, const QPoint& pos);
 
     QLabel* createLogo();
     QLabel* createTitle(const QString& title);
     QHBoxLayout* createTitleLayout(const QString& title);
     QHBoxLayout* createInfoLayout(const QString& toOrFrom);
     QLabel* createSeparator();
-    QScrollArea* createScrollArea(QGridLayout* layout);
-    QVBoxLayout* createCentralLayout(const QString& title, const QString& toOrFrom, QGridLayout* layout);
+    QTableView* createTable(bool upload, TransfersModel* model);
+    QVBoxLayout* createCentralLayout(const QString& title, const QString& toOrFrom, QTableView* table);
 
 };
 
@@ -0,0 +1,28 @@
+# Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+# This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+# See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+
+# Measures how many beacons per second one core of TibiDiscovery can read and apply, through its TibiBeaconReader.
+
+QT -= gui
+QT += network
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+CONFIG += release
+
+INCLUDEPATH += ../Tibi
+
+SOURCES += \
+    main.cpp \
+    ../Tibi/network/TibiBeacon.cpp \
+    ../Tibi/network/TibiBeaconReader.cpp \
+    ../Tibi/user/TibiersRegistry.cpp \
+    ../Tibi/user/tibier.cpp
+
+HEADERS += \
+    ../Tibi/network/TibiBeacon.h \
+    ../Tibi/network/TibiBeaconReader.h \
+    ../Tibi/user/TibiersRegistry.h \
+    ../Tibi/user/tibier.h \
+    ../Tibi/user/LinkStats.h
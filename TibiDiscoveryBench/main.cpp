@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QUdpSocket>
+#include <QFile>
+#include <QVector>
+#include <QDebug>
+#include "network/TibiBeacon.h"
+#include "network/TibiBeaconReader.h"
+#include "user/TibiersRegistry.h"
+
+#define BENCH_TIBIERS 1000
+#define BENCH_ROUNDS 1000
+#define BENCH_CHANGE_EVERY 100
+#define BENCH_BURST 256
+#define BENCH_RECEIVE_BUFFER 8*1024*1024
+
+/*
+ * Measures how many beacons per second one core of TibiDiscovery can apply: the beacons are sent on the loopback and read
+ * by the TibiBeaconReader of the application, with the batched receive path, into a sink that only holds the registry.
+ * Usage: TibiDiscoveryBench [recorded beacons]
+ * The recorded beacons are a sequence of quint16 (big endian) size and datagram, as captured from the discovery port;
+ * without a file BENCH_TIBIERS tibiers beacon BENCH_ROUNDS times, one beacon every BENCH_CHANGE_EVERY with a new name hash.
+ * They are sent BENCH_BURST at a time, and only the time spent reading them is measured.
+ */
+
+class BenchSink : public TibiBeaconSink {
+public:
+    TibiersRegistry registry;
+    qint64 read = 0;
+    qint64 applied = 0;
+
+    bool touchTibier(const QUuid& id, qint64 lastPing) override {
+        bool touched = registry.touch(id, lastPing);
+        if( touched ) read++;
+        return touched;
+    }
+
+    bool lookupTibier(const QUuid& id, Tibier& tibier) override {
+        read++;
+        return registry.lookup(id, tibier);
+    }
+
+    void newPing(QSharedPointer<Tibier> tibier) override {
+        registry.upsert(*tibier);
+        applied++;
+    }
+
+    void fetchProfile(const Tibier& tibier, bool needName, bool needAvatar) override {
+        Q_UNUSED(needAvatar);
+        if( !needName ) return;
+        // the profile server answers at once
+        Tibier fetched = tibier;
+        fetched.username = "bench";
+        registry.upsert(fetched);
+    }
+
+    void readQuery(const char* datagram, qint64 size, const QHostAddress& sender) override {
+        Q_UNUSED(datagram);
+        Q_UNUSED(size);
+        Q_UNUSED(sender);
+        read++;
+    }
+};
+
+static QVector<QByteArray> loadBeacons(const QString& path) {
+    QVector<QByteArray> beacons;
+    QFile file(path);
+    if( !file.open(QIODevice::ReadOnly) ) {
+        qWarning() << "Cannot open" << path;
+        return beacons;
+    }
+    QByteArray all = file.readAll();
+    const uchar* in = reinterpret_cast<const uchar*>(all.constData());
+    int pos = 0;
+    while( pos + 2 <= all.size() ) {
+        int size = qFromBigEndian<quint16>(in + pos);
+        pos += 2;
+        if( pos + size > all.size() ) break;
+        beacons.append(all.mid(pos, size));
+        pos += size;
+    }
+    return beacons;
+}
+
+static QVector<QByteArray> synthesizeBeacons() {
+    QVector<TibiBeacon> tibiers(BENCH_TIBIERS);
+    for( int i = 0; i < BENCH_TIBIERS; i++ ) {
+        TibiBeacon& beacon = tibiers[i];
+        beacon.capabilities = TibiBeacon::Transfers | TibiBeacon::Profile;
+        beacon.id = QUuid::createUuid();
+        beacon.port = 4000;
+        beacon.profilePort = 4001;
+        beacon.nameHash = TibiBeacon::hash32(QByteArray::number(i));
+        beacon.addresses.append(QHostAddress(0x0A000000 + static_cast<quint32>(i)));
+    }
+
+    QVector<QByteArray> beacons;
+    beacons.reserve(BENCH_TIBIERS * BENCH_ROUNDS);
+    for( int round = 0; round < BENCH_ROUNDS; round++ ) {
+        for( int i = 0; i < BENCH_TIBIERS; i++ ) {
+            if( (round * BENCH_TIBIERS + i) % BENCH_CHANGE_EVERY == 0 ) tibiers[i].nameHash++;
+            beacons.append(tibiers[i].encode());
+        }
+    }
+    return beacons;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QVector<QByteArray> beacons = argc > 1 ? loadBeacons(QString::fromLocal8Bit(argv[1])) : synthesizeBeacons();
+    if( beacons.isEmpty() ) return 1;
+
+    QUdpSocket receiver;
+    if( !receiver.bind(QHostAddress::LocalHost, 0) ) {
+        qWarning() << "Cannot bind the receiver:" << receiver.errorString();
+        return 1;
+    }
+    receiver.setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, BENCH_RECEIVE_BUFFER);
+    QUdpSocket sender;
+
+    BenchSink sink;
+    TibiBeaconReader reader(&sink, QUuid::createUuid());
+    qint64 busyNsecs = 0;
+    QElapsedTimer busy;
+
+    for( int first = 0; first < beacons.size(); first += BENCH_BURST ) {
+        int last = qMin(first + BENCH_BURST, beacons.size());
+        for( int i = first; i < last; i++ ) {
+            sender.writeDatagram(beacons.at(i), QHostAddress::LocalHost, receiver.localPort());
+        }
+        busy.start();
+        reader.readSocket(&receiver, true);
+        busyNsecs += busy.nsecsElapsed();
+    }
+    busyNsecs = qMax<qint64>(1, busyNsecs);
+
+    qInfo() << beacons.size() << "beacons sent," << sink.read << "read," << sink.applied << "applied in full, in" << busyNsecs / 1000000 << "ms:"
+            << static_cast<qint64>(sink.read * 1e9 / busyNsecs) << "beacons/s per core";
+    return 0;
+}
@@ -0,0 +1,25 @@
+# Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+# This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+# See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+
+# Measures the CPU spent per GB by the receive path of a download, straight to the file or through the DiskWriter,
+# and checks that the memory held by the transfers stays within the bound of the MemoryGovernor.
+
+QT -= gui
+QT += network
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+CONFIG += release
+
+INCLUDEPATH += ../Tibi
+
+SOURCES += \
+    main.cpp \
+    ../Tibi/download/DiskWriter.cpp \
+    ../Tibi/network/MemoryGovernor.cpp
+
+HEADERS += \
+    ../Tibi/download/DiskWriter.h \
+    ../Tibi/download/SpscQueue.h \
+    ../Tibi/network/MemoryGovernor.h
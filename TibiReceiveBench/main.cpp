@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2020 Valentina Di Vincenzo ( hello@valentina-divincenzo.com )
+ *  This file is part of Tibi which is released under the GNU General Public License, version 3.0.
+ * See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
+ *
+ */
+
+#include <QCoreApplication>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDebug>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "download/DiskWriter.h"
+#include "network/MemoryGovernor.h"
+
+#define BENCH_SEND_BLOCK 64*1024
+#define BENCH_DIRECT_BLOCK 256*1024     // the block of the receive path before the DiskWriter
+#define BENCH_WAIT 100
+#define BENCH_CONNECT_TIMEOUT 5000
+#define BENCH_RSS_SLACK 32*1024*1024
+
+/*
+ * Measures the CPU that the receive path of a download spends per GB of payload.
+ * Usage: TibiReceiveBench [MB] [output file]
+ * Without a size, more bytes than the physical memory are sent, and the bench fails if the peak RSS of the process grew by more
+ * than the bytes the MemoryGovernor lets the two transfers hold (MEMORY_PER_TRANSFER each), the blocks of a WriteStream
+ * and BENCH_RSS_SLACK: a buffer that kept the item would not fit.
+ * The bytes are sent on the loopback by another thread, with the backpressure of UploadHandler::writeData, and received twice
+ * into the output file (/dev/null by default, to leave the disk out):
+ * - direct: read in a single block and written with an unbuffered QFile on the thread of the socket, as DownloadHandler did
+ *   before the DiskWriter;
+ * - disk writer: read into the blocks of a WriteStream and written on the thread of the DiskWriter, as DownloadHandler::downloadFile does.
+ * In both runs the read buffer of the socket is bounded by the MemoryGovernor, as in DownloadHandler::boundReadBuffer.
+ * The CPU of the sender thread is subtracted from the one of the process. The sockets are not encrypted: the decryption
+ * costs the same on both paths.
+ */
+
+static qint64 cpuNsecs(int who) {
+    rusage usage;
+    getrusage(who, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * Q_INT64_C(1000000000)
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * Q_INT64_C(1000);
+}
+
+static qint64 peakRss() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // kilobytes on Linux
+    return static_cast<qint64>(usage.ru_maxrss) * 1024;
+}
+
+static qint64 physicalMemory() {
+    return static_cast<qint64>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGESIZE);
+}
+
+static qint64 threadCpuNsecs() {
+#ifdef Q_OS_LINUX
+    return cpuNsecs(RUSAGE_THREAD);
+#else
+    return 0;
+#endif
+}
+
+class BenchSender : public QThread {
+public:
+    BenchSender(quint16 port, qint64 total) : port(port), total(total) {}
+    qint64 cpu = 0;
+
+protected:
+    void run() override {
+        qint64 start = threadCpuNsecs();
+        QTcpSocket socket;
+        socket.connectToHost(QHostAddress::LocalHost, port);
+        if( !socket.waitForConnected(BENCH_CONNECT_TIMEOUT) ) {
+            qWarning() << "Cannot connect the sender:" << socket.errorString();
+            return;
+        }
+
+        MemoryGovernor* governor = MemoryGovernor::Instance();
+        int id = governor->join();
+        QByteArray block(BENCH_SEND_BLOCK, 't');
+        for( qint64 sent = 0; sent < total && socket.state() == QAbstractSocket::ConnectedState; ) {
+            // the socket buffers everything it is given: the block is written only once the receiver caught up
+            governor->update(id, socket.bytesToWrite());
+            while( !governor->admits(id, block.size()) && socket.state() == QAbstractSocket::ConnectedState ) {
+                socket.waitForBytesWritten(BENCH_WAIT);
+                governor->update(id, socket.bytesToWrite());
+            }
+            qint64 size = qMin<qint64>(block.size(), total - sent);
+            socket.write(block.constData(), size);
+            sent += size;
+        }
+        while( socket.bytesToWrite() > 0 && socket.state() == QAbstractSocket::ConnectedState ) {
+            socket.waitForBytesWritten(BENCH_WAIT);
+        }
+        governor->leave(id);
+        socket.disconnectFromHost();
+        if( socket.state() != QAbstractSocket::UnconnectedState ) socket.waitForDisconnected();
+        cpu = threadCpuNsecs() - start;
+    }
+
+private:
+    quint16 port;
+    qint64 total;
+};
+
+class BenchRun {
+public:
+    qint64 received = 0;
+    qint64 msecs = 0;
+    qint64 cpu = 0;
+};
+
+static qint64 receiveDirect(QTcpSocket* socket, QFile* file, QByteArray& block, qint64 left) {
+    qint64 received = 0;
+    while( received < left ) {
+        qint64 read = socket->read(block.data(), qMin<qint64>(left - received, block.size()));
+        if( read <= 0 ) break;
+        if( file->write(block.constData(), read) != read ) return -1;
+        received += read;
+    }
+    return received;
+}
+
+static qint64 receiveThroughWriter(QTcpSocket* socket, QFile* file, WriteStream* writer, qint64 left) {
+    // all the blocks are waiting for the disk: the next bytes are read once one is free
+    qint64 received = 0;
+    WriteBlock* block = writer->block();
+    while( block != nullptr && received < left ) {
+        block->file = file;
+        qint64 read = socket->read(block->data.data() + block->size, qMin<qint64>(left - received, block->data.size() - block->size));
+        if( read <= 0 ) break;
+        block->size += static_cast<int>(read);
+        received += read;
+        if( block->isFull() || received == left ) {
+            // the last block hands the file over to the writer
+            block->closeFile = received == left;
+            writer->push();
+            if( received == left ) break;
+            block = writer->block();
+        }
+    }
+    return received;
+}
+
+static bool runPath(bool throughWriter, qint64 total, const QString& outputPath, BenchRun& run) {
+    QTcpServer server;
+    if( !server.listen(QHostAddress::LocalHost, 0) ) {
+        qWarning() << "Cannot listen:" << server.errorString();
+        return false;
+    }
+    QFile* file = new QFile(outputPath);
+    if( !file->open(QIODevice::WriteOnly | QIODevice::Unbuffered) ) {
+        qWarning() << "Cannot open" << outputPath << ":" << file->errorString();
+        delete file;
+        return false;
+    }
+
+    BenchSender sender(server.serverPort(), total);
+    qint64 cpuBefore = cpuNsecs(RUSAGE_SELF);
+    QElapsedTimer time;
+    time.start();
+    sender.start();
+    if( !server.waitForNewConnection(BENCH_CONNECT_TIMEOUT) ) {
+        qWarning() << "The sender did not connect";
+        sender.wait();
+        delete file;
+        return false;
+    }
+    QTcpSocket* socket = server.nextPendingConnection();
+
+    MemoryGovernor* governor = MemoryGovernor::Instance();
+    int id = governor->join();
+    socket->setReadBufferSize(governor->share());
+    QByteArray directBlock(BENCH_DIRECT_BLOCK, Qt::Uninitialized);
+    QSharedPointer<WriteStream> writer;
+    if( throughWriter ) writer = DiskWriter::Instance()->open();
+
+    QEventLoop loop;
+    bool failed = false;
+    auto receive = [&]() {
+        if( failed || run.received == total ) return;
+        qint64 read = throughWriter ? receiveThroughWriter(socket, file, writer.data(), total - run.received)
+                                    : receiveDirect(socket, file, directBlock, total - run.received);
+        if( read < 0 || (throughWriter && writer->failed()) ) {
+            failed = true;
+            loop.quit();
+            return;
+        }
+        run.received += read;
+        // once the buffer is full the socket stops reading, and TCP slows down the sender
+        governor->update(id, socket->bytesAvailable() + (throughWriter ? writer->queuedBytes() : 0));
+        socket->setReadBufferSize(governor->share());
+        if( run.received == total ) loop.quit();
+    };
+    QObject::connect(socket, &QTcpSocket::readyRead, &loop, receive);
+    if( throughWriter ) QObject::connect(writer.data(), &WriteStream::written, &loop, receive, Qt::QueuedConnection);
+    receive();
+    if( !failed && run.received < total ) loop.exec();
+
+    if( throughWriter ) {
+        writer->flush();
+        DiskWriter::Instance()->close(writer);
+        writer.clear();
+        // the file is handed over to the writer with the last block only
+        if( run.received < total ) delete file;
+    } else {
+        delete file;
+    }
+    governor->leave(id);
+    sender.wait();
+    run.msecs = time.elapsed();
+    run.cpu = cpuNsecs(RUSAGE_SELF) - cpuBefore - sender.cpu;
+    delete socket;
+
+    if( failed ) qWarning() << "Cannot write" << outputPath;
+    return !failed;
+}
+
+static void report(const char* path, const BenchRun& run) {
+    double gb = qMax(1.0, static_cast<double>(run.received)) / (1024.0 * 1024 * 1024);
+    qInfo() << path << ":" << run.received / (1024 * 1024) << "MB in" << run.msecs << "ms,"
+            << static_cast<qint64>(run.cpu / 1e6 / gb) << "ms of CPU per GB";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    qint64 total = argc > 1 ? QString::fromLocal8Bit(argv[1]).toLongLong() * Q_INT64_C(1024) * 1024 : physicalMemory() + Q_INT64_C(1024) * 1024 * 1024;
+    QString outputPath = argc > 2 ? QString::fromLocal8Bit(argv[2]) : "/dev/null";
+    if( total <= 0 ) {
+        qWarning() << "Usage: TibiReceiveBench [MB] [output file]";
+        return 1;
+    }
+
+    qint64 rssBefore = peakRss();
+    DiskWriter::Instance()->start();
+    BenchRun direct;
+    BenchRun staged;
+    bool ok = runPath(false, total, outputPath, direct) && runPath(true, total, outputPath, staged);
+    DiskWriter::Instance()->stop();
+    if( !ok ) return 1;
+
+    report("direct", direct);
+    report("disk writer", staged);
+
+    qint64 rssGrowth = peakRss() - rssBefore;
+    qint64 rssBound = 2 * static_cast<qint64>(MEMORY_PER_TRANSFER) + static_cast<qint64>(WRITE_QUEUE_SLOTS) * WRITE_BLOCK_SIZE
+            + BENCH_DIRECT_BLOCK + BENCH_RSS_SLACK;
+    qInfo() << "peak RSS grew by" << rssGrowth / (1024 * 1024) << "MB, bound" << rssBound / (1024 * 1024) << "MB";
+    if( rssGrowth > rssBound ) {
+        qWarning() << "The transfers held more memory than the MemoryGovernor allows";
+        return 1;
+    }
+    return 0;
+}
@@ -3,4 +3,4 @@
 # See file LICENSE or go to http://www.gnu.org/licenses/ for full license details.
 
 TEMPLATE = subdirs
-SUBDIRS += Tibi TibiSelector/
+SUBDIRS += Tibi TibiSelector/ TibiDiscoveryBench/ TibiReceiveBench/